@@ -21,12 +21,33 @@ g++ -o weather_sim.exe ^
     main.cpp ^
     src/Application.cpp ^
     src/WeatherSystem.cpp ^
+    src/WindField.cpp ^
+    src/MoistureGrid.cpp ^
+    src/ColumnTemperature.cpp ^
+    src/Ephemeris.cpp ^
+    src/AtmosphereSky.cpp ^
     src/ParticleSystem.cpp ^
+    src/PrecipitationField.cpp ^
+    src/GpuParticleBackend.cpp ^
+    src/SpatialGrid.cpp ^
     src/CloudSystem.cpp ^
+    src/CloudImpostorAtlas.cpp ^
+    src/CloudShadowMap.cpp ^
+    src/NoiseCloudLayer.cpp ^
     src/LightningSystem.cpp ^
+    src/DielectricBreakdown.cpp ^
     src/CelestialSystem.cpp ^
+    src/StarCatalog.cpp ^
     src/FogSystem.cpp ^
+    src/LightBuffer.cpp ^
+    src/LightShafts.cpp ^
+    src/GroundSystem.cpp ^
+    src/RainLayerSystem.cpp ^
     src/Renderer.cpp ^
+    src/TrailBuffer.cpp ^
+    src/GpuTimer.cpp ^
+    src/WorkerPool.cpp ^
+    src/AllocationCounter.cpp ^
     src/glad.c ^
     src/imgui/imgui.cpp ^
     src/imgui/imgui_demo.cpp ^
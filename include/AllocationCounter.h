@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+
+// Debug counter for global heap allocations (operator new).
+// Counting is compiled in unless NDEBUG is defined; in release builds the
+// counts always read zero.
+class AllocationCounter {
+public:
+    // Total allocations since startup
+    static size_t getTotal();
+
+    // Mark the start of a measured section (e.g. one simulation frame)
+    static void beginFrame();
+
+    // Finish the measured section and return allocations made during it
+    static size_t endFrame();
+
+    // Result of the last beginFrame/endFrame pair
+    static size_t getLastFrame() { return lastFrame; }
+
+    static bool isEnabled();
+
+private:
+    static size_t frameStart;
+    static size_t lastFrame;
+};
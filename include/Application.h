@@ -4,12 +4,23 @@
 #include <GLFW/glfw3.h>
 #include <string>
 #include "WeatherSystem.h"
+#include "AtmosphereSky.h"
 #include "ParticleSystem.h"
 #include "CloudSystem.h"
 #include "LightningSystem.h"
 #include "CelestialSystem.h"
 #include "FogSystem.h"
+#include "GroundSystem.h"
+#include "LightBuffer.h"
+#include "LightShafts.h"
+#include "RainLayerSystem.h"
+#include "TrailBuffer.h"
+#include "WindField.h"
+#include "MoistureGrid.h"
+#include "ColumnTemperature.h"
+#include "GpuTimer.h"
 #include "Renderer.h"
+#include "WorkerPool.h"
 #include "imgui.h"
 #include "imgui_impl_glfw.h"
 #include "imgui_impl_opengl3.h"
@@ -57,12 +68,31 @@ private:
     float lastFrame;
     float deltaTime;
 
+    // Worker threads shared by the systems (declared first: outlives them)
+    WorkerPool workers;
+
     // Weather simulation systems
     WeatherSystem weatherSystem;
+    WindField windField;
+    MoistureGrid moistureGrid;
+    ColumnTemperature columnTemperature;
+    AtmosphereSky atmosphereSky;
     ParticleSystem particleSystem;
     CloudSystem cloudSystem;
+    CloudShadowMap cloudShadows;
     LightningSystem lightningSystem;
     CelestialSystem celestialSystem;
     FogSystem fogSystem;
+    LightShafts lightShafts;
+    LightBuffer lightBuffer;
+    GroundSystem groundSystem;
+    RainLayerSystem rainLayerSystem;
     Renderer renderer;
+    
+    // Precipitation motion trails, and the cost of the precipitation pass
+    TrailBuffer precipitationTrails;
+    bool trailsEnabled;
+    GpuTimer precipitationGpuTimer;
+    float particleUpdateMs;    // Last particle update time
+    float precipitationCpuMs;  // Smoothed update + render time
 };
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "WeatherSystem.h"
+
+// Physically based sky: single Rayleigh and Mie scattering with ozone
+// absorption, precomputed into lookup tables.
+//
+// A worker thread bakes a transmittance table (altitude x view angle) and
+// from it a sky-view table of the light scattered towards a ground observer,
+// indexed by sun elevation, view elevation and the view's azimuth from the
+// sun. The sky-view table is a 3D texture, so the shader follows the sun by
+// interpolating between sun elevation slices and every pixel gets its own
+// colour from its direction on the dome.
+//
+// Bakes run when the turbidity or humidity change. They are incremental: the
+// worker publishes one sun elevation slice at a time, update() uploads the
+// finished slices into a back texture without waiting on the worker, and the
+// sky switches to the new table only once every slice is in. A change in the
+// middle of a bake restarts it.
+class AtmosphereSky {
+public:
+    AtmosphereSky();
+    ~AtmosphereSky();
+
+    // Create the textures and shader and start the first bake (needs a GL
+    // context). Until a bake has finished, render() draws nothing.
+    bool init();
+    void shutdown();
+
+    // Aerosol turbidity (1 = very clear, 10 = hazy); humidity swells the
+    // aerosols. Re-bakes when either changes noticeably.
+    void setConditions(float turbidity, float humidity);
+    float getTurbidity() const { return turbidity; }
+
+    // Upload slices the worker has finished (main thread, never blocks)
+    void update();
+
+    // Fill the window with the sky for the current sun and weather
+    void render(const WeatherSystem& weather, int screenWidth, int screenHeight, float flash);
+
+    bool isReady() const { return frontReady; }
+    // Fraction of the pending bake uploaded so far (1 when idle)
+    float getBakeProgress() const;
+    float getBakeMilliseconds() const { return bakeMilliseconds.load(std::memory_order_relaxed); }
+
+private:
+    float turbidity;
+    float humidity;
+
+    // Worker side. The staging slices are guarded by bakeMutex: the worker
+    // writes slice i and raises slicesReady past it under the lock, and the
+    // main thread copies published slices out under the same lock.
+    std::vector<float> staging;         // Sun slices of RGB sky-view texels
+    int slicesReady;                    // Guarded by bakeMutex
+    unsigned int stagingGeneration;     // Bake the staging slices belong to
+    unsigned int requestedGeneration;   // Guarded by bakeMutex
+    float requestedTurbidity;           // Guarded by bakeMutex
+    float requestedHumidity;
+    bool stopBaking;                    // Guarded by bakeMutex
+    std::mutex bakeMutex;
+    std::condition_variable bakeWake;
+    std::atomic<float> bakeMilliseconds;
+    std::thread bakeWorker;
+
+    // Main thread side
+    unsigned int uploadGeneration;
+    int uploadedSlices;
+    bool frontReady;
+    GLuint skyTextures[2];  // Front (drawn) and back (being filled)
+    int front;
+    GLuint program;
+    GLuint vao;             // Empty: the full-screen triangle comes from gl_VertexID
+    GLint uScreenSize, uHorizonY, uArcHeight, uViewSpan, uFacing, uSunElevation, uSunAzimuth;
+    GLint uExposure, uNightColor, uDim, uGray, uTint, uTintMix, uFlash, uSkyView;
+
+    void bakeLoop();
+};
@@ -1,42 +1,103 @@
 #pragma once
 
+#include <glad/glad.h>
 #include <glm/glm.hpp>
-#include <vector>
+#include <string>
 #include "Renderer.h"
+#include "StarCatalog.h"
 #include "WeatherSystem.h"
 
-struct Star {
-    glm::vec2 position;
-    float brightness;
-    float twinklePhase;
-    float twinkleSpeed;
-    float size;
-};
+// How the sky dome maps onto the window, shared by the sun and moon
+// placement and the sky shader. The view faces the equator.
+const float kSkyViewSpan = 240.0f;   // Degrees of azimuth across the window width
+const float kSkyHorizonY = 0.85f;    // Horizon, as a fraction of the height from the top (just above the ground)
+const float kSkyArcHeight = 0.8f;    // Horizon to zenith, as a fraction of the height
 
 class CelestialSystem {
 public:
     CelestialSystem(int numStars = 100);
+    ~CelestialSystem();
+    
+    // Create the star shader and buffers (needs a GL context). Without it
+    // the sun and moon still draw but the sky has no stars.
+    bool init();
+    void shutdown();
+    
+    // Draw stars from a catalog file (see StarCatalog) instead of the
+    // generated field. Returns false and keeps the generated field if the
+    // file cannot be mapped.
+    bool loadCatalog(const std::string& path);
+    bool isCatalogLoaded() const { return catalog.isMapped(); }
     
-    void update(float deltaTime, const WeatherSystem& weather);
+    // Works out how faint a star can still be seen from the sky brightness
+    // and cloud cover (the cover the clouds were built from), and uploads
+    // any magnitude buckets that newly became visible. Regenerates the
+    // generated field if the star count changed.
+    void update(float deltaTime, const WeatherSystem& weather, float cloudCover);
     void render(Renderer& renderer, const WeatherSystem& weather, int screenWidth, int screenHeight);
     
     void setEnabled(bool enabled) { this->enabled = enabled; }
     bool isEnabled() const { return enabled; }
     
+    // Screen position of the body lighting the scene: the sun by day, the
+    // moon by night
+    glm::vec2 getLightPosition(const WeatherSystem& weather, int screenWidth, int screenHeight) const;
+    
+    // Screen positions of the sun and moon, above or below the horizon
+    glm::vec2 getSunPosition(const WeatherSystem& weather, int screenWidth, int screenHeight) const;
+    glm::vec2 getMoonPosition(const WeatherSystem& weather, int screenWidth, int screenHeight) const;
+    
+    // Share of the scene's light that comes straight from that body, i.e.
+    // how much a cloud shadow can take away
+    float getShadowStrength(const WeatherSystem& weather) const;
+    
+    // Fraction of the sunlight that gets through the clouds to the viewer;
+    // dims the sun disc
+    void setSunTransmittance(float transmittance) { sunTransmittance = transmittance; }
+    
+    // Size of the generated field (ignored while a catalog is loaded)
+    void setStarCount(int count) { starCount = count; }
+    int getStarCount() const { return starCount; }
+    
+    size_t getCatalogStarCount() const { return catalog.getStarCount(); }
+    int getDrawnStars() const { return drawnStars; }
+    float getLimitingMagnitude() const { return limitingMagnitude; }
+    
 private:
-    std::vector<Star> stars;
+    StarCatalog catalog;
+    int starCount;
+    int generatedStars;       // Star count the in-memory catalog was built with
     bool enabled;
+    float sunTransmittance;
+    float starTime;           // Twinkle clock, wrapped to keep float precision
+    float starVisibility;
+    float limitingMagnitude;  // Faintest magnitude visible in the current sky
+    
+    // The GPU buffer holds a prefix of the catalog, grown bucket by bucket
+    int uploadedStars;
+    int bufferCapacity;
+    int drawnStars;
+    
+    GLuint starProgram;
+    GLuint starVAO;
+    GLuint starVBO;
+    GLint uStarProjection, uStarTime, uStarVisibility, uStarSkyScale, uStarLimit;
     
-    // Generate star field
-    void generateStars(int screenWidth, int screenHeight);
+    // Fill the in-memory catalog with random stars
+    void generateStars();
+    void uploadStars(int count);
     
     // Render individual celestial bodies
-    void renderSun(Renderer& renderer, glm::vec2 position, float radius);
-    void renderMoon(Renderer& renderer, glm::vec2 position, float radius, float phase, float alpha);
-    void renderStars(Renderer& renderer, float visibility);
+    void renderSun(Renderer& renderer, glm::vec2 position, float radius, float alpha);
+    void renderMoon(Renderer& renderer, glm::vec2 position, float radius, float phase, bool litFromRight,
+                    float earthshine, float alpha);
+    void renderStars(Renderer& renderer, int screenWidth, int screenHeight) const;
     
-    // Calculate sun/moon position based on time of day
-    glm::vec2 calculateCelestialPosition(float timeOfDay, int screenWidth, int screenHeight, bool isSun) const;
+    // Screen position of a body at an altitude and azimuth (degrees). The
+    // view faces the equator, so bodies rise on the left in the northern
+    // hemisphere and on the right in the southern.
+    glm::vec2 calculateCelestialPosition(float altitude, float azimuth, float latitude, int screenWidth,
+                                         int screenHeight) const;
     
     // Random utility
     float random(float min, float max) const;
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+// Pre-rendered cloud shapes.
+//
+// A cloud's puff layout never changes after it spawns, so its shape is baked
+// once into a slot of a shared texture atlas and then drawn every frame as a
+// single textured quad. The bake stores how many puffs cover each texel
+// (antialiased), so the draw can reproduce the darker overlaps of stacked
+// translucent puffs for whatever opacity the weather asks for. All queued
+// quads go out in one draw call. Slots come from a free list and are handed
+// back when a cloud despawns.
+class CloudImpostorAtlas {
+public:
+    CloudImpostorAtlas();
+    ~CloudImpostorAtlas();
+
+    // Create the atlas with room for `slotCount` clouds. Returns false if the
+    // GL setup failed; callers then keep drawing puffs directly.
+    bool init(int slotCount);
+    void shutdown();
+    bool isInitialized() const { return framebuffer != 0; }
+
+    // Returns -1 when every slot is taken
+    int acquireSlot();
+    void releaseSlot(int slot);
+
+    // Render a cloud shape into its slot. circles are (x, y, radius) relative
+    // to the cloud center, in units of the cloud size.
+    void bake(int slot, const glm::vec3* circles, int count);
+
+    // Queue a baked cloud centered at `center`; color.a is the per-puff opacity
+    void draw(int slot, glm::vec2 center, float size, const glm::vec4& color);
+    void flush(const glm::mat4& projection);
+
+    // Area around the center covered by a slot, in units of the cloud size
+    static glm::vec2 getHalfExtent();
+
+private:
+    struct QuadVertex {
+        glm::vec2 position;
+        glm::vec2 uv;
+        glm::vec4 color;
+    };
+
+    int columns;       // Slots per atlas row
+    int atlasWidth;
+    int atlasHeight;
+    std::vector<int> freeSlots;
+    std::vector<QuadVertex> vertices;
+
+    GLuint texture;
+    GLuint framebuffer;
+    GLuint bakeProgram;
+    GLuint drawProgram;
+    GLuint bakeVAO;    // Empty: the bake quad comes from gl_VertexID
+    GLuint drawVAO;
+    GLuint drawVBO;
+    GLint uCircles, uCircleCount, uHalfExtent, uTexelSize;
+    GLint uProjection, uAtlas, uMaxOverlap;
+
+    glm::ivec2 slotOrigin(int slot) const;
+};
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+// Cloud shapes as seen by the shadow projection: circles with an optical
+// depth, stored as separate arrays so four can be projected at once
+struct ShadowOccluders {
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> radius;
+    std::vector<float> depth;
+
+    void clear() { x.clear(); y.clear(); radius.clear(); depth.clear(); }
+    void add(float cx, float cy, float r, float d) { x.push_back(cx); y.push_back(cy); radius.push_back(r); depth.push_back(d); }
+    size_t size() const { return x.size(); }
+};
+
+// 1D map of sunlight reaching the ground through the clouds.
+//
+// Every occluder is projected along the light direction onto the ground
+// line, where it covers an interval of columns. Intervals live in an integer
+// difference array: each tick only the occluders whose projected interval
+// moved by a column are taken out and put back in, then one SIMD prefix sum
+// and a blur run over the columns. The projection still visits every
+// occluder (four at a time), so the cost grows with the number of clouds:
+// about 2 us for 15 and 22 us for 500.
+class CloudShadowMap {
+public:
+    CloudShadowMap(float columnWidth = 8.0f);
+
+    // lightPosition: screen position of the sun or moon. strength: fraction
+    // of the light a fully opaque cloud removes.
+    void update(const ShadowOccluders& occluders, glm::vec2 lightPosition, float strength,
+                int screenWidth, float groundY);
+
+    // Light factor at screen x: 1 in full light, down to 1 - strength
+    float getLight(float x) const;
+
+    // Fraction of the light passing the clouds on the way to screen x
+    float getTransmittance(float x) const;
+
+    // Transmittance seen by an observer at the middle of the ground, i.e.
+    // toward the light source itself
+    float getSourceTransmittance() const { return sourceTransmittance; }
+
+private:
+    float columnWidth;
+    int columns;
+    float strength;
+    float sourceTransmittance;
+
+    // Projected interval per occluder from the last tick; empty if depth 0
+    std::vector<int32_t> intervalFirst;
+    std::vector<int32_t> intervalLast;
+    std::vector<int32_t> intervalDepth;
+    std::vector<int32_t> nextFirst;
+    std::vector<int32_t> nextLast;
+    std::vector<int32_t> nextDepth;
+
+    std::vector<int32_t> depthDelta;     // Difference array over columns (+1, padded)
+    std::vector<int32_t> depth;          // Prefix sum: quantized optical depth per column
+    std::vector<float> transmittance;    // Blurred exp(-depth)
+    std::vector<float> blurScratch;
+
+    void resize(int screenWidth);
+
+    // Project occluders [0, count) into nextFirst/nextLast/nextDepth
+    void project(const ShadowOccluders& occluders, size_t count, float slope, float stretch, float groundY);
+    void applyInterval(int32_t first, int32_t last, int32_t amount);
+    void prefixSum();
+    void boxBlur(std::vector<float>& values, int radius);
+};
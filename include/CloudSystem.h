@@ -1,42 +1,116 @@
 #pragma once
 
 #include <glm/glm.hpp>
+#include <cstdint>
 #include <vector>
+#include "CloudImpostorAtlas.h"
+#include "CloudShadowMap.h"
+#include "MoistureGrid.h"
+#include "NoiseCloudLayer.h"
+#include "ObjectPool.h"
 #include "Renderer.h"
 #include "WeatherSystem.h"
 
+// One of the circles that together form a cloud's shape
+struct CloudPuff {
+    glm::vec2 offset;  // From the cloud center
+    float size;
+};
+
 struct Cloud {
     glm::vec2 position;
     glm::vec2 velocity;
     float size;
     float opacity;
-    std::vector<glm::vec2> puffOffsets;  // Multiple circles to form cloud shape
-    std::vector<float> puffSizes;
+    uint32_t puffStart;  // First puff in the CloudSystem puff arena
+    uint32_t puffCount;
+    int atlasSlot;       // Baked shape in the impostor atlas, -1 if none
+};
+
+enum class CloudMode {
+    PUFFS,  // Individual clouds built from circles
+    NOISE   // Procedural noise decks filling the upper sky
 };
 
 class CloudSystem {
 public:
     CloudSystem(int maxClouds = 15);
     
+    // Create the impostor atlas and the noise decks (needs a GL context)
+    void init();
+    
+    // Threads for evaluating noise columns (may be null: single-threaded)
+    void setWorkerPool(WorkerPool* workers) { this->workers = workers; }
+    
+    // Moisture grid the clouds condense from (may be null: the weather's
+    // cloud cover and state decide how many there are and how dark)
+    void setMoisture(const MoistureGrid* moisture) { this->moisture = moisture; }
+    
+    void setMode(CloudMode mode) { this->mode = mode; }
+    CloudMode getMode() const { return mode; }
+    
     void update(float deltaTime, const WeatherSystem& weather, int screenWidth, int screenHeight);
     void render(Renderer& renderer, const WeatherSystem& weather);
     
     void setCloudDensity(float density) { this->cloudDensity = density; }
     float getCloudDensity() const { return cloudDensity; }
     
+    // Cloud cover the last update used: the moisture grid's cloud fraction
+    // when one is attached, else the weather's cloud cover
+    float getCloudCover() const { return cloudCover; }
+    
+    // Cloud weight over each screen column (opacity x puff thickness summed
+    // over the puffs above it), rebuilt every update
+    const std::vector<float>& getCoverage() const { return coverage; }
+    float getCoverageColumnWidth() const;
+    
+    // Shapes that cast shadows (puffs, or the deck coverage in noise mode),
+    // rebuilt every update
+    const ShadowOccluders& getShadowOccluders() const { return occluders; }
+    
+    // CPU time of the last noise deck update, in milliseconds
+    float getNoiseUpdateMs() const { return noiseUpdateMs; }
+    
 private:
-    std::vector<Cloud> clouds;
+    ObjectPool<Cloud> clouds;
+    
+    // Puff arena: a fixed block per dense cloud index, so live clouds' puffs
+    // are contiguous from the start and render walks it linearly
+    std::vector<CloudPuff> puffs;
     int maxClouds;
+    CloudImpostorAtlas impostors;
     float cloudDensity;  // 0.0 to 1.0
     int screenWidth;
     int screenHeight;
     
+    std::vector<float> coverage;
+    std::vector<float> coverageDelta;  // Difference array scratch for buildCoverage
+    ShadowOccluders occluders;
+    
+    CloudMode mode;
+    NoiseCloudLayer decks[2];  // Far to near
+    WorkerPool* workers;
+    float noiseUpdateMs;
+    const MoistureGrid* moisture;
+    float cloudCover;   // Cloud cover at the last update (the grid's, or the weather's)
+    float deckOpacity;  // Opacity at the last update
+    
+    // Rasterize puff extents (or the noise decks) into the coverage histogram
+    void buildCoverage();
+    void buildOccluders();
+    
     // Spawn new cloud
     void spawnCloud(int screenWidth, int screenHeight, const WeatherSystem& weather);
     
+    // Return a cloud to the pool, moving the last cloud's puffs into its block
+    void removeCloud(size_t dense);
+    
     // Generate cloud shape (multiple puffs)
     void generateCloudShape(Cloud& cloud);
     
+    // Render the cloud's puffs into an atlas slot, once per spawn
+    void bakeImpostor(Cloud& cloud);
+    
     // Get cloud color based on weather
     glm::vec4 getCloudColor(const WeatherSystem& weather) const;
 };
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <vector>
+#include "MoistureGrid.h"
+#include "WeatherSystem.h"
+#include "WorkerPool.h"
+
+// Vertical temperature profile over each screen column, from the ground up
+// through the boundary layer.
+//
+// The weather's temperature sets a base profile (falling with height at the
+// standard lapse rate); each column carries its departure from it. The sun
+// heats the lowest level by day (less under cloud), the ground radiates
+// heat away day and night (less under cloud, which sends some back), and the
+// departure relaxes toward zero over about a day. Heat mixes upward by
+// diffusion, far faster where the profile is unstable (convection), so warm
+// afternoons build a deep mixed layer and clear nights a shallow inversion.
+// Diffusion is implicit: every step solves one tridiagonal system per
+// column with the Thomas algorithm, four columns at a time with SSE2
+// (scalar fallback elsewhere), groups of columns split across worker
+// threads. Time runs with the day: one turn of the weather's time of day is
+// a full 24 hours here.
+class ColumnTemperature {
+public:
+    ColumnTemperature(float columnWidth = 8.0f, int levels = 32);
+
+    // Threads for the column solves (may be null: single-threaded)
+    void setWorkerPool(WorkerPool* workers) { this->workers = workers; }
+
+    // Cloud cover per column (may be null: the weather's cover everywhere)
+    void setMoisture(const MoistureGrid* moisture) { this->moisture = moisture; }
+
+    // Columns follow the window width; resizing restarts the profiles
+    void update(float deltaTime, const WeatherSystem& weather, int screenWidth);
+
+    int getColumns() const { return columns; }
+    int getLevels() const { return levels; }
+
+    // Temperature (Celsius) at a column and level (0 is the ground), and at
+    // the lowest level: per column, mean, and extremes across the window
+    float getTemperature(int column, int level) const;
+    const std::vector<float>& getSurfaceTemperatures() const { return surface; }
+    float getSurfaceTemperature() const { return surfaceMean; }
+    float getSurfaceMinimum() const { return surfaceMin; }
+    float getSurfaceMaximum() const { return surfaceMax; }
+
+    // Wall time of the last step
+    float getStepMilliseconds() const { return stepMs; }
+
+private:
+    float columnWidth;
+    int levels;
+    int columns;      // Rounded up to whole SSE lanes
+    int screenWidth;
+    WorkerPool* workers;
+    const MoistureGrid* moisture;
+    float stepMs;
+
+    float base;  // Weather temperature at the last step
+    float surfaceMean, surfaceMin, surfaceMax;
+
+    // Departure from the base profile, levels x columns (level-major, so
+    // each level of the solve is a contiguous run across columns)
+    std::vector<float> anomaly;
+    std::vector<float> coupling;  // Diffusion between a level and the one above, x step / spacing^2
+    std::vector<float> ratio;     // Thomas forward sweep: upper diagonal over pivot
+    std::vector<float> partial;   // Thomas forward sweep: right-hand side over pivot
+    std::vector<float> heating;   // Degrees put into the lowest level this step, per column
+    std::vector<float> surface;
+
+    float stepSeconds;  // Simulated seconds in this step
+    float keep;         // Extra diagonal weight for the relaxation toward the base
+
+    void resize(int screenWidth);
+
+    // Solve groups of four columns [begin, end)
+    void solveGroups(int begin, int end);
+};
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "WorkerPool.h"
+
+struct LightningSegment;
+
+// Dielectric breakdown model (DBM) for lightning channels.
+//
+// The electric potential between the cloud (top row, phi = 0) and the ground
+// (bottom row, phi = 1) is solved on a square grid with insulating sides. The channel starts as a
+// single cell held at the cloud potential. Each step, cells next to the
+// channel are added with probability proportional to phi^eta, those cells
+// join the boundary at phi = 0, and the potential is relaxed again. The next
+// solve starts from the previous solution, so a few sweeps per step suffice.
+//
+// The solver is red-black SOR. Each color is stored in its own half-width
+// array, so one color's update only reads the other color: rows are
+// vectorized four cells at a time with SSE2 and split across worker threads
+// without any two threads writing the same data. After each growth step
+// only a window around the new cells is relaxed, with an occasional sweep
+// over everything down to a margin below the tip; further down, the linear
+// starting profile is still the solution.
+class DielectricBreakdown {
+public:
+    DielectricBreakdown(int gridSize = 512);
+
+    // Threads for the sweeps (may be null: single-threaded)
+    void setWorkerPool(WorkerPool* workers) { this->workers = workers; }
+
+    // Grow one channel to the ground and write it as segments in the bolt
+    // library's unit frame (top at (0, 0), ground at y = 1), main channel
+    // first. Returns the number of segments written, at most `budget`.
+    uint32_t generate(LightningSegment* out, uint32_t budget, uint32_t seed);
+
+    // Statistics of the last generate()
+    float getLastMilliseconds() const { return lastMilliseconds; }
+    int getLastChannelCells() const { return static_cast<int>(channel.size()); }
+
+private:
+    int size;          // Cells per side
+    int halfWidth;     // Cells per row of one color
+    int stride;        // Floats per stored row (half width plus padding)
+    WorkerPool* workers;
+    float lastMilliseconds;
+
+    // Bounds of the color pass being swept, read by the row workers (kept
+    // here so the job captures only this and std::function does not allocate)
+    int sweepColor;
+    int sweepFirstRow;
+    int sweepFirstColumn;
+    int sweepEndColumn;
+
+    // Potential and free-cell mask (1 = solved, 0 = held fixed), one array
+    // per color; cell (x, y) is in color (x + y) & 1 at column x / 2
+    std::vector<float> potential[2];
+    std::vector<float> freeMask[2];
+
+    // Channel cells in growth order, with the index of each one's parent
+    std::vector<uint32_t> channel;
+    std::vector<int32_t> parent;
+    std::vector<uint8_t> state;        // Per cell: 0 free, 1 candidate, 2 channel
+    std::vector<uint32_t> candidates;
+    std::vector<float> candidateCdf;
+    std::vector<int32_t> channelIndex; // Per cell: position in `channel`, or -1
+
+    size_t storageIndex(int x, int y) const { return static_cast<size_t>(y) * stride + 4 + (x >> 1); }
+    float& potentialAt(int x, int y) { return potential[(x + y) & 1][storageIndex(x, y)]; }
+
+    void reset();
+    void fixCell(int x, int y, float value);
+    void addToChannel(uint32_t cell, int32_t parentIndex);
+
+    // SOR sweeps over the cells in [firstX, lastX] x [firstRow, lastRow]
+    // (clipped to the interior)
+    void relax(int sweeps, int firstRow, int lastRow, int firstX, int lastX);
+    void relaxRows(int color, int firstRow, int endRow, int firstColumn, int endColumn);
+
+    // Turn the grown tree into line segments
+    uint32_t buildSegments(LightningSegment* out, uint32_t budget, uint32_t tip);
+};
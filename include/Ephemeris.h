@@ -0,0 +1,60 @@
+#pragma once
+
+#include <vector>
+
+// Sun and moon in the local sky at one instant. Angles are in degrees;
+// azimuth is measured clockwise from north.
+struct EphemerisSample {
+    float sunAltitude;
+    float sunAzimuth;
+    float moonAltitude;
+    float moonAzimuth;
+    float moonPhase;         // Lunar age as a fraction: 0 new, 0.5 full
+    float moonIllumination;  // Lit fraction of the disc
+};
+
+// Low-precision solar and lunar ephemeris for an observing site.
+//
+// Positions come from the Astronomical Almanac's low-precision formulae
+// (about 0.01 degree for the sun, a few tenths for the moon, including the
+// moon's parallax). They are evaluated once per day into a table at a
+// five-minute step; every frame only interpolates two table rows. The table
+// is rebuilt when the date or the site changes.
+class Ephemeris {
+public:
+    Ephemeris();
+
+    void setDate(int year, int month, int day);
+    void getDate(int& year, int& month, int& day) const;
+    // Step the date forward one day (time of day wrapped past midnight)
+    void advanceDay();
+
+    // Latitude and longitude in degrees (north and east positive); the
+    // offset converts local clock time to UT
+    void setSite(float latitude, float longitude, float utcOffsetHours);
+    float getLatitude() const { return latitude; }
+    float getLongitude() const { return longitude; }
+    float getUtcOffset() const { return utcOffset; }
+
+    // Sky at a local time of day (0 = midnight, 1 = next midnight)
+    EphemerisSample sample(float timeOfDay) const;
+
+    // Local times of the sun crossing the horizon, or -1 when it does not
+    // rise (or set) on this date
+    float getSunrise() const { return sunrise; }
+    float getSunset() const { return sunset; }
+
+private:
+    int year, month, day;
+    double julianDay;  // Local midnight, as a Julian date in UT
+    float latitude;
+    float longitude;
+    float utcOffset;
+
+    std::vector<EphemerisSample> table;  // One row per step, plus the next midnight
+    float sunrise;
+    float sunset;
+
+    void rebuildTable();
+    EphemerisSample compute(double julianDate) const;
+};
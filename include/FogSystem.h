@@ -1,27 +1,69 @@
 #pragma once
 
+#include <glad/glad.h>
 #include <glm/glm.hpp>
+#include <vector>
 #include "Renderer.h"
 #include "WeatherSystem.h"
+#include "WorkerPool.h"
 
+// Fog as a coarse 2D density field over the window.
+//
+// The grid has a fixed resolution, whatever the window size, so the cost of
+// a step does not grow with the window; it is stretched over the screen and
+// drawn as a filtered single-channel texture. Each step advects the field
+// with the local wind (semi-Lagrangian: every cell looks back along the
+// wind and interpolates), diffuses it, lets it decay and seeds new fog near
+// the ground from the humidity and the time of day. Rows are processed four
+// cells at a time with SSE2 (scalar fallback elsewhere) and split across
+// worker threads.
 class FogSystem {
 public:
     FogSystem();
+    ~FogSystem();
     
-    void update(float deltaTime, const WeatherSystem& weather);
-    void render(Renderer& renderer, int screenWidth, int screenHeight);
+    // Create the density texture and shader (needs a GL context)
+    void init();
+    void shutdown();
+    
+    // Threads for stepping the grid (may be null: single-threaded)
+    void setWorkerPool(WorkerPool* workers) { this->workers = workers; }
+    
+    void update(float deltaTime, const WeatherSystem& weather, int screenWidth, int screenHeight);
+    void render(Renderer& renderer);
     
     void setEnabled(bool enabled) { this->enabled = enabled; }
     bool isEnabled() const { return enabled; }
     
+    // Mean density over the lower half of the window, 0.0 to 1.0
     float getDensity() const { return density; }
     
 private:
     bool enabled;
-    float density;  // 0.0 to 1.0
-    float targetDensity;
-    float transitionSpeed;
+    float density;
+    float seedPhase;  // Slow drift of the patchy ground seeding
+    WorkerPool* workers;
+    
+    // Inputs of the step in progress, read by the row workers
+    const WeatherSystem* stepWeather;
+    glm::vec2 cellSize;   // Screen size of a cell
+    glm::vec2 windCells;  // Cells moved per unit of wind this step
+    
+    std::vector<float> cells;       // Rows x columns, row-major, row 0 at the ground
+    std::vector<float> advected;    // Advection target, diffused back into cells
+    std::vector<float> rowSeed;     // Seeding rate per row (density per second)
+    std::vector<float> columnSeed;  // Patchiness of the seeding per column
+    std::vector<float> rowDensity;  // Sum of each row after the last step
+    
+    GLuint texture;
+    GLuint program;
+    GLuint vao;  // Empty: the full-screen triangle comes from gl_VertexID
+    GLint uColor, uOpacity;
     
     // Calculate target fog density based on weather
     float calculateTargetDensity(const WeatherSystem& weather) const;
+    
+    // Advect, then diffuse, decay and seed rows [begin, end)
+    void advectRows(size_t begin, size_t end);
+    void diffuseRows(size_t begin, size_t end, float deltaTime);
 };
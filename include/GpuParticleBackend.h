@@ -0,0 +1,83 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+// GPU-resident particle simulation.
+//
+// Particle state lives in two vertex buffers that are ping-ponged each frame:
+// a vertex shader integrates every particle and writes the result into the
+// other buffer with transform feedback (GL 3.3 core, no compute shaders).
+// New particles are emitted into a ring: the CPU only advances the ring head
+// and passes the emit count as a uniform. Rendering reads the same buffer as
+// per-instance attributes, so the CPU never touches individual particles.
+class GpuParticleBackend {
+public:
+    GpuParticleBackend();
+    ~GpuParticleBackend();
+
+    // Create buffers and shaders. Returns false if the GL setup failed, in
+    // which case the caller should stay on the CPU path.
+    bool init(int capacity);
+    void shutdown();
+    bool isInitialized() const { return initialized; }
+
+    // Integrate all particles and emit new ones at the ring head: first
+    // `streakCount` rain streaks, then `discCount` snow discs. Particles die
+    // below groundY.
+    void update(float deltaTime, int streakCount, int discCount, glm::vec2 wind, int screenWidth, float groundY);
+    void render(const glm::mat4& projection);
+
+    // Inverse CDF of the spawn position: table[k] is the x coordinate that a
+    // uniform sample of k / (size - 1) maps to. Uploaded as a 1D texture and
+    // linearly interpolated; until set, spawns are uniform across the screen.
+    void setSpawnTable(const float* table, int size);
+
+    // Drop every particle (used when the CPU path takes over again)
+    void clear();
+
+    int getCapacity() const { return capacity; }
+    // Ring slots processed and drawn: up to the last block written within a
+    // particle lifetime. An upper bound on live particles (exact counts would
+    // need a GPU readback).
+    int getActiveExtent() const { return activeExtent; }
+
+private:
+    // Interleaved per-particle layout shared by the update and render passes
+    struct GpuParticle {
+        glm::vec2 position;
+        glm::vec2 velocity;
+        glm::vec2 life;        // x = remaining lifetime, y = max lifetime
+        glm::vec2 attributes;  // x = size, y = kind
+    };
+
+    bool initialized;
+    int capacity;
+    int emitHead;       // Next ring slot to emit into
+    int activeExtent;   // Slots [0, activeExtent) may hold live particles
+    int filled;         // Slots written since init or clear (all below this have been)
+    float elapsed;      // Simulated time, for expiring ring blocks
+    std::vector<float> blockWritten;  // Time of the newest emit into each block of the ring
+    unsigned int frameSeed;
+    int current;        // Buffer holding the latest state
+
+    GLuint buffers[2];
+    GLuint updateVAO[2];
+    GLuint renderVAO[2];
+    GLuint spawnTexture;
+    int spawnTableSize;
+    GLuint updateProgram;
+    GLuint renderProgram;
+
+    // Cached uniform locations
+    GLint uDeltaTime, uSeed, uEmitStart, uEmitCount, uCapacity, uStreakCount, uWind, uScreenWidth, uGroundY;
+    GLint uSpawnTable, uSpawnTableSize;
+    GLint uProjection;
+
+    // Record an emit into slots [begin, end)
+    void markWritten(int begin, int end);
+
+    GLuint createUpdateProgram();
+    void setupVertexArray(GLuint vao, GLuint buffer, bool instanced);
+};
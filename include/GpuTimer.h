@@ -0,0 +1,31 @@
+#pragma once
+
+#include <glad/glad.h>
+
+// Measures GPU time of a block of GL commands with GL_TIME_ELAPSED queries.
+//
+// Results are read back a few frames later from a small ring of queries, so
+// measuring does not normally stall the pipeline waiting for the GPU.
+class GpuTimer {
+public:
+    GpuTimer();
+    ~GpuTimer();
+
+    void init();
+    void shutdown();
+
+    // Bracket the commands to measure (once per frame, not nested)
+    void begin();
+    void end();
+
+    // Most recent completed measurement, smoothed, in milliseconds
+    float getMilliseconds() const { return milliseconds; }
+
+private:
+    static const int kQueryCount = 4;
+
+    GLuint queries[kQueryCount];
+    bool pending[kQueryCount];
+    int next;
+    float milliseconds;
+};
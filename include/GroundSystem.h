@@ -0,0 +1,80 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+#include "CloudShadowMap.h"
+#include "Renderer.h"
+#include "WeatherSystem.h"
+
+// What a particle impact adds to the ground
+enum class GroundCover {
+    SNOW,   // Snow and ice: builds depth, melts above freezing
+    WATER   // Rain: collects in puddles, evaporates
+};
+
+// Ground heightfield along the bottom of the screen. Particles collide with
+// it; the surface is stored as one height sample per fixed-width column.
+// Snow depth and puddle water accumulate per column on top of it.
+class GroundSystem {
+public:
+    GroundSystem(float columnWidth = 8.0f);
+    
+    // Regenerates the heightfield when the screen size changes, then melts,
+    // evaporates and smooths the accumulation on active columns
+    void update(float deltaTime, const WeatherSystem& weather, int screenWidth, int screenHeight);
+    void render(Renderer& renderer, const WeatherSystem& weather);
+    
+    // Cloud shadows darkening the ground (may be null: evenly lit)
+    void setShadowMap(const CloudShadowMap* shadows) { this->shadows = shadows; }
+    
+    // Bin impact x positions into columns and add cover for each hit,
+    // scaled by `weight`
+    void addImpacts(const std::vector<float>& impactX, GroundCover cover, float weight);
+    
+    // Screen-space y of the ground surface at x, including snow (linearly
+    // interpolated)
+    float getSurfaceY(float x) const;
+    
+    // Highest point of the surface (smallest y); nothing above it can collide
+    float getTopY() const { return topY; }
+    
+    // Mean surface line, for consumers that only need a flat ground
+    float getBaseY() const { return screenHeight - kBaseHeight; }
+    
+    static constexpr float kBaseHeight = 50.0f;  // Mean ground height above the bottom edge
+    
+private:
+    float columnWidth;
+    const CloudShadowMap* shadows;
+    std::vector<float> terrainY;  // Bare ground y per column
+    std::vector<float> surfaceY;  // Terrain minus snow depth, per column
+    float terrainTopY;
+    float topY;
+    int screenWidth;
+    int screenHeight;
+    
+    // Accumulation per column, in pixels
+    std::vector<float> snowDepth;
+    std::vector<float> waterDepth;
+    
+    // Impact histogram: kHistogramLanes interleaved sub-histograms so
+    // consecutive hits on one column do not serialize on the same counter
+    std::vector<float> laneHits;
+    std::vector<float> hits;
+    
+    // Columns with accumulation or new hits; only these are updated
+    std::vector<uint32_t> activeColumns;
+    std::vector<uint8_t> isActive;
+    
+    // Build the rolling-hills heightfield for the current screen size
+    void generateHeightfield();
+    
+    void activateColumn(uint32_t column);
+    
+    // Melt, evaporate and level out one column against its neighbours
+    void updateColumn(uint32_t column, float deltaTime, float meltRate, float evaporationRate);
+    
+    // Get ground color based on time of day
+    glm::vec4 getGroundColor(const WeatherSystem& weather) const;
+};
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "WeatherSystem.h"
+
+// Low-resolution buffer of the light falling on the scene from local
+// sources: lightning channels, and the glow around the sun and the moon.
+//
+// Bolt segments are drawn into an emission target at a fraction of the
+// screen resolution; a separable blur with a fixed kernel spreads them, and
+// the sun and moon are added analytically in the same pass. Clouds,
+// precipitation, fog and the ground sample the result (bound to
+// Renderer::kLightTextureUnit) and add it to their colour, so a strike
+// lights the clouds around it. The cost depends on the buffer size only,
+// not on how many segments the bolts have.
+class LightBuffer {
+public:
+    LightBuffer();
+    ~LightBuffer();
+
+    void init();
+    void shutdown();
+
+    // Redirect drawing into the emission target: everything drawn until
+    // resolve() uses the screen's projection and adds colour x alpha as
+    // light. Returns false when the buffer is disabled, after unbinding it
+    // so the scene reads no light.
+    bool beginEmission(int screenWidth, int screenHeight);
+
+    // Spread the emitted light, add the sun and moon, and bind the result
+    // for the scene's shaders
+    void resolve(const WeatherSystem& weather, glm::vec2 sunPosition, glm::vec2 moonPosition);
+
+    void setEnabled(bool enabled) { this->enabled = enabled; }
+    bool isEnabled() const { return enabled; }
+
+private:
+    bool enabled;
+    int screenWidth;
+    int screenHeight;
+
+    // Emission, horizontal blur and final light, at the reduced resolution
+    GLuint framebuffers[3];
+    GLuint textures[3];
+    int bufferWidth;
+    int bufferHeight;
+
+    GLuint program;
+    GLuint VAO;  // Empty: full-screen triangles come from gl_VertexID
+    GLint uSource, uDirection, uGain, uAspect;
+    GLint uSunPosition, uSunColor, uMoonPosition, uMoonColor, uRadius, uSigma, uSourceRadius;
+
+    void createTargets(int width, int height);
+    void destroyTargets();
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "WeatherSystem.h"
+
+// Crepuscular rays: sunlight streaming through gaps in the clouds.
+//
+// The clouds are drawn a second time into a low-resolution occlusion mask.
+// A radial blur then marches every texel of a second low-resolution target
+// toward the sun, summing the light that gets through the mask, and the
+// result is added over the scene. Both passes run at a fixed fraction of the
+// screen with a fixed number of samples, so the cost does not depend on the
+// clouds. Nothing runs while the sun is down or the sky is nearly clear.
+class LightShafts {
+public:
+    LightShafts();
+    ~LightShafts();
+
+    void init();
+    void shutdown();
+
+    // Decide whether this frame gets shafts and, if so, redirect drawing
+    // into the occlusion mask (everything drawn until endOcclusion() uses
+    // the screen's projection and blocks the light by its alpha). Returns
+    // false, with nothing bound, when the pass is skipped. cloudCover is
+    // the cover the clouds were built from (CloudSystem::getCloudCover).
+    bool beginOcclusion(const WeatherSystem& weather, float cloudCover, glm::vec2 sunPosition, int screenWidth,
+                        int screenHeight);
+    void endOcclusion();
+
+    // Blur the mask toward the sun and add the rays to the framebuffer
+    void composite();
+
+    void setEnabled(bool enabled) { this->enabled = enabled; }
+    bool isEnabled() const { return enabled; }
+
+    // Strength of the last frame's shafts (0 when skipped)
+    float getIntensity() const { return intensity; }
+
+private:
+    bool enabled;
+    float intensity;
+    glm::vec2 sunPosition;  // Screen pixels
+    glm::vec3 color;
+    int screenWidth;
+    int screenHeight;
+
+    // Occlusion mask and rays, both at the reduced resolution
+    GLuint framebuffers[2];
+    GLuint textures[2];
+    int bufferWidth;
+    int bufferHeight;
+
+    GLuint blurProgram;
+    GLuint compositeProgram;
+    GLuint VAO;  // Empty: full-screen triangles come from gl_VertexID
+    GLint uMask, uSunPosition, uAspect, uSamples;
+    GLint uRays, uColor;
+
+    void createTargets(int width, int height);
+    void destroyTargets();
+};
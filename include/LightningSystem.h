@@ -1,29 +1,70 @@
 #pragma once
 
 #include <glm/glm.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
 #include <vector>
+#include "DielectricBreakdown.h"
+#include "ObjectPool.h"
 #include "Renderer.h"
+#include "WorkerPool.h"
 
 struct LightningSegment {
     glm::vec2 start;
     glm::vec2 end;
-    float intensity;  // 0.0 to 1.0
+    float intensity;   // 0.0 to 1.0
+    bool mainChannel;  // Part of the path to the ground (lit again by return strokes)
 };
 
+// One channel shape in the bolt library. Segments are stored in a unit
+// frame: the channel starts at (0, 0) and its main path ends at y = 1.
+struct BoltTemplate {
+    uint32_t segmentStart;  // First segment in the library arena
+    uint32_t segmentCount;
+};
+
+// A strike: a library channel placed on screen, plus its stroke sequence
 struct LightningBolt {
-    std::vector<LightningSegment> segments;
-    float lifetime;
+    uint32_t templateIndex;
+    glm::vec2 origin;     // Screen position of the channel top
+    glm::vec2 scale;      // Unit frame -> pixels; negative x mirrors
+    float lifetime;       // Of the current stroke
     float maxLifetime;
+    float darkTime;       // Gap left before the next return stroke
+    int strokesLeft;      // Return strokes still to come
+    float branchLight;    // Branch brightness (return strokes mostly light the main channel)
     bool active;
 };
 
+// Lightning strikes drawn from a library of precomputed channels.
+//
+// Channel shapes are generated off the frame: a background thread fills the
+// library at startup, growing each channel with an explicit stack and a fixed
+// segment budget straight into a preallocated arena. A strike only picks a
+// ready template with a random mirror and scale, so triggering costs a pool
+// slot and a few random numbers. Strikes can repeat as return strokes that
+// relight the same channel.
+//
+// Optionally, channels grown with the dielectric breakdown model are added
+// to a second part of the library: a worker thread grows one channel at a
+// time into a staging buffer, and update() copies it into a library slot no
+// live strike is using. The solver's sweeps run on a WorkerPool of its own,
+// so they never queue behind or hold up the frame's jobs on the shared one.
 class LightningSystem {
 public:
     LightningSystem(int maxBolts = 5);
+    ~LightningSystem();
     
     void update(float deltaTime);
     void render(Renderer& renderer);
     
+    // Draw the live channels as light sources (into a LightBuffer): one
+    // wide line per segment, its alpha the segment's brightness
+    void renderLight(Renderer& renderer) const;
+    
     // Trigger a new lightning bolt
     void triggerLightning(int screenWidth, int screenHeight);
     
@@ -33,17 +74,58 @@ public:
     void setEnabled(bool enabled) { this->enabled = enabled; }
     bool isEnabled() const { return enabled; }
     
+    // Channels available to strikes (grows while the library is built)
+    int getReadyTemplates() const { return readyTemplates.load(std::memory_order_acquire); }
+    
+    // Strike with dielectric breakdown channels once some have been grown
+    void setBreakdownEnabled(bool enabled);
+    bool isBreakdownEnabled() const { return breakdownEnabled; }
+    int getBreakdownTemplates() const { return breakdownTemplates; }
+    float getBreakdownMilliseconds() const { return breakdownMilliseconds.load(std::memory_order_relaxed); }
+    
 private:
-    std::vector<LightningBolt> bolts;
+    ObjectPool<LightningBolt> bolts;
     int maxBolts;
     bool enabled;
     float flashIntensity;
     
-    // Generate lightning bolt using recursive branching
-    void generateBolt(LightningBolt& bolt, glm::vec2 start, glm::vec2 end, int depth = 0);
+    // Bolt library: a fixed block of the arena per template. Templates
+    // [0, readyTemplates) are complete and never written again.
+    std::vector<LightningSegment> librarySegments;
+    std::vector<BoltTemplate> templates;
+    std::atomic<int> readyTemplates;
+    std::atomic<bool> stopBuilding;
+    std::thread libraryBuilder;
+    
+    // Breakdown channels: grown on breakdownWorker into the staging buffer,
+    // which belongs to the worker until stagingReady is set and to the main
+    // thread until it is cleared again
+    WorkerPool breakdownPool;  // Used only from breakdownWorker
+    DielectricBreakdown breakdown;
+    bool breakdownEnabled;
+    int breakdownTemplates;     // Breakdown slots filled so far
+    int nextBreakdownSlot;      // Next slot to replace once all are filled
+    std::vector<LightningSegment> breakdownStaging;
+    uint32_t breakdownStagingCount;
+    std::atomic<bool> stagingReady;
+    std::atomic<float> breakdownMilliseconds;  // Time to grow the last channel
+    std::mutex breakdownMutex;
+    std::condition_variable breakdownWake;
+    bool breakdownRequested;    // Guarded by breakdownMutex
+    std::thread breakdownWorker;
+    
+    // Fill templates [first, end) (runs on the builder thread)
+    void buildLibrary(int first, int end, uint32_t seed);
+    
+    // Grow breakdown channels while requested (runs on breakdownWorker)
+    void breakdownLoop(uint32_t seed);
+    
+    // Move a finished breakdown channel into the library
+    void acceptBreakdownChannel();
     
-    // Add a branch to the lightning
-    void addBranch(LightningBolt& bolt, glm::vec2 branchStart, glm::vec2 direction, float length, int depth);
+    // Grow one channel into `out`, at most `budget` segments. Returns the
+    // number written.
+    static uint32_t generateChannel(LightningSegment* out, uint32_t budget, uint32_t& rngState);
     
     // Random utility
     float random(float min, float max) const;
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <vector>
+#include "WeatherSystem.h"
+#include "WorkerPool.h"
+
+// Bulk warm-rain microphysics on a coarse grid spanning the window's width
+// and the cloud layer's height (kilometres above the ground, row 0 at the
+// top).
+//
+// Each cell holds water vapour, cloud water and rain water (g/kg) and steps
+// a Kessler scheme: vapour relaxes toward the weather's humidity times the
+// saturation at the row's temperature (a lapse rate down from the
+// temperature at the ground), raised where the air rises; vapour above saturation
+// condenses and cloud water evaporates below it; cloud water turns to rain
+// past a threshold (autoconversion) and is collected by falling rain
+// (accretion); rain evaporates in subsaturated air and falls one row at a
+// time. Where the air rises follows the weather's cloud cover, as a pattern
+// drifting with the wind. Cloud cover per column comes from the cloud water
+// above it and the rain rate from the rain leaving the bottom row.
+//
+// The cell update is branch-free, four columns at a time with SSE2 (scalar
+// fallback elsewhere); rows only share the rain falling in from above, read
+// from the previous step, so they are split across worker threads.
+class MoistureGrid {
+public:
+    // Sizes are rounded up to a multiple of 4 (at least 16 x 8)
+    explicit MoistureGrid(int columns = 128, int rows = 32);
+
+    // Threads for stepping the grid (may be null: single-threaded)
+    void setWorkerPool(WorkerPool* workers) { this->workers = workers; }
+
+    // Change the grid size; the grid restarts from the weather's humidity
+    void setResolution(int columns, int rows);
+    int getColumns() const { return columns; }
+    int getRows() const { return rows; }
+
+    void update(float deltaTime, const WeatherSystem& weather, int screenWidth);
+
+    // Cloud cover over each column (0 to 1), its mean, and the cover at a
+    // fraction of the window's width (clamped)
+    const std::vector<float>& getColumnCover() const { return columnCover; }
+    float getCloudFraction() const { return cloudFraction; }
+    float getCoverAt(float widthFraction) const;
+
+    // Rain leaving the bottom of the grid per column, and its mean (mm/h)
+    const std::vector<float>& getSurfaceRain() const { return surfaceRain; }
+    float getRainRate() const { return rainRate; }
+
+    // Wall time of the last step
+    float getStepMilliseconds() const { return stepMs; }
+
+private:
+    int columns;
+    int rows;
+    WorkerPool* workers;
+    float stepMs;
+    bool started;  // False until the first step fills in the vapour
+
+    float liftPhase;  // Drift of the rising air pattern (radians)
+
+    // Mixing ratios (g/kg), rows x columns; rain is double-buffered since
+    // each row takes in what fell from the row above during the last step
+    std::vector<float> vapor, cloud, rain, rainNext;
+    std::vector<float> rowSaturation;  // Saturation mixing ratio per row
+    std::vector<float> rowTarget;      // Vapour the row relaxes toward in still air
+    std::vector<float> rowLift;        // Extra vapour per unit of lift (fraction of rowTarget)
+    std::vector<float> rowThreshold;   // Cloud water at which autoconversion starts
+    std::vector<float> columnLift;     // Rising air per column (0 to 1)
+    std::vector<float> columnCover;
+    std::vector<float> columnPath;     // Cloud water path per column (g/m^2)
+    std::vector<float> surfaceRain;
+    float cloudFraction;
+    float rainRate;
+
+    // Per-step coefficients of the cell update
+    float supply;     // Share of the vapour deficit restored this step
+    float fall;       // Share of each cell's rain falling out of it this step
+    float keepCloud;  // Share of cloud water not mixed out this step
+    float autoconversion, accretion, evaporation;  // Rate constants x step
+
+    // Step rows [begin, end)
+    void stepRows(int begin, int end);
+};
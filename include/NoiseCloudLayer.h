@@ -0,0 +1,78 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+#include "WorkerPool.h"
+
+// One parallax deck of procedural clouds.
+//
+// A coarse grid of fBm value noise covers the deck band; it is uploaded as a
+// single-channel texture and turned into cloud density and color by a
+// shader, with the coverage threshold applied there so cloud cover changes
+// cost nothing on the CPU. The grid is a ring buffer in x: as the wind moves
+// the deck, only the world columns that scroll into view are evaluated and
+// uploaded, the rest just shift by a texture offset. Columns are evaluated
+// four rows at a time with SSE2 (scalar fallback elsewhere), split across
+// worker threads when many are needed at once.
+class NoiseCloudLayer {
+public:
+    struct Settings {
+        float top;         // Screen y of the deck band
+        float height;
+        float frequency;   // Base noise frequency, per grid cell
+        float parallax;    // Drift speed relative to the nearest deck
+        float opacity;     // Relative to the weather's cloud opacity
+        float brightness;  // Color multiplier (far decks are hazier)
+        uint32_t seed;
+    };
+
+    NoiseCloudLayer(float cellSize = 4.0f);
+    ~NoiseCloudLayer();
+
+    // Owns GL objects: not copyable
+    NoiseCloudLayer(const NoiseCloudLayer&) = delete;
+    NoiseCloudLayer& operator=(const NoiseCloudLayer&) = delete;
+
+    void init(const Settings& settings);
+    void shutdown();
+
+    // Scroll with the wind and evaluate newly exposed columns
+    void update(float deltaTime, float windX, int screenWidth, WorkerPool* workers);
+    void render(const glm::mat4& projection, const glm::vec4& color, float cloudCover);
+
+    // Add this deck's cloud weight to a coverage histogram (same units as
+    // CloudSystem's puff coverage)
+    void accumulateCoverage(std::vector<float>& coverage, float columnWidth, float cloudCover, float opacity) const;
+
+    // Screen y of the middle of the deck band
+    float getCenterY() const { return settings.top + settings.height * 0.5f; }
+
+    // Columns evaluated by the last update (all of them after a resize)
+    int getLastUpdatedColumns() const { return lastUpdatedColumns; }
+
+private:
+    float cellSize;
+    Settings settings;
+    int columns;
+    int rows;
+    double offset;                // World column at the left screen edge
+    long long firstColumn;        // World column stored in the ring's valid range start
+    int lastUpdatedColumns;
+
+    std::vector<uint8_t> field;   // rows x columns, row-major, ring-indexed in x
+
+    GLuint texture;
+    GLuint shaderProgram;
+    GLuint VAO;
+    GLint uProjection, uTop, uHeight, uCellSize, uColumns, uRows, uOffset, uThreshold, uColor, uScreenWidth;
+    int screenWidth;
+
+    void resize(int screenWidth, WorkerPool* workers);
+
+    // Evaluate world columns [begin, end) into the ring
+    void computeColumns(long long begin, long long end, WorkerPool* workers);
+    void uploadColumns(long long begin, long long end);
+    int slotOf(long long worldColumn) const;
+};
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Stable reference to an object living in an ObjectPool. The generation is
+// bumped every time a slot is released, so a handle to a recycled slot is
+// detected as stale instead of silently aliasing the new occupant.
+struct PoolHandle {
+    uint32_t index = UINT32_MAX;
+    uint32_t generation = 0;
+
+    bool isValid() const { return index != UINT32_MAX; }
+    bool operator==(const PoolHandle& other) const {
+        return index == other.index && generation == other.generation;
+    }
+    bool operator!=(const PoolHandle& other) const { return !(*this == other); }
+};
+
+// Fixed-capacity object pool with O(1) acquire and swap-remove release.
+//
+// Live objects are packed densely in [0, size()) so iteration is a linear walk.
+// All storage is allocated once in the constructor; released objects are
+// swapped to the tail rather than destroyed, which lets types that own
+// buffers (e.g. a std::vector of segments) keep their capacity for reuse.
+template <typename T>
+class ObjectPool {
+public:
+    explicit ObjectPool(size_t capacity)
+        : items(capacity), denseToSlot(capacity), slotToDense(capacity),
+          generations(capacity, 0), count(0) {
+        freeSlots.reserve(capacity);
+        for (size_t i = capacity; i > 0; i--) {
+            freeSlots.push_back(static_cast<uint32_t>(i - 1));
+        }
+    }
+
+    // Take an object from the pool. Returns nullptr when the pool is full.
+    // The returned object is recycled, not reset: callers must initialise it.
+    T* acquire(PoolHandle* handle = nullptr) {
+        if (freeSlots.empty()) return nullptr;
+
+        uint32_t slot = freeSlots.back();
+        freeSlots.pop_back();
+
+        size_t dense = count++;
+        denseToSlot[dense] = slot;
+        slotToDense[slot] = static_cast<uint32_t>(dense);
+
+        if (handle) {
+            handle->index = slot;
+            handle->generation = generations[slot];
+        }
+        return &items[dense];
+    }
+
+    // Release the object at a dense index. The last live object is swapped
+    // into its place, so callers iterating forward must not advance the index.
+    void releaseAt(size_t dense) {
+        size_t last = count - 1;
+        uint32_t slot = denseToSlot[dense];
+
+        if (dense != last) {
+            std::swap(items[dense], items[last]);
+            uint32_t movedSlot = denseToSlot[last];
+            denseToSlot[dense] = movedSlot;
+            slotToDense[movedSlot] = static_cast<uint32_t>(dense);
+        }
+
+        generations[slot]++;
+        freeSlots.push_back(slot);
+        count--;
+    }
+
+    void release(PoolHandle handle) {
+        if (get(handle)) {
+            releaseAt(slotToDense[handle.index]);
+        }
+    }
+
+    // Resolve a handle; returns nullptr if the object has since been released.
+    T* get(PoolHandle handle) {
+        if (!handle.isValid() || handle.index >= generations.size()) return nullptr;
+        if (generations[handle.index] != handle.generation) return nullptr;
+        uint32_t dense = slotToDense[handle.index];
+        if (dense >= count || denseToSlot[dense] != handle.index) return nullptr;
+        return &items[dense];
+    }
+
+    PoolHandle handleAt(size_t dense) const {
+        PoolHandle handle;
+        handle.index = denseToSlot[dense];
+        handle.generation = generations[handle.index];
+        return handle;
+    }
+
+    void clear() {
+        while (count > 0) {
+            releaseAt(count - 1);
+        }
+    }
+
+    // Run a function over every slot, live or not. Used to pre-size buffers
+    // owned by pooled objects so that steady-state reuse never allocates.
+    template <typename Fn>
+    void forEachSlot(Fn fn) {
+        for (auto& item : items) {
+            fn(item);
+        }
+    }
+
+    size_t size() const { return count; }
+    size_t capacity() const { return items.size(); }
+    bool empty() const { return count == 0; }
+    bool full() const { return count == items.size(); }
+
+    T& operator[](size_t dense) { return items[dense]; }
+    const T& operator[](size_t dense) const { return items[dense]; }
+
+    T* begin() { return items.data(); }
+    T* end() { return items.data() + count; }
+    const T* begin() const { return items.data(); }
+    const T* end() const { return items.data() + count; }
+
+private:
+    std::vector<T> items;               // Dense storage, live objects first
+    std::vector<uint32_t> denseToSlot;  // Dense index -> handle slot
+    std::vector<uint32_t> slotToDense;  // Handle slot -> dense index
+    std::vector<uint32_t> generations;  // Per-slot generation counter
+    std::vector<uint32_t> freeSlots;    // Stack of unused handle slots
+    size_t count;
+};
@@ -2,15 +2,43 @@
 
 #include <glm/glm.hpp>
 #include <vector>
+#include "GpuParticleBackend.h"
+#include "GroundSystem.h"
+#include "MoistureGrid.h"
+#include "ObjectPool.h"
+#include "PrecipitationField.h"
 #include "Renderer.h"
+#include "SpatialGrid.h"
 #include "WeatherSystem.h"
 
 enum class ParticleType {
     RAIN,
     SNOW,
+    SLEET,   // Ice pellets near freezing
+    HAIL,    // Heavy ice that bounces off the ground
+    SPLASH,  // Short-lived droplets thrown up where rain hits the ground
     NONE
 };
 
+// One emitter per particle kind; all emitters share the particle arena
+const int kParticleTypeCount = static_cast<int>(ParticleType::NONE);
+
+struct ParticleEmitter {
+    ParticleType type;
+    float spawnRate;      // Particles per second at full weight
+    float weight;         // Current strength, eases toward targetWeight
+    float targetWeight;   // Set from the weather each tick
+    int budget;           // Max live particles for this emitter
+    int liveCount;        // Live particles it currently owns in the arena
+    int evictDebt;        // Particles to give back to the arena at the next cleanup
+    float fractional;     // Sub-particle spawn carry between frames
+};
+
+enum class ParticleBackend {
+    CPU,    // Particles simulated and batched on the CPU
+    GPU     // Transform-feedback simulation, particle state stays on the GPU
+};
+
 struct Particle {
     glm::vec2 position;
     glm::vec2 velocity;
@@ -18,33 +46,149 @@ struct Particle {
     float lifetime;
     float maxLifetime;
     glm::vec4 color;
+    ParticleType type;
+    bool grounded;  // Landed on the ground this tick (removed by the cleanup)
+};
+
+// A particle reaching the ground this tick
+struct ParticleImpact {
+    glm::vec2 position;
+    glm::vec2 velocity;
+    ParticleType type;
 };
 
 class ParticleSystem {
 public:
-    ParticleSystem(int maxParticles = 1000);
+    ParticleSystem(int maxParticles = 1000, int gpuCapacity = 1 << 20);
     
     void update(float deltaTime, const WeatherSystem& weather, int screenWidth, int screenHeight);
     void render(Renderer& renderer);
     
-    void setParticleType(ParticleType type);
+    // Ground the particles collide with (may be null: no collisions)
+    void setGround(const GroundSystem* ground) { this->ground = ground; }
+    
+    // Moisture grid whose rain rate sets how much falls (may be null: the
+    // weather state decides)
+    void setMoisture(const MoistureGrid* moisture) { this->moisture = moisture; }
+    
+    // Dominant precipitation type (the emitter with the highest target weight)
     ParticleType getParticleType() const { return currentType; }
     
+    // Emitters, indexed by particle type. Several run at once and crossfade
+    // as the weather changes instead of clearing the arena.
+    ParticleEmitter& getEmitter(ParticleType type) { return emitters[static_cast<int>(type)]; }
+    const ParticleEmitter& getEmitter(ParticleType type) const { return emitters[static_cast<int>(type)]; }
+    void setEmitterBudget(ParticleType type, int budget) { getEmitter(type).budget = budget; }
+    void setEmitterRate(ParticleType type, float rate) { getEmitter(type).spawnRate = rate; }
+    
+    // Sample precipitation spawn positions under the clouds. coverage[i] is
+    // the cloud weight over the i-th column of columnWidth pixels; until this
+    // is called, spawn positions are uniform across the screen.
+    void setSpawnCoverage(const std::vector<float>& coverage, float columnWidth);
+    
+    // Also scale the overall spawn rate with how much cloud there is (off by
+    // default: coverage only decides where precipitation falls)
+    void setCoverageRateScaling(bool enabled);
+    bool isCoverageRateScaling() const { return coverageRateScaling; }
+    float getCoverageScale() const { return coverageScale; }
+    
+    // Route precipitation through the Eulerian mass field (CPU backend only):
+    // particles are created where field mass enters the window and give
+    // their mass back when they leave it through the sides
+    void setFieldEnabled(bool enabled);
+    bool isFieldEnabled() const { return fieldEnabled; }
+    const PrecipitationField& getField() const { return field; }
+    
     void setIntensity(float intensity) { this->intensity = intensity; }
     float getIntensity() const { return intensity; }
     
+    // Spawn-rate multiplier on top of intensity (the GPU backend can sustain
+    // far more particles than the CPU cap)
+    void setDensity(float density) { this->density = density; }
+    float getDensity() const { return density; }
+    
+    // Switch simulation backend. Falls back to CPU if the GPU path cannot
+    // be initialised on this context.
+    void setBackend(ParticleBackend backend);
+    ParticleBackend getBackend() const { return backend; }
+    
+    // x of this tick's ground impacts that leave snow (snow, sleet, hail)
+    // or water (rain) behind, for the ground accumulation
+    const std::vector<float>& getSnowImpactX() const { return snowImpactX; }
+    const std::vector<float>& getRainImpactX() const { return rainImpactX; }
+    
+    // Live particles (CPU) or an upper bound on them (GPU)
+    size_t getParticleCount() const;
+    
 private:
-    std::vector<Particle> particles;
+    ObjectPool<Particle> particles;
+    ParticleEmitter emitters[kParticleTypeCount];
     ParticleType currentType;
     int maxParticles;
     float intensity;  // 0.0 to 1.0
+    float density;
+    
+    ParticleBackend backend;
+    GpuParticleBackend gpuBackend;
+    int gpuCapacity;
+    
+    const GroundSystem* ground;
+    const MoistureGrid* moisture;
+    SpatialGrid collisionGrid;
+    std::vector<ParticleImpact> impacts;   // Ground hits recorded this tick
+    std::vector<float> snowImpactX;        // Impact x by cover kind (SoA, for binning)
+    std::vector<float> rainImpactX;
+    std::vector<uint32_t> renderOrder;     // Particle indices grouped by kind
+    
+    // Spawn distribution: inclusive prefix sum of the coverage histogram,
+    // and the inverse CDF resampled to a fixed-size table for the GPU path
+    std::vector<float> spawnCdf;
+    std::vector<float> spawnTable;
+    float spawnColumnWidth;
+    bool coverageRateScaling;
+    float coverageScale;  // Spawn-rate factor from overall cloud coverage (1 unless scaling)
+    bool hasSpawnCoverage;
+    std::vector<float> spawnCoverage;  // Last coverage histogram, for the field sources
+    
+    PrecipitationField field;
+    bool fieldEnabled;
+    float fieldTypeCdf[kParticleTypeCount];  // Emitter split for field drops
+    int screenWidth;
+    int screenHeight;
     
-    // Spawn new particles
-    void spawnParticle(int screenWidth, int screenHeight, const WeatherSystem& weather);
+    // Point emitter target weights at the current weather
+    void updateEmitterWeights(float deltaTime, const WeatherSystem& weather);
+    
+    // Take a slot from the arena for an emitter. Returns null if refused;
+    // if the arena is full, an emitter above its fair share then owes a
+    // particle, removed by the next cleanup.
+    Particle* acquireParticle(ParticleType type);
+    void evictForFairShare(ParticleType type);
+    void clearParticles();
+    
+    // Spawn x coordinate drawn from the coverage CDF (binary search)
+    float sampleSpawnX(int screenWidth) const;
+    void buildSpawnTable();
+    
+    // Feed, advect and drain the precipitation field
+    void spawnFromField(float deltaTime, const WeatherSystem& weather);
+    
+    // Spawn a new particle of the given type. Returns false if the arena
+    // refused it.
+    bool spawnParticle(ParticleType type, glm::vec2 position, const WeatherSystem& weather);
+    
+    // Spawn droplets where a raindrop hit the ground
+    void spawnSplash(glm::vec2 impact, glm::vec2 impactVelocity);
     
     // Update individual particle
     void updateParticle(Particle& particle, float deltaTime, const WeatherSystem& weather);
     
-    // Remove dead particles
+    // Broad phase on the collision grid, then exact tests against the ground
+    void resolveGroundCollisions();
+    
+    // Remove dead particles, and those owed back for eviction
     void cleanupParticles();
+    
+    // Draw one particle (geometry depends on its type)
+    void renderParticle(Renderer& renderer, const Particle& particle) const;
 };
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include "WeatherSystem.h"
+
+// Coarse Eulerian field of precipitation mass, in units of particles.
+//
+// The field spans a world several screens wide, with the window in the
+// middle, and starts a couple of cells above the top of the screen. Clouds
+// feed mass into the top rows, and the whole field is advected by the fall
+// speed and the wind. Mass that reaches the bottom off-screen rains out.
+// Inside the window, whole units of mass are handed out as explicit
+// particles; particles that leave the window through the sides are
+// deposited back. The number of simulated drops therefore depends on the
+// window area, not on how far the storm extends.
+class PrecipitationField {
+public:
+    PrecipitationField(float cellSize = 32.0f, int worldScreens = 3);
+    
+    // Size the grid for a window; a no-op unless the size changed
+    void resize(int viewWidth, int viewHeight);
+    
+    // Feed mass into the cloud rows. `rate` is particles per second over one
+    // window width at full cover. Inside the window the source follows the
+    // cloud coverage histogram (columns of coverageColumnWidth pixels, empty
+    // for uniform); beyond it, humidity and cloud cover.
+    void addSources(float deltaTime, float rate, const WeatherSystem& weather,
+                    const std::vector<float>& coverage, float coverageColumnWidth);
+    
+    // Move mass with a uniform velocity (conservative upwind scheme)
+    void advect(float deltaTime, glm::vec2 velocity);
+    
+    // Hand whole units of mass in the window out as particles.
+    // spawn(cellMin, cellSize, count) receives screen coordinates and returns
+    // how many particles it actually created; the rest stays in the field.
+    template <typename SpawnFn>
+    void extractVisible(SpawnFn spawn) {
+        for (int row = 0; row < rows; row++) {
+            for (int column = firstVisibleColumn; column < endVisibleColumn; column++) {
+                float& mass = cells[row * columns + column];
+                int count = static_cast<int>(mass);
+                if (count <= 0) continue;
+                
+                glm::vec2 cellMin(column * cellSize - viewOffset, originY + row * cellSize);
+                int spawned = spawn(cellMin, cellSize, count);
+                mass -= static_cast<float>(spawned);
+            }
+        }
+    }
+    
+    // Return mass at a screen position (clamped into the field)
+    void deposit(glm::vec2 screenPosition, float mass);
+    
+    void clear();
+    float getTotalMass() const;
+    
+    // Mean coverage weight at which precipitation reaches its full rate, and
+    // the cap on the boost beneath dense, overlapping storm clouds
+    static constexpr float kFullCoverage = 2.0f;
+    static constexpr float kMaxCoverageScale = 1.5f;
+    
+private:
+    float cellSize;
+    int worldScreens;
+    int viewWidth;
+    int viewHeight;
+    float viewOffset;  // World x of the window's left edge
+    float originY;     // Screen y of the top row
+    int columns;
+    int rows;
+    int firstVisibleColumn;
+    int endVisibleColumn;
+    float sourcePhase;  // Drift of the off-screen cloud pattern
+    
+    std::vector<float> cells;    // rows * columns, row-major
+    std::vector<float> scratch;  // Advection target
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "ParticleSystem.h"
+#include "Renderer.h"
+#include "WeatherSystem.h"
+
+// Far-field rain drawn as scrolling streak textures.
+//
+// Only the nearest rain is simulated as particles. Behind it, a middle and a
+// far layer each cover the screen with one textured quad: a tiling streak
+// texture is sheared by the wind and scrolled downward in the shader, and
+// the fraction of streaks shown follows the rain intensity. Each layer costs
+// one draw call however heavy the storm gets.
+class RainLayerSystem {
+public:
+    RainLayerSystem();
+    ~RainLayerSystem();
+
+    // Create the streak texture and shader (needs a GL context)
+    void init();
+    void shutdown();
+
+    void update(float deltaTime, const WeatherSystem& weather, const ParticleSystem& particles);
+    void render(Renderer& renderer, const WeatherSystem& weather, int screenWidth, int screenHeight);
+
+    void setEnabled(bool enabled) { this->enabled = enabled; }
+    bool isEnabled() const { return enabled; }
+
+    // 0 (no layered rain) to 1 (full storm), derived from the rain emitters
+    float getStrength() const { return strength; }
+
+private:
+    struct Layer {
+        float tileSize;    // Screen pixels covered by one texture repeat
+        float fallSpeed;   // Pixels per second at full strength
+        float windScale;   // Apparent wind drift (smaller for distant rain)
+        float opacity;
+        float haze;        // How far the streak color is blended into the sky
+        float scroll;      // Current vertical texture offset, in [0, 1)
+        float shear;       // Horizontal drift per pixel of fall
+    };
+
+    static const int kLayerCount = 2;
+    Layer layers[kLayerCount];  // Far first, drawn back to front
+
+    bool enabled;
+    float strength;
+
+    GLuint streakTexture;
+    GLuint shaderProgram;
+    GLuint VAO;  // Empty: the quad is generated from gl_VertexID
+
+    GLint uScreenSize, uTileSize, uScroll, uShear, uDensity, uColor;
+
+    // Fill the tiling streak texture (R = brightness, G = visibility threshold)
+    void createStreakTexture();
+};
@@ -14,20 +14,42 @@ public:
     void shutdown();
 
     // Drawing primitives
-    void drawCircle(const glm::vec2& center, float radius, const glm::vec4& color);
+    void drawCircle(const glm::vec2& center, float radius, const glm::vec4& color, int segments = 32);
     void drawRectangle(const glm::vec2& position, const glm::vec2& size, const glm::vec4& color);
     void drawLine(const glm::vec2& start, const glm::vec2& end, float thickness, const glm::vec4& color);
     
     // Batch rendering
     void begin();
     void end();
+    
+    // Draw everything batched so far and start a new batch. Systems that
+    // issue their own draw calls flush first to keep back-to-front order.
+    void flush();
 
+    // Share of the light buffer (see LightBuffer) added to what is drawn
+    // from here on: 0 for light sources and the sky, 1 for lit surfaces.
+    // Flushes when it changes.
+    void setLighting(float amount);
+    
+    // Texture unit the light buffer stays bound to during a frame
+    static const int kLightTextureUnit = 3;
+    
+    // Point a program's "lightBuffer" sampler at that unit
+    static void useLightBuffer(GLuint program);
+    
     // Set viewport/projection
     void setProjection(int width, int height);
+    const glm::mat4& getProjection() const { return projection; }
+    
+    // Shader compilation (shared with systems that own their own programs)
+    static GLuint compileShader(GLenum type, const char* source);
+    static GLuint createShaderProgram(const char* vertexSrc, const char* fragmentSrc);
 
 private:
     GLuint shaderProgram;
     GLuint VAO, VBO;
+    GLint uLighting;
+    float lighting;
     
     struct Vertex {
         glm::vec2 position;
@@ -35,10 +57,7 @@ private:
     };
     
     std::vector<Vertex> vertices;
-    
-    // Shader compilation
-    GLuint compileShader(GLenum type, const char* source);
-    GLuint createShaderProgram(const char* vertexSrc, const char* fragmentSrc);
+    glm::mat4 projection;
     
     // Circle generation
     void generateCircleVertices(const glm::vec2& center, float radius, const glm::vec4& color, int segments = 32);
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Uniform grid broad phase, rebuilt from scratch every tick.
+//
+// build() bins items with a counting sort: count per cell, prefix-sum into
+// cell start offsets, then scatter item indices. The result is one flat index
+// array where every cell's items are contiguous, so a query is a couple of
+// array lookups and a linear walk. All buffers are reused between builds.
+class SpatialGrid {
+public:
+    SpatialGrid(float cellSize = 32.0f);
+
+    // Set the covered area. Items outside it are clamped into the border cells.
+    void setBounds(glm::vec2 minCorner, glm::vec2 maxCorner);
+
+    // Rebuild from `count` items; position(i) returns the i-th item's position
+    template <typename PositionFn>
+    void build(size_t count, PositionFn position) {
+        cellOfItem.resize(count);
+        sortedItems.resize(count);
+        std::fill(cellStart.begin(), cellStart.end(), 0u);
+
+        // Count items per cell (cellStart[c + 1] holds the count of cell c)
+        for (size_t i = 0; i < count; i++) {
+            uint32_t cell = cellIndex(position(i));
+            cellOfItem[i] = cell;
+            cellStart[cell + 1]++;
+        }
+
+        // Exclusive prefix sum -> first slot of each cell
+        for (size_t c = 1; c < cellStart.size(); c++) {
+            cellStart[c] += cellStart[c - 1];
+        }
+
+        // Scatter, using cellCursor as the running write offset per cell
+        cellCursor.assign(cellStart.begin(), cellStart.end() - 1);
+        for (size_t i = 0; i < count; i++) {
+            sortedItems[cellCursor[cellOfItem[i]]++] = static_cast<uint32_t>(i);
+        }
+    }
+
+    // Items in a cell are sortedItems()[cellBegin(c) .. cellEnd(c))
+    uint32_t cellBegin(int cx, int cy) const { return cellStart[cy * columns + cx]; }
+    uint32_t cellEnd(int cx, int cy) const { return cellStart[cy * columns + cx + 1]; }
+    const std::vector<uint32_t>& getSortedItems() const { return sortedItems; }
+
+    int getColumns() const { return columns; }
+    int getRows() const { return rows; }
+    float getCellSize() const { return cellSize; }
+
+    // Cell row/column containing a coordinate (clamped to the grid)
+    int rowAt(float y) const {
+        int row = static_cast<int>(std::floor((y - origin.y) * inverseCellSize));
+        return std::min(std::max(row, 0), rows - 1);
+    }
+    int columnAt(float x) const {
+        int column = static_cast<int>(std::floor((x - origin.x) * inverseCellSize));
+        return std::min(std::max(column, 0), columns - 1);
+    }
+
+private:
+    float cellSize;
+    float inverseCellSize;
+    glm::vec2 origin;
+    int columns;
+    int rows;
+
+    std::vector<uint32_t> cellStart;    // columns * rows + 1 offsets
+    std::vector<uint32_t> cellCursor;   // Scratch write offsets during build
+    std::vector<uint32_t> cellOfItem;   // Cell of each item, from the count pass
+    std::vector<uint32_t> sortedItems;  // Item indices grouped by cell
+
+    uint32_t cellIndex(glm::vec2 position) const {
+        return static_cast<uint32_t>(rowAt(position.y) * columns + columnAt(position.x));
+    }
+};
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// One catalog entry, exactly as stored in the file and uploaded to the GPU.
+// position is pre-projected onto the sky band: x runs 0..1 across the window,
+// y runs 0 (top) to 1 (lowest star row). colorIndex is B-V.
+struct CatalogStar {
+    glm::vec2 position;
+    float magnitude;
+    float colorIndex;
+};
+
+// A run of stars sharing one whole-magnitude band. Stars are sorted
+// brightest first, so drawing the first n buckets is drawing a prefix.
+struct StarBucket {
+    uint32_t first;
+    uint32_t count;
+    float minMagnitude;
+    float maxMagnitude;
+};
+
+// Read-only star catalog.
+//
+// The binary file is a 16-byte header ("STAR", version, star count, bucket
+// count), the bucket table, then the star records. It is memory-mapped and
+// used in place: opening only validates the header and sizes, and the pages
+// of a bucket are read from disk the first time something touches them.
+// The project ships no catalog file and no converter: Application looks for
+// an optional stars.bin in the working directory, converted elsewhere from
+// a star database into this layout (native byte order, buckets in the order
+// setStars() builds them). Without a file, an in-memory catalog can be
+// built with setStars().
+class StarCatalog {
+public:
+    StarCatalog();
+    ~StarCatalog();
+
+    // Map a catalog file. Returns false (and leaves the catalog empty) if it
+    // is missing or malformed.
+    bool open(const std::string& path);
+    void close();
+    bool isMapped() const { return mapping != nullptr; }
+
+    // Replace the contents with an in-memory catalog (sorted and bucketed here)
+    void setStars(std::vector<CatalogStar> entries);
+
+    const CatalogStar* getStars() const { return stars; }
+    size_t getStarCount() const { return starCount; }
+    const StarBucket* getBuckets() const { return buckets; }
+    int getBucketCount() const { return bucketCount; }
+
+    // Number of leading buckets holding any star at least as bright as
+    // `limitingMagnitude`
+    int bucketsBrighterThan(float limitingMagnitude) const;
+
+private:
+    // The mapped file, or null for an in-memory catalog
+    const unsigned char* mapping;
+    size_t mappingSize;
+#if defined(_WIN32)
+    void* fileHandle;
+    void* mappingHandle;
+#endif
+
+    const CatalogStar* stars;
+    size_t starCount;
+    const StarBucket* buckets;
+    int bucketCount;
+
+    std::vector<CatalogStar> ownedStars;
+    std::vector<StarBucket> ownedBuckets;
+
+    static void sortAndBucket(std::vector<CatalogStar>& entries, std::vector<StarBucket>& bucketTable);
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <glad/glad.h>
+
+// History buffer that turns particles into motion trails.
+//
+// Precipitation is drawn into an offscreen texture instead of the screen.
+// Each frame the previous contents are faded by exp(-dt / decayTime) before
+// the new particles are added, so every drop leaves a trail over several
+// frames and a sparse set of particles reads as dense rain. The history is
+// stored premultiplied and composited over the scene in one full-screen pass.
+// It can run below screen resolution; trails are soft anyway.
+class TrailBuffer {
+public:
+    TrailBuffer();
+    ~TrailBuffer();
+
+    void init();
+    void shutdown();
+
+    // Redirect drawing into the history buffer, after fading what is there.
+    // Everything drawn until endCapture() uses the screen's projection.
+    void beginCapture(float deltaTime, int screenWidth, int screenHeight);
+    void endCapture();
+
+    // Blend the history over the current framebuffer
+    void composite();
+
+    // Drop the history (e.g. when trails are switched back on)
+    void clear();
+
+    // Time for a trail to fade to 1/e, in seconds
+    void setDecayTime(float seconds) { decayTime = seconds; }
+    float getDecayTime() const { return decayTime; }
+
+    // History resolution relative to the screen (0.25 to 1)
+    void setResolutionScale(float scale) { resolutionScale = scale; }
+    float getResolutionScale() const { return resolutionScale; }
+
+private:
+    GLuint framebuffers[2];
+    GLuint textures[2];
+    int current;        // Texture holding the latest history
+    int bufferWidth;
+    int bufferHeight;
+    int screenWidth;
+    int screenHeight;
+    float decayTime;
+    float resolutionScale;
+    bool needsClear;
+
+    GLuint fadeProgram;
+    GLuint compositeProgram;
+    GLuint VAO;  // Empty: full-screen triangles come from gl_VertexID
+    GLint uFadeHistory, uFadeFactor;
+    GLint uCompositeHistory;
+
+    // (Re)create both render targets at the given size
+    void createTargets(int width, int height);
+    void destroyTargets();
+};
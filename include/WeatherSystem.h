@@ -2,6 +2,10 @@
 
 #include <glm/glm.hpp>
 #include <string>
+#include "Ephemeris.h"
+
+class WindField;
+class ColumnTemperature;
 
 enum class WeatherState {
     CLEAR,
@@ -31,12 +35,35 @@ public:
     float getTimeOfDay() const { return timeOfDay; }
     glm::vec2 getWindVector() const { return windVector; }
 
+    // Local wind at a screen position: the wind field's when one is
+    // attached, otherwise the prevailing wind everywhere
+    void setWindField(const WindField* field) { windField = field; }
+    glm::vec2 getWindAt(glm::vec2 screenPosition) const;
+
+    // Temperature at the ground: the column model's mean when one is
+    // attached (the weather's temperature is then the base of its
+    // profiles), otherwise the weather's temperature itself
+    void setColumnTemperature(const ColumnTemperature* columns) { columnTemperature = columns; }
+    float getSurfaceTemperature() const;
+
     // Weather variable setters
     void setTemperature(float temp) { temperature = temp; }
     void setPressure(float pres) { pressure = pres; }
     void setHumidity(float hum) { humidity = hum; }
     void setCloudCover(float cover) { cloudCover = cover; }
-    void setTimeOfDay(float time) { timeOfDay = time; }
+    void setTimeOfDay(float time);
+
+    // Observing date and site for the sun and moon (see Ephemeris)
+    void setDate(int year, int month, int day);
+    void setSite(float latitude, float longitude, float utcOffsetHours);
+    const Ephemeris& getEphemeris() const { return ephemeris; }
+    // Sun and moon at the current time of day
+    const EphemerisSample& getSky() const { return sky; }
+
+    // Time of day rescaled so the site's sunrise falls at 0.25 and sunset at
+    // 0.75; code keyed to a fixed dawn and dusk reads this instead of
+    // getTimeOfDay
+    float getDayPhase() const;
 
     // Weather variables
     float temperature;        // In Celsius (-20 to 40)
@@ -59,6 +86,11 @@ public:
 private:
     WeatherState currentState;
     
+    Ephemeris ephemeris;
+    EphemerisSample sky;
+    const WindField* windField;
+    const ColumnTemperature* columnTemperature;
+    
     // State transition logic
     void updateStateTransitions(float deltaTime);
     float stateTransitionTimer;
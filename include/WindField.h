@@ -0,0 +1,110 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include "WeatherSystem.h"
+#include "WorkerPool.h"
+
+// 2D wind over the window, solved with stable fluids.
+//
+// The grid has a fixed resolution (configurable, stretched over the
+// screen) and is staggered: velocities live on the cell faces, so the
+// pressure projection is exact. The ground is a wall at the bottom and the
+// sky one at the top; the sides wrap around, as if the window were one
+// stretch of a longer flow. Each step pulls the air toward the weather's
+// prevailing wind (slower near the ground), lifts air warmed at the ground
+// by the sun, advects velocity and temperature semi-Lagrangian style, and
+// projects the velocity back to divergence-free by solving for the
+// pressure with multigrid V-cycles (weighted Jacobi smoothing on a
+// hierarchy of halved grids). Every pass works on whole rows, four cells at
+// a time with SSE2 (scalar fallback elsewhere), split across worker
+// threads. Velocities are in the units of WeatherSystem::getWindVector, so
+// the field can stand in for it.
+class WindField {
+public:
+    // Both sizes are rounded up to a multiple of 8 (at least 16 x 8)
+    explicit WindField(int columns = 256, int rows = 128);
+
+    // Threads for stepping the grid (may be null: single-threaded)
+    void setWorkerPool(WorkerPool* workers) { this->workers = workers; }
+
+    // Change the grid size; the field restarts from the prevailing wind
+    void setResolution(int columns, int rows);
+    int getColumns() const { return columns; }
+    int getRows() const { return rows; }
+
+    void update(float deltaTime, const WeatherSystem& weather, int screenWidth, int screenHeight);
+
+    // Bilinear sample at a screen position (wrapped across the sides,
+    // clamped at the top and bottom)
+    glm::vec2 sample(glm::vec2 screenPosition) const;
+
+    // Wall time of the last step
+    float getStepMilliseconds() const { return stepMs; }
+    // Largest speed in the field after the last step
+    float getMaxSpeed() const { return maxSpeed; }
+
+private:
+    // One grid of the multigrid hierarchy (level 0 is the full grid)
+    struct Level {
+        int columns;
+        int rows;
+        float spacing2;            // Squared cell size, in full-grid cells
+        std::vector<float> value;  // Pressure (level 0) or its correction
+        std::vector<float> next;   // Jacobi target
+        std::vector<float> rhs;    // Divergence (level 0) or restricted residual
+    };
+
+    int columns;
+    int rows;
+    WorkerPool* workers;
+    float stepMs;
+    float maxSpeed;
+    bool started;  // False until the first step fills in the prevailing wind
+
+    float screenWidth;
+    float screenHeight;
+    float heatPhase;       // Slow drift of the warm patches along the ground
+    glm::vec2 prevailing;  // Weather's wind at the last step
+
+    // Staggered grid, row 0 at the top: u on each cell's left face
+    // (columns x rows, wrapping around), v on its top face (columns x
+    // (rows + 1), the last row being the ground), temperature excess at
+    // the centres
+    std::vector<float> u, v, heat;
+    std::vector<float> u0, v0, heat0;        // Advection targets
+    std::vector<float> rowWind;              // Share of the prevailing wind per row (ground profile)
+    std::vector<float> rowHeating;           // Share of the ground heating per row
+    std::vector<float> columnHeating;        // Ground heating per column (degrees per second)
+    std::vector<float> rowMaxSpeed;          // Largest speed per row after the projection
+    std::vector<Level> levels;
+
+    // Parameters of the pass being run (set before each parallel pass so
+    // the jobs capture only `this`)
+    float stepTime;
+    float cellStepX, cellStepY;  // Cells travelled per unit of wind in a step
+    int activeLevel;
+    void (WindField::*activePass)(int, int);
+
+    // Run a pass over `count` rows, on the workers when there are enough
+    void runRows(int count, void (WindField::*pass)(int, int));
+
+    // Step passes over rows [begin, end)
+    void forceRows(int begin, int end);
+    void advectRows(int begin, int end);
+    void divergenceRows(int begin, int end);
+    void projectRows(int begin, int end);
+    void speedRows(int begin, int end);
+
+    // Multigrid passes over rows [begin, end) of levels[activeLevel]:
+    // Jacobi sweep and residual (both into `next`), residual of the level
+    // above averaged down into this one, and this level's correction
+    // interpolated up into the level above
+    void smoothRows(int begin, int end);
+    void residualRows(int begin, int end);
+    void restrictRows(int begin, int end);
+    void prolongRows(int begin, int end);
+
+    void smooth(int level, int iterations);
+    void vCycle(int level);
+};
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Small fixed pool of worker threads for data-parallel loops.
+//
+// parallelFor() splits an index range into one chunk per thread (the calling
+// thread takes a chunk too) and returns when all chunks are done. The
+// threads are created once and sleep between jobs. Shared by the systems
+// that run grid kernels (noise, solvers) so they do not each spawn threads.
+// One job runs at a time: a parallelFor issued while another is running
+// (nested in it, or from a second thread) runs inline on its caller.
+class WorkerPool {
+public:
+    // threadCount = 0 picks hardware_concurrency - 1 helpers
+    explicit WorkerPool(unsigned threadCount = 0);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    // Run fn(begin, end) over [0, count) in parallel. Ranges below
+    // minChunk per thread run inline on the caller.
+    void parallelFor(size_t count, const std::function<void(size_t, size_t)>& fn, size_t minChunk = 1);
+
+    // Threads taking part in parallelFor, including the caller
+    unsigned getThreadCount() const { return static_cast<unsigned>(threads.size()) + 1; }
+
+private:
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+
+    // Current job, valid while pending > 0
+    const std::function<void(size_t, size_t)>* job;
+    size_t jobCount;
+    size_t chunkSize;
+    size_t nextChunk;
+    size_t pending;
+    unsigned long long generation;  // Bumped per job so sleepers can tell a new one
+    bool stopping;
+
+    void workerLoop();
+
+    // Claim and run chunks until none are left; returns with the lock held
+    void runChunks(std::unique_lock<std::mutex>& lock);
+};
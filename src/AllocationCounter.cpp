@@ -0,0 +1,106 @@
+#include "AllocationCounter.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+#ifndef NDEBUG
+namespace {
+    std::atomic<size_t> allocationCount(0);
+}
+
+// Replace the global allocation functions so every operator new is counted.
+// The array and sized/nothrow forms all route through these two, and the
+// over-aligned forms through the aligned pair further down.
+void* operator new(std::size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (size == 0) size = 1;
+    if (void* ptr = std::malloc(size)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void operator delete[](void* ptr) noexcept {
+    operator delete(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+    operator delete(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept {
+    operator delete(ptr);
+}
+
+// Over-aligned types (alignas above the default). malloc's block is padded
+// so an aligned address fits inside it, and the block's own address is
+// kept just before the one handed out, for delete.
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    std::size_t align = std::max(static_cast<std::size_t>(alignment), sizeof(void*));
+    void* block = std::malloc(size + align + sizeof(void*));
+    if (!block) throw std::bad_alloc();
+    std::uintptr_t start = reinterpret_cast<std::uintptr_t>(block) + sizeof(void*);
+    std::uintptr_t aligned = (start + align - 1) & ~static_cast<std::uintptr_t>(align - 1);
+    reinterpret_cast<void**>(aligned)[-1] = block;
+    return reinterpret_cast<void*>(aligned);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept {
+    if (ptr) std::free(static_cast<void**>(ptr)[-1]);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+    return operator new(size, alignment);
+}
+
+void operator delete[](void* ptr, std::align_val_t alignment) noexcept {
+    operator delete(ptr, alignment);
+}
+
+void operator delete(void* ptr, std::size_t, std::align_val_t alignment) noexcept {
+    operator delete(ptr, alignment);
+}
+
+void operator delete[](void* ptr, std::size_t, std::align_val_t alignment) noexcept {
+    operator delete(ptr, alignment);
+}
+#endif
+
+size_t AllocationCounter::frameStart = 0;
+size_t AllocationCounter::lastFrame = 0;
+
+size_t AllocationCounter::getTotal() {
+#ifndef NDEBUG
+    return allocationCount.load(std::memory_order_relaxed);
+#else
+    return 0;
+#endif
+}
+
+void AllocationCounter::beginFrame() {
+    frameStart = getTotal();
+}
+
+size_t AllocationCounter::endFrame() {
+    lastFrame = getTotal() - frameStart;
+    return lastFrame;
+}
+
+bool AllocationCounter::isEnabled() {
+#ifndef NDEBUG
+    return true;
+#else
+    return false;
+#endif
+}
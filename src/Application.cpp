@@ -1,11 +1,26 @@
 #include "Application.h"
+#include "AllocationCounter.h"
+#include <chrono>
 #include <iostream>
 
 Application::Application(int width, int height, const std::string& title)
     : window(nullptr), width(width), height(height), title(title),
-      lastFrame(0.0f), deltaTime(0.0f), weatherSystem(), 
-      particleSystem(1000), cloudSystem(15), lightningSystem(5),
-      celestialSystem(100), fogSystem(), renderer() {
+      lastFrame(0.0f), deltaTime(0.0f), workers(), weatherSystem(), windField(), moistureGrid(),
+      columnTemperature(), atmosphereSky(), particleSystem(250000), cloudSystem(15), cloudShadows(), lightningSystem(5),
+      celestialSystem(100), fogSystem(), lightShafts(), lightBuffer(), groundSystem(), rainLayerSystem(), renderer(),
+      trailsEnabled(false), particleUpdateMs(0.0f), precipitationCpuMs(0.0f) {
+    particleSystem.setGround(&groundSystem);
+    groundSystem.setShadowMap(&cloudShadows);
+    cloudSystem.setWorkerPool(&workers);
+    fogSystem.setWorkerPool(&workers);
+    windField.setWorkerPool(&workers);
+    weatherSystem.setWindField(&windField);
+    moistureGrid.setWorkerPool(&workers);
+    cloudSystem.setMoisture(&moistureGrid);
+    particleSystem.setMoisture(&moistureGrid);
+    columnTemperature.setWorkerPool(&workers);
+    columnTemperature.setMoisture(&moistureGrid);
+    weatherSystem.setColumnTemperature(&columnTemperature);
 }
 
 Application::~Application() {
@@ -91,6 +106,18 @@ void Application::run() {
     // Initialize renderer
     renderer.init();
     renderer.setProjection(width, height);
+    cloudSystem.init();
+    celestialSystem.init();
+    atmosphereSky.init();
+    fogSystem.init();
+    lightShafts.init();
+    lightBuffer.init();
+    if (celestialSystem.loadCatalog("stars.bin")) {
+        std::cout << "Star catalog mapped: " << celestialSystem.getCatalogStarCount() << " stars" << std::endl;
+    }
+    rainLayerSystem.init();
+    precipitationTrails.init();
+    precipitationGpuTimer.init();
 
     // Enable blending for transparency
     glEnable(GL_BLEND);
@@ -111,6 +138,9 @@ void Application::run() {
         // Process input
         processInput();
 
+        // Count heap allocations made by the simulation this frame
+        AllocationCounter::beginFrame();
+
         // Update simulation
         update(deltaTime);
 
@@ -133,11 +163,42 @@ void Application::update(float deltaTime) {
     // Update weather system
     weatherSystem.update(deltaTime);
     
+    // Temperature profiles over the columns (sets the temperature at the
+    // ground the other systems read)
+    columnTemperature.update(deltaTime, weatherSystem, width);
+    
+    // Local wind around the prevailing one (sampled by clouds, particles and fog)
+    windField.update(deltaTime, weatherSystem, width, height);
+    
+    // Vapour, cloud water and rain (clouds condense from it, precipitation
+    // falls at its rain rate)
+    moistureGrid.update(deltaTime, weatherSystem, width);
+    
+    // Update ground (before particles, which collide with it)
+    groundSystem.update(deltaTime, weatherSystem, width, height);
+    
+    // Update cloud system (before particles, which spawn beneath the clouds)
+    cloudSystem.update(deltaTime, weatherSystem, width, height);
+    particleSystem.setSpawnCoverage(cloudSystem.getCoverage(), cloudSystem.getCoverageColumnWidth());
+    
+    // Project the clouds toward the sun (or moon) onto the ground
+    cloudShadows.update(cloudSystem.getShadowOccluders(), celestialSystem.getLightPosition(weatherSystem, width, height),
+                        celestialSystem.getShadowStrength(weatherSystem), width, groundSystem.getBaseY());
+    celestialSystem.setSunTransmittance(cloudShadows.getSourceTransmittance());
+    
     // Update particle system
+    auto particleStart = std::chrono::steady_clock::now();
     particleSystem.update(deltaTime, weatherSystem, width, height);
+    particleUpdateMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - particleStart).count();
     
-    // Update cloud system
-    cloudSystem.update(deltaTime, weatherSystem, width, height);
+    // Settle this tick's impacts into the ground cover. Each hit stands for
+    // 1/density of a normal particle, so accumulation does not depend on it.
+    float hitWeight = 1.0f / particleSystem.getDensity();
+    groundSystem.addImpacts(particleSystem.getSnowImpactX(), GroundCover::SNOW, hitWeight);
+    groundSystem.addImpacts(particleSystem.getRainImpactX(), GroundCover::WATER, hitWeight);
+    
+    // Update far-field rain layers (follow the rain emitters)
+    rainLayerSystem.update(deltaTime, weatherSystem, particleSystem);
     
     // Update lightning system
     lightningSystem.update(deltaTime);
@@ -155,11 +216,15 @@ void Application::update(float deltaTime) {
         }
     }
     
+    // Sky scattering tables follow the humidity; finished slices upload here
+    atmosphereSky.setConditions(atmosphereSky.getTurbidity(), weatherSystem.getHumidity());
+    atmosphereSky.update();
+    
     // Update celestial system (sun/moon/stars)
-    celestialSystem.update(deltaTime, weatherSystem);
+    celestialSystem.update(deltaTime, weatherSystem, cloudSystem.getCloudCover());
     
     // Update fog system
-    fogSystem.update(deltaTime, weatherSystem);
+    fogSystem.update(deltaTime, weatherSystem, width, height);
     
     // Log state changes
     static WeatherState lastState = weatherSystem.getState();
@@ -182,29 +247,82 @@ void Application::render() {
     // Clear screen with weather-appropriate color
     glClearColor(skyColor.r, skyColor.g, skyColor.b, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT);
+    
+    // Scattered sky over the flat colour, once its tables are baked
+    atmosphereSky.render(weatherSystem, width, height, flash);
 
     // Begin rendering
     renderer.begin();
     
+    // Light sources (bolts, sun and moon glow) into the low-resolution light
+    // buffer that clouds, precipitation, fog and the ground add to their color
+    if (lightBuffer.beginEmission(width, height)) {
+        lightningSystem.renderLight(renderer);
+        renderer.flush();
+        lightBuffer.resolve(weatherSystem, celestialSystem.getSunPosition(weatherSystem, width, height),
+                            celestialSystem.getMoonPosition(weatherSystem, width, height));
+    }
+    
     // Render in order: back to front
     
     // 1. Celestial bodies (sun/moon/stars) - furthest back
     celestialSystem.render(renderer, weatherSystem, width, height);
     
     // 2. Clouds
+    renderer.setLighting(1.0f);
     cloudSystem.render(renderer, weatherSystem);
     
+    // Sun shafts through the gaps: the clouds again, into a low-resolution
+    // occlusion mask, then blurred toward the sun and added on top
+    renderer.flush();
+    if (lightShafts.beginOcclusion(weatherSystem, cloudSystem.getCloudCover(),
+                                   celestialSystem.getSunPosition(weatherSystem, width, height), width, height)) {
+        cloudSystem.render(renderer, weatherSystem);
+        renderer.flush();
+        lightShafts.endOcclusion();
+        lightShafts.composite();
+    }
+    
     // 3. Lightning bolts
+    renderer.setLighting(0.0f);
     lightningSystem.render(renderer);
     
-    // 4. Particles (rain/snow)
-    particleSystem.render(renderer);
+    // 4. Distant rain layers (behind the ground and the near particles)
+    rainLayerSystem.render(renderer, weatherSystem, width, height);
+    
+    // 5. Ground (matte: takes half the light)
+    renderer.setLighting(0.5f);
+    groundSystem.render(renderer, weatherSystem);
+    renderer.setLighting(1.0f);
+    
+    // 6. Particles (rain/snow/splashes), timed on both CPU and GPU. With
+    //    trails on they go through the history buffer instead of the screen.
+    renderer.flush();
+    auto particleStart = std::chrono::steady_clock::now();
+    precipitationGpuTimer.begin();
+    if (trailsEnabled) {
+        precipitationTrails.beginCapture(deltaTime, width, height);
+        particleSystem.render(renderer);
+        renderer.flush();
+        precipitationTrails.endCapture();
+        precipitationTrails.composite();
+    } else {
+        particleSystem.render(renderer);
+        renderer.flush();
+    }
+    precipitationGpuTimer.end();
+    float renderMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - particleStart).count();
+    precipitationCpuMs += (particleUpdateMs + renderMs - precipitationCpuMs) * 0.1f;
     
-    // 5. Fog (foreground atmosphere)
-    fogSystem.render(renderer, width, height);
+    // 7. Fog (foreground atmosphere)
+    fogSystem.render(renderer);
     
     // End rendering (draws everything)
     renderer.end();
+    renderer.setLighting(0.0f);
+
+    // UI allocations are not part of the simulation budget
+    AllocationCounter::endFrame();
 
     // Render UI on top
     renderUI();
@@ -261,6 +379,9 @@ void Application::renderUI() {
     if (ImGui::SliderFloat("Temperature (°C)", &temp, -20.0f, 40.0f)) {
         weatherSystem.setTemperature(temp);
     }
+    ImGui::Text("Surface: %.1f °C (%.1f to %.1f, %.2f ms)", columnTemperature.getSurfaceTemperature(),
+                columnTemperature.getSurfaceMinimum(), columnTemperature.getSurfaceMaximum(),
+                columnTemperature.getStepMilliseconds());
     
     // Pressure slider (980 hPa to 1050 hPa)
     float pressure = weatherSystem.getPressure();
@@ -286,6 +407,35 @@ void Application::renderUI() {
         weatherSystem.setTimeOfDay(timeOfDay);
     }
     
+    // Aerosol haze for the scattered sky (re-bakes in the background)
+    float turbidity = atmosphereSky.getTurbidity();
+    if (ImGui::SliderFloat("Turbidity", &turbidity, 1.0f, 10.0f, "%.1f")) {
+        atmosphereSky.setConditions(turbidity, weatherSystem.getHumidity());
+    }
+    if (atmosphereSky.getBakeProgress() < 1.0f) {
+        ImGui::SameLine();
+        ImGui::Text("(baking %.0f%%)", atmosphereSky.getBakeProgress() * 100.0f);
+    }
+    
+    // Observing date and site for the sun and moon
+    const Ephemeris& ephemeris = weatherSystem.getEphemeris();
+    int date[3];
+    ephemeris.getDate(date[0], date[1], date[2]);
+    if (ImGui::InputInt3("Date (Y/M/D)", date, ImGuiInputTextFlags_EnterReturnsTrue)) {
+        weatherSystem.setDate(date[0], std::min(std::max(date[1], 1), 12), std::min(std::max(date[2], 1), 31));
+    }
+    float latitude = ephemeris.getLatitude();
+    float longitude = ephemeris.getLongitude();
+    float utcOffset = ephemeris.getUtcOffset();
+    bool siteChanged = ImGui::SliderFloat("Latitude", &latitude, -89.0f, 89.0f, "%.1f");
+    siteChanged |= ImGui::SliderFloat("Longitude", &longitude, -180.0f, 180.0f, "%.1f");
+    siteChanged |= ImGui::SliderFloat("UTC Offset (h)", &utcOffset, -12.0f, 14.0f, "%.1f");
+    if (siteChanged) {
+        weatherSystem.setSite(latitude, longitude, utcOffset);
+    }
+    ImGui::Text("Sunrise %.2f h  Sunset %.2f h  Moon %.0f%% lit", ephemeris.getSunrise() * 24.0f,
+                ephemeris.getSunset() * 24.0f, weatherSystem.getSky().moonIllumination * 100.0f);
+    
     ImGui::Separator();
     
     // ===== SYSTEM INFO =====
@@ -293,7 +443,28 @@ void Application::renderUI() {
     
     // Wind display
     glm::vec2 wind = weatherSystem.getWindVector();
-    ImGui::Text("Wind: (%.1f, %.1f) m/s", wind.x, wind.y);
+    ImGui::Text("Wind: (%.1f, %.1f) m/s  gusts to %.1f", wind.x, wind.y, windField.getMaxSpeed());
+    static const int kWindGrids[][2] = {{128, 64}, {256, 128}, {512, 256}};
+    static const char* kWindGridNames[] = {"128 x 64", "256 x 128", "512 x 256"};
+    int windGrid = 0;
+    while (windGrid < 2 && kWindGrids[windGrid][0] < windField.getColumns()) windGrid++;
+    if (ImGui::Combo("Wind Grid", &windGrid, kWindGridNames, 3)) {
+        windField.setResolution(kWindGrids[windGrid][0], kWindGrids[windGrid][1]);
+    }
+    ImGui::SameLine();
+    ImGui::Text("(%.2f ms)", windField.getStepMilliseconds());
+    
+    // Moisture grid: what it condenses and rains out, and its cost
+    ImGui::Text("Cloud Fraction: %.2f  Rain: %.1f mm/h", moistureGrid.getCloudFraction(), moistureGrid.getRainRate());
+    static const int kMoistureGrids[][2] = {{64, 16}, {128, 32}, {256, 64}, {512, 128}};
+    static const char* kMoistureGridNames[] = {"64 x 16", "128 x 32", "256 x 64", "512 x 128"};
+    int moistureGridSize = 0;
+    while (moistureGridSize < 3 && kMoistureGrids[moistureGridSize][0] < moistureGrid.getColumns()) moistureGridSize++;
+    if (ImGui::Combo("Moisture Grid", &moistureGridSize, kMoistureGridNames, 4)) {
+        moistureGrid.setResolution(kMoistureGrids[moistureGridSize][0], kMoistureGrids[moistureGridSize][1]);
+    }
+    ImGui::SameLine();
+    ImGui::Text("(%.2f ms)", moistureGrid.getStepMilliseconds());
     
     // Lightning intensity display
     float lightning = std::max(weatherSystem.getLightningFlash(), lightningSystem.getFlashIntensity());
@@ -302,6 +473,97 @@ void Application::renderUI() {
     // Fog density
     ImGui::Text("Fog Density: %.2f", fogSystem.getDensity());
     
+    // Particle backend
+    bool gpuParticles = particleSystem.getBackend() == ParticleBackend::GPU;
+    if (ImGui::Checkbox("GPU Particles", &gpuParticles)) {
+        particleSystem.setBackend(gpuParticles ? ParticleBackend::GPU : ParticleBackend::CPU);
+    }
+    float particleDensity = particleSystem.getDensity();
+    if (ImGui::SliderFloat("Particle Density", &particleDensity, 1.0f, 1000.0f, "%.0fx", ImGuiSliderFlags_Logarithmic)) {
+        particleSystem.setDensity(particleDensity);
+    }
+    ImGui::Text("Particles: %zu", particleSystem.getParticleCount());
+    bool coverageRate = particleSystem.isCoverageRateScaling();
+    if (ImGui::Checkbox("Scale Rate by Cloud Cover", &coverageRate)) {
+        particleSystem.setCoverageRateScaling(coverageRate);
+    }
+    ImGui::Text("Cloud Coverage Factor: %.2f", particleSystem.getCoverageScale());
+    if (ImGui::Checkbox("Motion Trails", &trailsEnabled) && trailsEnabled) {
+        precipitationTrails.clear();
+    }
+    if (trailsEnabled) {
+        float decay = precipitationTrails.getDecayTime();
+        if (ImGui::SliderFloat("Trail Decay", &decay, 0.02f, 0.5f, "%.2f s")) {
+            precipitationTrails.setDecayTime(decay);
+        }
+        float resolution = precipitationTrails.getResolutionScale();
+        if (ImGui::SliderFloat("Trail Resolution", &resolution, 0.25f, 1.0f, "%.2fx")) {
+            precipitationTrails.setResolutionScale(resolution);
+        }
+    }
+    // Compare trails at low density against brute-force particle counts
+    ImGui::Text("Precipitation CPU: %.2f ms  GPU: %.2f ms", precipitationCpuMs, precipitationGpuTimer.getMilliseconds());
+    bool precipitationField = particleSystem.isFieldEnabled();
+    if (ImGui::Checkbox("Precipitation Field", &precipitationField)) {
+        particleSystem.setFieldEnabled(precipitationField);
+    }
+    ImGui::SameLine();
+    ImGui::Text("(mass %.0f)", particleSystem.getField().getTotalMass());
+    bool rainLayers = rainLayerSystem.isEnabled();
+    if (ImGui::Checkbox("Far Rain Layers", &rainLayers)) {
+        rainLayerSystem.setEnabled(rainLayers);
+    }
+    ImGui::SameLine();
+    ImGui::Text("(strength %.2f)", rainLayerSystem.getStrength());
+    bool breakdownLightning = lightningSystem.isBreakdownEnabled();
+    if (ImGui::Checkbox("Breakdown Lightning", &breakdownLightning)) {
+        lightningSystem.setBreakdownEnabled(breakdownLightning);
+    }
+    if (breakdownLightning) {
+        ImGui::SameLine();
+        ImGui::Text("(%d channels, %.1f ms)", lightningSystem.getBreakdownTemplates(),
+                    lightningSystem.getBreakdownMilliseconds());
+    }
+    if (!celestialSystem.isCatalogLoaded()) {
+        int starCount = celestialSystem.getStarCount();
+        if (ImGui::SliderInt("Stars", &starCount, 100, 100000, "%d", ImGuiSliderFlags_Logarithmic)) {
+            celestialSystem.setStarCount(starCount);
+        }
+    }
+    ImGui::Text("Stars drawn: %d of %zu (limit mag %.1f)", celestialSystem.getDrawnStars(),
+                celestialSystem.getCatalogStarCount(), celestialSystem.getLimitingMagnitude());
+    bool localLight = lightBuffer.isEnabled();
+    if (ImGui::Checkbox("Local Lighting", &localLight)) {
+        lightBuffer.setEnabled(localLight);
+    }
+    bool shafts = lightShafts.isEnabled();
+    if (ImGui::Checkbox("Light Shafts", &shafts)) {
+        lightShafts.setEnabled(shafts);
+    }
+    ImGui::SameLine();
+    ImGui::Text("(intensity %.2f)", lightShafts.getIntensity());
+    bool noiseClouds = cloudSystem.getMode() == CloudMode::NOISE;
+    if (ImGui::Checkbox("Noise Clouds", &noiseClouds)) {
+        cloudSystem.setMode(noiseClouds ? CloudMode::NOISE : CloudMode::PUFFS);
+    }
+    if (noiseClouds) {
+        ImGui::SameLine();
+        ImGui::Text("(%.2f ms)", cloudSystem.getNoiseUpdateMs());
+    }
+    if (particleSystem.getBackend() == ParticleBackend::CPU) {
+        ImGui::Text("Rain %d  Snow %d  Sleet %d  Hail %d  Splash %d",
+                    particleSystem.getEmitter(ParticleType::RAIN).liveCount,
+                    particleSystem.getEmitter(ParticleType::SNOW).liveCount,
+                    particleSystem.getEmitter(ParticleType::SLEET).liveCount,
+                    particleSystem.getEmitter(ParticleType::HAIL).liveCount,
+                    particleSystem.getEmitter(ParticleType::SPLASH).liveCount);
+    }
+    
+    // Heap allocations during update/render (should stay at 0 in steady state)
+    if (AllocationCounter::isEnabled()) {
+        ImGui::Text("Heap Allocs/Frame: %zu", AllocationCounter::getLastFrame());
+    }
+    
     ImGui::Separator();
     
     // ===== QUICK PRESETS =====
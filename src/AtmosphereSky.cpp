@@ -0,0 +1,428 @@
+#include "AtmosphereSky.h"
+#include "CelestialSystem.h"
+#include "Renderer.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+// Sky-view table: relative azimuth x view elevation x sun elevation
+static const int kAzimuthSize = 32;
+static const int kViewSize = 32;
+static const int kSunSize = 32;
+static const int kSliceFloats = kAzimuthSize * kViewSize * 3;
+
+// Transmittance table: view cosine x altitude
+static const int kTransmittanceMuSize = 128;
+static const int kTransmittanceAltitudeSize = 32;
+
+// Sun elevations covered by the table, in degrees; below the lowest the
+// sky is left to the night colour
+static const float kSunLowest = -12.0f;
+static const float kSunRange = 102.0f;
+
+// Planet and atmosphere (lengths in km, coefficients per km)
+static const float kGroundRadius = 6360.0f;
+static const float kTopRadius = 6460.0f;
+static const float kObserverAltitude = 0.2f;
+static const glm::vec3 kRayleighScattering(5.802e-3f, 13.558e-3f, 33.1e-3f);
+static const float kRayleighScaleHeight = 8.0f;
+static const float kMieScattering = 3.996e-3f;
+static const float kMieExtinction = 4.40e-3f;
+static const float kMieScaleHeight = 1.2f;
+static const float kMieAsymmetry = 0.8f;
+static const glm::vec3 kOzoneAbsorption(0.650e-3f, 1.881e-3f, 0.085e-3f);
+
+static const int kTransmittanceSteps = 40;
+static const int kScatteringSteps = 32;
+
+// Display: scattered radiance is scaled by the sun's irradiance and then
+// tone mapped with 1 - exp(-exposure * L)
+static const float kSunIrradiance = 20.0f;
+static const float kExposure = 4.0f;
+
+// Input changes smaller than this do not start a new bake
+static const float kTurbidityStep = 0.05f;
+static const float kHumidityStep = 0.02f;
+
+static const float kPi = 3.14159265f;
+
+static const char* vertexSource = R"(
+#version 330 core
+void main() {
+    vec2 corner = vec2(float((gl_VertexID << 1) & 2), float(gl_VertexID & 2));
+    gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+}
+)";
+
+// Direction of this pixel on the dome, then a lookup in the sky-view table
+// (the coordinates invert the bake's texel spacing)
+static const char* fragmentSource = R"(
+#version 330 core
+out vec4 FragColor;
+
+uniform sampler3D skyView;
+uniform vec2 screenSize;
+uniform float horizonY;
+uniform float arcHeight;
+uniform float viewSpan;
+uniform float facing;
+uniform float sunElevation;
+uniform float sunAzimuth;
+uniform float exposure;
+uniform vec3 nightColor;
+uniform float dim;
+uniform float gray;
+uniform vec3 tint;
+uniform float tintMix;
+uniform float flash;
+
+void main() {
+    float y = screenSize.y - gl_FragCoord.y;
+    float height = clamp((horizonY * screenSize.y - y) / (arcHeight * screenSize.y), 0.0, 1.0);
+    float elevation = degrees(asin(height));
+    float azimuth = facing + (gl_FragCoord.x / screenSize.x - 0.5) * viewSpan;
+    float fromSun = abs(mod(azimuth - sunAzimuth + 540.0, 360.0) - 180.0);
+
+    vec3 coord = vec3(fromSun / 180.0, sqrt(elevation / 90.0), sqrt(clamp((sunElevation + 12.0) / 102.0, 0.0, 1.0)));
+    vec3 size = vec3(textureSize(skyView, 0));
+    coord = (coord * (size - 1.0) + 0.5) / size;
+    vec3 radiance = texture(skyView, coord).rgb;
+
+    vec3 color = max(vec3(1.0) - exp(-exposure * radiance), nightColor);
+    color *= dim;
+    color = mix(color, vec3((color.r + color.g + color.b) / 3.0), gray);
+    color = mix(color, tint, tintMix);
+    // Half a step of noise hides 8-bit banding in the dark twilight gradients
+    float dither = fract(sin(dot(gl_FragCoord.xy, vec2(12.9898, 78.233))) * 43758.5453) - 0.5;
+    FragColor = vec4(color + vec3(flash * 0.5 + dither / 255.0), 1.0);
+}
+)";
+
+// Distance from radius r along a ray with zenith cosine mu to the top of the
+// atmosphere
+static float distanceToTop(float r, float mu) {
+    float discriminant = r * r * (mu * mu - 1.0f) + kTopRadius * kTopRadius;
+    return std::max(-r * mu + std::sqrt(std::max(discriminant, 0.0f)), 0.0f);
+}
+
+static bool hitsGround(float r, float mu) {
+    return mu < 0.0f && r * r * (mu * mu - 1.0f) + kGroundRadius * kGroundRadius >= 0.0f;
+}
+
+static glm::vec3 extinctionAt(float altitude, float mieScale) {
+    float rayleigh = std::exp(-altitude / kRayleighScaleHeight);
+    float mie = std::exp(-altitude / kMieScaleHeight);
+    float ozone = std::max(0.0f, 1.0f - std::fabs(altitude - 25.0f) / 15.0f);
+    return kRayleighScattering * rayleigh + glm::vec3(kMieExtinction * mieScale * mie) + kOzoneAbsorption * ozone;
+}
+
+static void bakeTransmittance(float mieScale, std::vector<glm::vec3>& table) {
+    table.resize(kTransmittanceMuSize * kTransmittanceAltitudeSize);
+    for (int j = 0; j < kTransmittanceAltitudeSize; j++) {
+        float r = kGroundRadius + (kTopRadius - kGroundRadius) * j / (kTransmittanceAltitudeSize - 1);
+        for (int i = 0; i < kTransmittanceMuSize; i++) {
+            float mu = -1.0f + 2.0f * i / (kTransmittanceMuSize - 1);
+            glm::vec3 transmittance(0.0f);
+            if (!hitsGround(r, mu)) {
+                float length = distanceToTop(r, mu);
+                float dt = length / kTransmittanceSteps;
+                glm::vec3 depth(0.0f);
+                for (int k = 0; k < kTransmittanceSteps; k++) {
+                    float t = (k + 0.5f) * dt;
+                    float radius = std::sqrt(r * r + t * t + 2.0f * r * mu * t);
+                    depth += extinctionAt(radius - kGroundRadius, mieScale) * dt;
+                }
+                transmittance = glm::exp(-depth);
+            }
+            table[j * kTransmittanceMuSize + i] = transmittance;
+        }
+    }
+}
+
+static glm::vec3 lookupTransmittance(const std::vector<glm::vec3>& table, float r, float mu) {
+    float x = (std::min(std::max(mu, -1.0f), 1.0f) + 1.0f) * 0.5f * (kTransmittanceMuSize - 1);
+    float y = std::min(std::max((r - kGroundRadius) / (kTopRadius - kGroundRadius), 0.0f), 1.0f) *
+              (kTransmittanceAltitudeSize - 1);
+    int x0 = std::min(static_cast<int>(x), kTransmittanceMuSize - 2);
+    int y0 = std::min(static_cast<int>(y), kTransmittanceAltitudeSize - 2);
+    float fx = x - x0;
+    float fy = y - y0;
+    const glm::vec3* row0 = &table[y0 * kTransmittanceMuSize + x0];
+    const glm::vec3* row1 = row0 + kTransmittanceMuSize;
+    return glm::mix(glm::mix(row0[0], row0[1], fx), glm::mix(row1[0], row1[1], fx), fy);
+}
+
+// One sun elevation slice of the sky-view table: radiance scattered towards
+// the observer for every view elevation and azimuth from the sun
+static void bakeSkySlice(int sunSlice, float mieScale, const std::vector<glm::vec3>& transmittance, float* out) {
+    float sunU = static_cast<float>(sunSlice) / (kSunSize - 1);
+    float sunElevation = (kSunLowest + kSunRange * sunU * sunU) * kPi / 180.0f;
+    glm::vec3 sun(std::cos(sunElevation), 0.0f, std::sin(sunElevation));
+    float r0 = kGroundRadius + kObserverAltitude;
+    float g2 = kMieAsymmetry * kMieAsymmetry;
+
+    for (int v = 0; v < kViewSize; v++) {
+        float viewU = static_cast<float>(v) / (kViewSize - 1);
+        float viewElevation = 90.0f * viewU * viewU * kPi / 180.0f;
+        float mu = std::sin(viewElevation);
+        float length = distanceToTop(r0, mu);
+
+        for (int a = 0; a < kAzimuthSize; a++) {
+            float azimuth = kPi * a / (kAzimuthSize - 1);
+            glm::vec3 view(std::cos(viewElevation) * std::cos(azimuth), std::cos(viewElevation) * std::sin(azimuth), mu);
+            float cosTheta = glm::dot(view, sun);
+            float rayleighPhase = 3.0f / (16.0f * kPi) * (1.0f + cosTheta * cosTheta);
+            float miePhase = (1.0f - g2) / (4.0f * kPi * std::pow(1.0f + g2 - 2.0f * kMieAsymmetry * cosTheta, 1.5f));
+
+            // Samples bunched towards the observer, where the air is dense
+            glm::vec3 radiance(0.0f);
+            glm::vec3 depth(0.0f);
+            for (int k = 0; k < kScatteringSteps; k++) {
+                float x0 = static_cast<float>(k) / kScatteringSteps;
+                float x1 = static_cast<float>(k + 1) / kScatteringSteps;
+                float t = length * 0.25f * (x0 + x1) * (x0 + x1);
+                float dt = length * (x1 * x1 - x0 * x0);
+
+                glm::vec3 position = glm::vec3(0.0f, 0.0f, r0) + view * t;
+                float radius = glm::length(position);
+                float altitude = radius - kGroundRadius;
+                glm::vec3 extinction = extinctionAt(altitude, mieScale);
+                glm::vec3 toObserver = glm::exp(-(depth + extinction * (0.5f * dt)));
+                depth += extinction * dt;
+
+                glm::vec3 toSun = lookupTransmittance(transmittance, radius, glm::dot(position, sun) / radius);
+                glm::vec3 scattering = kRayleighScattering * (std::exp(-altitude / kRayleighScaleHeight) * rayleighPhase) +
+                                       glm::vec3(kMieScattering * mieScale * std::exp(-altitude / kMieScaleHeight) * miePhase);
+                radiance += toObserver * toSun * scattering * dt;
+            }
+
+            float* texel = out + (v * kAzimuthSize + a) * 3;
+            texel[0] = radiance.r * kSunIrradiance;
+            texel[1] = radiance.g * kSunIrradiance;
+            texel[2] = radiance.b * kSunIrradiance;
+        }
+    }
+}
+
+AtmosphereSky::AtmosphereSky()
+    : turbidity(2.0f), humidity(0.5f), staging(static_cast<size_t>(kSunSize) * kSliceFloats, 0.0f), slicesReady(0),
+      stagingGeneration(0), requestedGeneration(0), requestedTurbidity(2.0f), requestedHumidity(0.5f),
+      stopBaking(false), bakeMilliseconds(0.0f), uploadGeneration(0), uploadedSlices(0), frontReady(false),
+      front(0), program(0), vao(0), uScreenSize(-1), uHorizonY(-1), uArcHeight(-1), uViewSpan(-1), uFacing(-1),
+      uSunElevation(-1), uSunAzimuth(-1), uExposure(-1), uNightColor(-1), uDim(-1), uGray(-1), uTint(-1),
+      uTintMix(-1), uFlash(-1), uSkyView(-1) {
+    skyTextures[0] = skyTextures[1] = 0;
+}
+
+AtmosphereSky::~AtmosphereSky() {
+    {
+        std::lock_guard<std::mutex> lock(bakeMutex);
+        stopBaking = true;
+    }
+    bakeWake.notify_all();
+    if (bakeWorker.joinable()) {
+        bakeWorker.join();
+    }
+    shutdown();
+}
+
+bool AtmosphereSky::init() {
+    program = Renderer::createShaderProgram(vertexSource, fragmentSource);
+    if (!program) return false;
+    uScreenSize = glGetUniformLocation(program, "screenSize");
+    uHorizonY = glGetUniformLocation(program, "horizonY");
+    uArcHeight = glGetUniformLocation(program, "arcHeight");
+    uViewSpan = glGetUniformLocation(program, "viewSpan");
+    uFacing = glGetUniformLocation(program, "facing");
+    uSunElevation = glGetUniformLocation(program, "sunElevation");
+    uSunAzimuth = glGetUniformLocation(program, "sunAzimuth");
+    uExposure = glGetUniformLocation(program, "exposure");
+    uNightColor = glGetUniformLocation(program, "nightColor");
+    uDim = glGetUniformLocation(program, "dim");
+    uGray = glGetUniformLocation(program, "gray");
+    uTint = glGetUniformLocation(program, "tint");
+    uTintMix = glGetUniformLocation(program, "tintMix");
+    uFlash = glGetUniformLocation(program, "flash");
+    uSkyView = glGetUniformLocation(program, "skyView");
+
+    glGenTextures(2, skyTextures);
+    for (GLuint texture : skyTextures) {
+        glBindTexture(GL_TEXTURE_3D, texture);
+        glTexImage3D(GL_TEXTURE_3D, 0, GL_RGB16F, kAzimuthSize, kViewSize, kSunSize, 0, GL_RGB, GL_FLOAT, nullptr);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    }
+    glBindTexture(GL_TEXTURE_3D, 0);
+    glGenVertexArrays(1, &vao);
+
+    {
+        std::lock_guard<std::mutex> lock(bakeMutex);
+        requestedTurbidity = turbidity;
+        requestedHumidity = humidity;
+        requestedGeneration++;
+    }
+    if (!bakeWorker.joinable()) {
+        bakeWorker = std::thread(&AtmosphereSky::bakeLoop, this);
+    } else {
+        bakeWake.notify_all();
+    }
+    return true;
+}
+
+void AtmosphereSky::shutdown() {
+    if (vao) glDeleteVertexArrays(1, &vao);
+    if (skyTextures[0]) glDeleteTextures(2, skyTextures);
+    if (program) glDeleteProgram(program);
+    vao = 0;
+    skyTextures[0] = skyTextures[1] = 0;
+    program = 0;
+    frontReady = false;
+}
+
+void AtmosphereSky::setConditions(float newTurbidity, float newHumidity) {
+    if (std::fabs(newTurbidity - turbidity) < kTurbidityStep && std::fabs(newHumidity - humidity) < kHumidityStep) {
+        return;
+    }
+    turbidity = newTurbidity;
+    humidity = newHumidity;
+    {
+        std::lock_guard<std::mutex> lock(bakeMutex);
+        requestedTurbidity = turbidity;
+        requestedHumidity = humidity;
+        requestedGeneration++;
+    }
+    bakeWake.notify_all();
+}
+
+void AtmosphereSky::update() {
+    if (!program) return;
+
+    // Never wait on the worker: if it is publishing a slice right now, the
+    // upload just happens next frame
+    std::unique_lock<std::mutex> lock(bakeMutex, std::try_to_lock);
+    if (!lock.owns_lock()) return;
+    if (stagingGeneration != uploadGeneration) {
+        uploadGeneration = stagingGeneration;
+        uploadedSlices = 0;
+    }
+    if (uploadedSlices >= slicesReady) return;
+
+    glBindTexture(GL_TEXTURE_3D, skyTextures[1 - front]);
+    glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, uploadedSlices, kAzimuthSize, kViewSize, slicesReady - uploadedSlices,
+                    GL_RGB, GL_FLOAT, &staging[static_cast<size_t>(uploadedSlices) * kSliceFloats]);
+    glBindTexture(GL_TEXTURE_3D, 0);
+    uploadedSlices = slicesReady;
+    lock.unlock();
+
+    if (uploadedSlices == kSunSize) {
+        // The back table is complete: draw from it from now on
+        front = 1 - front;
+        frontReady = true;
+    }
+}
+
+void AtmosphereSky::render(const WeatherSystem& weather, int screenWidth, int screenHeight, float flash) {
+    if (!frontReady) return;
+
+    // The same weather adjustments getSkyColor applies to its flat colour
+    float dim = 1.0f;
+    float gray = 0.0f;
+    float tintMix = 0.0f;
+    switch (weather.getState()) {
+        case WeatherState::CLEAR:
+            break;
+        case WeatherState::CLOUDY:
+            dim = 0.8f;
+            break;
+        case WeatherState::RAINING:
+            dim = 0.5f;
+            gray = 1.0f;
+            break;
+        case WeatherState::THUNDERSTORM:
+            dim = 0.3f;
+            gray = 1.0f;
+            break;
+        case WeatherState::SNOWING:
+            tintMix = 0.4f;
+            break;
+    }
+
+    const EphemerisSample& sky = weather.getSky();
+    float facing = weather.getEphemeris().getLatitude() >= 0.0f ? 180.0f : 0.0f;
+
+    glUseProgram(program);
+    glUniform2f(uScreenSize, static_cast<float>(screenWidth), static_cast<float>(screenHeight));
+    glUniform1f(uHorizonY, kSkyHorizonY);
+    glUniform1f(uArcHeight, kSkyArcHeight);
+    glUniform1f(uViewSpan, kSkyViewSpan);
+    glUniform1f(uFacing, facing);
+    glUniform1f(uSunElevation, sky.sunAltitude);
+    glUniform1f(uSunAzimuth, sky.sunAzimuth);
+    glUniform1f(uExposure, kExposure);
+    glUniform3f(uNightColor, 0.05f, 0.05f, 0.15f);
+    glUniform1f(uDim, dim);
+    glUniform1f(uGray, gray);
+    glUniform3f(uTint, 0.8f, 0.8f, 0.85f);
+    glUniform1f(uTintMix, tintMix);
+    glUniform1f(uFlash, flash);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_3D, skyTextures[front]);
+    glUniform1i(uSkyView, 0);
+
+    // Opaque: the sky replaces the clear colour
+    glDisable(GL_BLEND);
+    glBindVertexArray(vao);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+    glEnable(GL_BLEND);
+    glBindTexture(GL_TEXTURE_3D, 0);
+}
+
+float AtmosphereSky::getBakeProgress() const {
+    return std::min(static_cast<float>(uploadedSlices) / kSunSize, 1.0f);
+}
+
+void AtmosphereSky::bakeLoop() {
+    std::vector<glm::vec3> transmittance;
+    std::vector<float> slice(kSliceFloats);
+    unsigned int bakedGeneration = 0;
+
+    std::unique_lock<std::mutex> lock(bakeMutex);
+    while (true) {
+        bakeWake.wait(lock, [&] { return stopBaking || requestedGeneration != bakedGeneration; });
+        if (stopBaking) return;
+
+        unsigned int generation = requestedGeneration;
+        float mieScale = 0.5f * requestedTurbidity * (1.0f + 2.0f * requestedHumidity * requestedHumidity);
+        stagingGeneration = generation;
+        slicesReady = 0;
+        lock.unlock();
+
+        auto start = std::chrono::steady_clock::now();
+        bakeTransmittance(mieScale, transmittance);
+        bool restarted = false;
+        for (int s = 0; s < kSunSize && !restarted; s++) {
+            bakeSkySlice(s, mieScale, transmittance, slice.data());
+
+            lock.lock();
+            if (stopBaking || requestedGeneration != generation) {
+                restarted = true;
+            } else {
+                std::memcpy(&staging[static_cast<size_t>(s) * kSliceFloats], slice.data(), kSliceFloats * sizeof(float));
+                slicesReady = s + 1;
+            }
+            lock.unlock();
+        }
+        if (!restarted) {
+            std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            bakeMilliseconds.store(elapsed.count(), std::memory_order_relaxed);
+        }
+
+        lock.lock();
+        if (!restarted) bakedGeneration = generation;
+    }
+}
@@ -1,86 +1,221 @@
 #include "CelestialSystem.h"
+#include <algorithm>
+#include <cstddef>
 #include <cstdlib>
 #include <cmath>
 
+// The twinkle clock wraps after this many seconds. Star speeds are arbitrary,
+// so every star jumps phase at the wrap, but only about once every 27 minutes.
+static const float kTwinklePeriod = 2.0f * 3.14159265f * 256.0f;
+
+// Faintest magnitude visible in a clear night sky, and how fast the limit
+// drops as the sky brightens (magnitudes per tenfold sky luminance). A
+// daytime sky is about ten times the night sky, which hides every star.
+static const float kDarkSkyLimit = 6.5f;
+static const float kMagnitudesPerDecade = 12.0f;
+static const glm::vec3 kNightSkyColor(0.05f, 0.05f, 0.15f);
+
+// Cumulative star counts grow by roughly this factor per magnitude (in
+// log10); used to give the generated field a realistic magnitude spread
+static const float kCountSlope = 0.48f;
+
+// Sun altitude at rise and set (refraction plus semidiameter), in degrees
+static const float kHorizonAltitude = -0.833f;
+
+static const char* starVertexSource = R"(
+#version 330 core
+layout (location = 0) in vec2 aPos;
+layout (location = 1) in float aMagnitude;
+layout (location = 2) in float aColorIndex;
+
+out float alpha;
+flat out vec3 starColor;
+flat out float coreRadius;
+flat out float glowRadius;
+flat out float pointRadius;
+
+uniform mat4 projection;
+uniform vec2 skyScale;
+uniform float time;
+uniform float visibility;
+uniform float limitingMagnitude;
+
+// B-V colour index to tint: blue-white through white to orange
+vec3 colorFromIndex(float index) {
+    float t = clamp(index, -0.4, 2.0);
+    if (t < 0.4) return mix(vec3(0.75, 0.85, 1.0), vec3(1.0), (t + 0.4) / 0.8);
+    return mix(vec3(1.0), vec3(1.0, 0.7, 0.45), (t - 0.4) / 1.6);
+}
+
+void main() {
+    // Per-star twinkle phase and speed from a hash of the star index
+    uint h = uint(gl_VertexID) * 2654435761u;
+    h ^= h >> 15;
+    h *= 2246822519u;
+    h ^= h >> 13;
+    float phase = float(h & 0xFFFFu) / 65535.0 * 6.2831853;
+    float speed = 1.0 + 2.0 * float(h >> 16) / 65535.0;
+    float twinkle = 0.5 + 0.5 * sin(phase + time * speed);
+
+    // Stars at the limit are faint and small; brighter ones grow and glow
+    float margin = limitingMagnitude - aMagnitude;
+    alpha = clamp(0.4 + 0.3 * margin, 0.0, 1.0) * twinkle * visibility;
+    starColor = colorFromIndex(aColorIndex);
+    coreRadius = clamp(1.0 + 0.4 * margin, 1.0, 2.5);
+    glowRadius = margin > 2.0 ? coreRadius * 2.0 : 0.0;
+    // Half a pixel of margin for the antialiased edge
+    pointRadius = max(coreRadius, glowRadius) + 0.5;
+    gl_PointSize = pointRadius * 2.0;
+    gl_Position = projection * vec4(aPos * skyScale, 0.0, 1.0);
+}
+)";
+
+// Disc plus optional halo, composited the way the halo used to be blended
+// over the disc
+static const char* starFragmentSource = R"(
+#version 330 core
+in float alpha;
+flat in vec3 starColor;
+flat in float coreRadius;
+flat in float glowRadius;
+flat in float pointRadius;
+out vec4 FragColor;
+
+void main() {
+    float distance = length(gl_PointCoord - 0.5) * 2.0 * pointRadius;
+    float core = alpha * clamp(coreRadius + 0.5 - distance, 0.0, 1.0);
+    float glow = 0.3 * alpha * clamp(glowRadius + 0.5 - distance, 0.0, 1.0);
+    float outAlpha = glow + core * (1.0 - glow);
+    if (outAlpha <= 0.0) discard;
+    vec3 color = starColor * (0.9 * glow + core * (1.0 - glow)) / outAlpha;
+    FragColor = vec4(color, outAlpha);
+}
+)";
+
 CelestialSystem::CelestialSystem(int numStars)
-    : enabled(true) {
-    stars.reserve(numStars);
+    : starCount(numStars), generatedStars(0), enabled(true), sunTransmittance(1.0f), starTime(0.0f),
+      starVisibility(1.0f), limitingMagnitude(kDarkSkyLimit), uploadedStars(0), bufferCapacity(0), drawnStars(0),
+      starProgram(0), starVAO(0), starVBO(0), uStarProjection(-1), uStarTime(-1), uStarVisibility(-1),
+      uStarSkyScale(-1), uStarLimit(-1) {
 }
 
-void CelestialSystem::update(float deltaTime, const WeatherSystem& weather) {
-    // Update star twinkling
-    for (auto& star : stars) {
-        star.twinklePhase += deltaTime * star.twinkleSpeed;
-        if (star.twinklePhase > 2.0f * 3.14159f) {
-            star.twinklePhase -= 2.0f * 3.14159f;
-        }
+CelestialSystem::~CelestialSystem() {
+    shutdown();
+}
+
+bool CelestialSystem::init() {
+    starProgram = Renderer::createShaderProgram(starVertexSource, starFragmentSource);
+    if (!starProgram) return false;
+    uStarProjection = glGetUniformLocation(starProgram, "projection");
+    uStarTime = glGetUniformLocation(starProgram, "time");
+    uStarVisibility = glGetUniformLocation(starProgram, "visibility");
+    uStarSkyScale = glGetUniformLocation(starProgram, "skyScale");
+    uStarLimit = glGetUniformLocation(starProgram, "limitingMagnitude");
+
+    glGenVertexArrays(1, &starVAO);
+    glGenBuffers(1, &starVBO);
+    glBindVertexArray(starVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, starVBO);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(CatalogStar), (void*)offsetof(CatalogStar, position));
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, sizeof(CatalogStar), (void*)offsetof(CatalogStar, magnitude));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(CatalogStar), (void*)offsetof(CatalogStar, colorIndex));
+    glEnableVertexAttribArray(2);
+    glBindVertexArray(0);
+
+    uploadedStars = bufferCapacity = 0;
+    return true;
+}
+
+void CelestialSystem::shutdown() {
+    if (starVBO) glDeleteBuffers(1, &starVBO);
+    if (starVAO) glDeleteVertexArrays(1, &starVAO);
+    if (starProgram) glDeleteProgram(starProgram);
+    starVBO = starVAO = 0;
+    starProgram = 0;
+    uploadedStars = bufferCapacity = drawnStars = 0;
+}
+
+bool CelestialSystem::loadCatalog(const std::string& path) {
+    if (!catalog.open(path)) {
+        // open() cleared the catalog; rebuild the generated field
+        generatedStars = 0;
+        return false;
+    }
+    uploadedStars = 0;
+    return true;
+}
+
+void CelestialSystem::update(float deltaTime, const WeatherSystem& weather, float cloudCover) {
+    // The shader derives every star's twinkle from this one clock
+    starTime = std::fmod(starTime + deltaTime, kTwinklePeriod);
+
+    if (!catalog.isMapped() && starCount != generatedStars) {
+        generateStars();
+    }
+
+    // Stars fade with cloud cover
+    starVisibility = 1.0f - cloudCover * 0.8f;
+    if (weather.getState() == WeatherState::CLEAR) {
+        starVisibility = 1.0f;
+    }
+
+    // Limiting magnitude from the sky luminance relative to a clear night,
+    // less the light the clouds take away
+    const glm::vec3 luma(0.2126f, 0.7152f, 0.0722f);
+    float skyRatio = std::max(glm::dot(weather.getSkyColor(), luma) / glm::dot(kNightSkyColor, luma), 1.0f);
+    limitingMagnitude = kDarkSkyLimit - kMagnitudesPerDecade * std::log10(skyRatio) +
+                        2.5f * std::log10(std::max(starVisibility, 0.01f));
+
+    // Draw (and upload) only the buckets holding stars that bright
+    int buckets = catalog.bucketsBrighterThan(limitingMagnitude);
+    drawnStars = 0;
+    if (buckets > 0) {
+        const StarBucket& last = catalog.getBuckets()[buckets - 1];
+        drawnStars = static_cast<int>(last.first + last.count);
+    }
+    if (starVBO && drawnStars > uploadedStars) {
+        uploadStars(drawnStars);
     }
 }
 
 void CelestialSystem::render(Renderer& renderer, const WeatherSystem& weather, int screenWidth, int screenHeight) {
     if (!enabled) return;
     
-    // Generate stars if not already done
-    if (stars.empty()) {
-        generateStars(screenWidth, screenHeight);
-    }
-    
-    float timeOfDay = weather.getTimeOfDay();
-    
-    // Determine visibility based on time and weather
-    bool isNight = (timeOfDay < 0.25f || timeOfDay > 0.75f);
-    bool isDay = (timeOfDay >= 0.4f && timeOfDay <= 0.6f);
-    bool isDawnDusk = !isNight && !isDay;
-    
-    // Stars visible at night (reduced by cloud cover)
-    if (isNight) {
-        float starVisibility = 1.0f - weather.getCloudCover() * 0.8f;
-        if (weather.getState() == WeatherState::CLEAR) {
-            starVisibility = 1.0f;
-        }
-        renderStars(renderer, starVisibility);
+    // Stars: as many magnitude buckets as the sky brightness allows (none
+    // by day, the brightest few at twilight)
+    if (drawnStars > 0) {
+        renderStars(renderer, screenWidth, screenHeight);
     }
     
-    // Calculate celestial body positions
-    glm::vec2 sunPosition = calculateCelestialPosition(timeOfDay, screenWidth, screenHeight, true);
-    glm::vec2 moonPosition = calculateCelestialPosition(timeOfDay, screenWidth, screenHeight, false);
+    // Sun and moon where the ephemeris puts them for the site and date
+    const EphemerisSample& sky = weather.getSky();
+    float latitude = weather.getEphemeris().getLatitude();
+    glm::vec2 sunPosition = calculateCelestialPosition(sky.sunAltitude, sky.sunAzimuth, latitude, screenWidth, screenHeight);
+    glm::vec2 moonPosition = calculateCelestialPosition(sky.moonAltitude, sky.moonAzimuth, latitude, screenWidth, screenHeight);
     float radius = 40.0f;
     
-    // Render sun during day
-    if (timeOfDay >= 0.25f && timeOfDay <= 0.75f) {
-        // Sun visible from dawn to dusk
-        float sunAlpha = 1.0f;
-        
-        // Fade during dawn/dusk
-        if (timeOfDay < 0.35f) {
-            sunAlpha = (timeOfDay - 0.25f) / 0.1f;
-        } else if (timeOfDay > 0.65f) {
-            sunAlpha = (0.75f - timeOfDay) / 0.1f;
-        }
+    // How far the sun is into daylight, 0 below civil twilight
+    float daylight = std::min(std::max((sky.sunAltitude + 6.0f) / 12.0f, 0.0f), 1.0f);
+    
+    // Render sun while above the horizon
+    if (sky.sunAltitude > kHorizonAltitude) {
+        // Fade in over the first ten degrees after sunrise (and out before sunset)
+        float sunAlpha = std::min((sky.sunAltitude - kHorizonAltitude) / 10.0f, 1.0f);
         
-        // Reduce visibility in bad weather
-        if (weather.getState() == WeatherState::RAINING || 
-            weather.getState() == WeatherState::THUNDERSTORM) {
-            sunAlpha *= 0.3f;
-        } else if (weather.getState() == WeatherState::CLOUDY) {
-            sunAlpha *= 0.6f;
-        }
+        // Dim behind the clouds between the sun and the viewer (a thick
+        // deck still lets a glow through)
+        sunAlpha *= 0.15f + 0.85f * sunTransmittance;
         
         if (sunAlpha > 0.01f) {
-            renderSun(renderer, sunPosition, radius);
+            renderSun(renderer, sunPosition, radius, sunAlpha);
         }
     }
     
-    // Render moon during night (opposite times from sun)
-    if (timeOfDay < 0.25f || timeOfDay > 0.75f) {
-        float moonAlpha = 1.0f;
-        
-        // Fade during dawn/dusk
-        if (timeOfDay > 0.15f && timeOfDay < 0.25f) {
-            moonAlpha = (0.25f - timeOfDay) / 0.1f;
-        } else if (timeOfDay > 0.75f && timeOfDay < 0.85f) {
-            moonAlpha = (timeOfDay - 0.75f) / 0.1f;
-        }
+    // Render moon while above the horizon; washed out in daylight
+    if (sky.moonAltitude > -0.5f) {
+        float moonAlpha = std::min((sky.moonAltitude + 0.5f) / 5.0f, 1.0f) * (1.0f - 0.7f * daylight);
         
         // Reduce visibility in bad weather
         if (weather.getState() == WeatherState::RAINING || 
@@ -91,113 +226,164 @@ void CelestialSystem::render(Renderer& renderer, const WeatherSystem& weather, i
         }
         
         if (moonAlpha > 0.01f) {
-            // Moon phase (simplified - could be tied to actual date)
-            float phase = fmod(timeOfDay * 30.0f, 1.0f);  // Cycle through phases
-            renderMoon(renderer, moonPosition, radius, phase, moonAlpha);
+            // Waxing moons are lit from the west: on the right when facing
+            // south, on the left when facing north
+            bool litFromRight = (sky.moonPhase < 0.5f) == (latitude >= 0.0f);
+            renderMoon(renderer, moonPosition, radius, sky.moonPhase, litFromRight, 1.0f - daylight, moonAlpha);
         }
     }
 }
 
-void CelestialSystem::generateStars(int screenWidth, int screenHeight) {
-    stars.clear();
-    
-    for (int i = 0; i < 100; i++) {
-        Star star;
-        star.position.x = random(0.0f, static_cast<float>(screenWidth));
-        star.position.y = random(0.0f, static_cast<float>(screenHeight) * 0.6f);  // Upper portion
-        star.brightness = random(0.3f, 1.0f);
-        star.twinklePhase = random(0.0f, 6.28f);
-        star.twinkleSpeed = random(1.0f, 3.0f);
-        star.size = random(1.0f, 2.5f);
-        
-        stars.push_back(star);
+void CelestialSystem::generateStars() {
+    std::vector<CatalogStar> generated(starCount);
+    for (auto& star : generated) {
+        star.position.x = random(0.0f, 1.0f);
+        star.position.y = random(0.0f, 1.0f);
+        // Inverse of the cumulative count N(<m) ~ 10^(kCountSlope m): most
+        // stars sit near the naked-eye limit, a few are much brighter
+        star.magnitude = kDarkSkyLimit + std::log10(random(0.001f, 1.0f)) / kCountSlope;
+        star.colorIndex = random(-0.3f, 1.8f);
     }
+    catalog.setStars(generated);
+    generatedStars = starCount;
+    uploadedStars = 0;
 }
 
-void CelestialSystem::renderSun(Renderer& renderer, glm::vec2 position, float radius) {
+void CelestialSystem::uploadStars(int count) {
+    const CatalogStar* source = catalog.getStars();
+    glBindBuffer(GL_ARRAY_BUFFER, starVBO);
+    if (count > bufferCapacity) {
+        // Grow geometrically so brightening and darkening skies do not keep
+        // reallocating; everything below uploadedStars is sent again
+        bufferCapacity = std::min(std::max(count, bufferCapacity * 2), static_cast<int>(catalog.getStarCount()));
+        glBufferData(GL_ARRAY_BUFFER, bufferCapacity * sizeof(CatalogStar), nullptr, GL_STATIC_DRAW);
+        uploadedStars = 0;
+    }
+    // Only the newly visible buckets are read, so only their pages of a
+    // mapped catalog get faulted in
+    glBufferSubData(GL_ARRAY_BUFFER, uploadedStars * sizeof(CatalogStar), (count - uploadedStars) * sizeof(CatalogStar),
+                    source + uploadedStars);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    uploadedStars = count;
+}
+
+void CelestialSystem::renderSun(Renderer& renderer, glm::vec2 position, float radius, float alpha) {
     // Outer glow (large, faint)
-    glm::vec4 outerGlow(1.0f, 0.9f, 0.5f, 0.1f);
+    glm::vec4 outerGlow(1.0f, 0.9f, 0.5f, 0.1f * alpha);
     renderer.drawCircle(position, radius * 2.5f, outerGlow);
     
     // Middle glow
-    glm::vec4 middleGlow(1.0f, 0.95f, 0.6f, 0.3f);
+    glm::vec4 middleGlow(1.0f, 0.95f, 0.6f, 0.3f * alpha);
     renderer.drawCircle(position, radius * 1.5f, middleGlow);
     
     // Sun body
-    glm::vec4 sunColor(1.0f, 0.95f, 0.7f, 1.0f);
+    glm::vec4 sunColor(1.0f, 0.95f, 0.7f, alpha);
     renderer.drawCircle(position, radius, sunColor);
     
     // Bright core
-    glm::vec4 coreColor(1.0f, 1.0f, 0.95f, 1.0f);
+    glm::vec4 coreColor(1.0f, 1.0f, 0.95f, alpha);
     renderer.drawCircle(position, radius * 0.7f, coreColor);
 }
 
-void CelestialSystem::renderMoon(Renderer& renderer, glm::vec2 position, float radius, float phase, float alpha) {
-    // Moon glow (behind)
-    glm::vec4 glowColor(0.8f, 0.8f, 0.9f, 0.2f * alpha);
+void CelestialSystem::renderMoon(Renderer& renderer, glm::vec2 position, float radius, float phase, bool litFromRight,
+                                 float earthshine, float alpha) {
+    // Moon glow (behind), stronger the fuller the moon
+    float illumination = 0.5f * (1.0f - std::cos(phase * 2.0f * 3.14159f));
+    glm::vec4 glowColor(0.8f, 0.8f, 0.9f, 0.2f * alpha * illumination);
     renderer.drawCircle(position, radius * 1.4f, glowColor);
     
-    // Moon body (pale white/gray)
+    // Unlit disc, faintly visible by earthshine at night
+    glm::vec4 darkColor(0.25f, 0.25f, 0.3f, 0.5f * alpha * earthshine);
+    renderer.drawCircle(position, radius, darkColor);
+    
+    // Lit part (pale white/gray), one strip per two pixel rows. The
+    // terminator is a half-ellipse whose width follows the phase angle.
     glm::vec4 moonColor(0.9f, 0.9f, 0.95f, 0.9f * alpha);
-    renderer.drawCircle(position, radius, moonColor);
+    float terminator = std::cos(phase * 2.0f * 3.14159f);
+    int rows = std::max(static_cast<int>(radius), 1);
+    float rowHeight = 2.0f * radius / rows;
+    for (int row = 0; row < rows; row++) {
+        float y = -radius + (row + 0.5f) * rowHeight;
+        float halfWidth = std::sqrt(std::max(radius * radius - y * y, 0.0f));
+        float inner = halfWidth * terminator;
+        float left = litFromRight ? inner : -halfWidth;
+        float right = litFromRight ? halfWidth : -inner;
+        if (right > left) {
+            renderer.drawRectangle(glm::vec2(position.x + left, position.y + y - 0.5f * rowHeight),
+                                   glm::vec2(right - left, rowHeight), moonColor);
+        }
+    }
 }
 
-void CelestialSystem::renderStars(Renderer& renderer, float visibility) {
-    for (const auto& star : stars) {
-        // Twinkling effect
-        float twinkle = 0.5f + 0.5f * sin(star.twinklePhase);
-        float brightness = star.brightness * twinkle * visibility;
-        
-        glm::vec4 starColor(1.0f, 1.0f, 1.0f, brightness);
-        renderer.drawCircle(star.position, star.size, starColor);
-        
-        // Some stars have a slight glow
-        if (star.brightness > 0.7f) {
-            glm::vec4 glowColor(0.9f, 0.9f, 1.0f, brightness * 0.3f);
-            renderer.drawCircle(star.position, star.size * 2.0f, glowColor);
-        }
+void CelestialSystem::renderStars(Renderer& renderer, int screenWidth, int screenHeight) const {
+    if (!starProgram || uploadedStars < drawnStars) return;
+    
+    // Anything already batched is behind the stars
+    renderer.flush();
+    
+    glUseProgram(starProgram);
+    glUniformMatrix4fv(uStarProjection, 1, GL_FALSE, &renderer.getProjection()[0][0]);
+    // Catalog positions span the width and the upper 60% of the window
+    glUniform2f(uStarSkyScale, static_cast<float>(screenWidth), static_cast<float>(screenHeight) * 0.6f);
+    glUniform1f(uStarTime, starTime);
+    glUniform1f(uStarVisibility, starVisibility);
+    glUniform1f(uStarLimit, limitingMagnitude);
+    
+    glEnable(GL_PROGRAM_POINT_SIZE);
+    glBindVertexArray(starVAO);
+    glDrawArrays(GL_POINTS, 0, drawnStars);
+    glBindVertexArray(0);
+    glDisable(GL_PROGRAM_POINT_SIZE);
+}
+
+glm::vec2 CelestialSystem::getLightPosition(const WeatherSystem& weather, int screenWidth, int screenHeight) const {
+    const EphemerisSample& sky = weather.getSky();
+    float latitude = weather.getEphemeris().getLatitude();
+    if (sky.sunAltitude > kHorizonAltitude) {
+        return calculateCelestialPosition(sky.sunAltitude, sky.sunAzimuth, latitude, screenWidth, screenHeight);
     }
+    return calculateCelestialPosition(sky.moonAltitude, sky.moonAzimuth, latitude, screenWidth, screenHeight);
 }
 
-glm::vec2 CelestialSystem::calculateCelestialPosition(float timeOfDay, int screenWidth, int screenHeight, bool isSun) const {
-    if (isSun) {
-        // Sun: Arc from left (east) to right (west) during day (0.25 to 0.75)
-        // Map 0.25-0.75 to 0-PI for arc
-        float normalizedTime = (timeOfDay - 0.25f) / 0.5f;  // 0 to 1
-        float angle = normalizedTime * 3.14159f;  // 0 to PI
-        
-        // X: Move from left to right
-        float x = screenWidth * 0.1f + normalizedTime * screenWidth * 0.8f;
-        
-        // Y: Arc upward - starts at top area, peaks higher, stays visible
-        // sin(0) = 0, sin(PI/2) = 1, sin(PI) = 0
-        float arcHeight = screenHeight * 0.25f;  // Arc height
-        float baseY = screenHeight * 0.45f;  // Starting position (higher up)
-        float y = baseY - sin(angle) * arcHeight;  // Subtract because Y increases downward
-        
-        return glm::vec2(x, y);
-    } else {
-        // Moon: Arc from right (west) to left (east) during night
-        // For night time (0.75-1.0 and 0.0-0.25), create continuous arc
-        float moonTime;
-        if (timeOfDay > 0.75f) {
-            moonTime = (timeOfDay - 0.75f) / 0.5f;  // 0.75-1.0 maps to 0-0.5
-        } else {
-            moonTime = (timeOfDay + 0.25f) / 0.5f;  // 0.0-0.25 maps to 0.5-1.0
-        }
-        
-        float angle = moonTime * 3.14159f;  // 0 to PI
-        
-        // X: Move from right to left
-        float x = screenWidth * 0.9f - moonTime * screenWidth * 0.8f;
-        
-        // Y: Arc upward - starts at top area, peaks higher, stays visible
-        float arcHeight = screenHeight * 0.25f;
-        float baseY = screenHeight * 0.45f;  // Starting position (higher up)
-        float y = baseY - sin(angle) * arcHeight;
-        
-        return glm::vec2(x, y);
+glm::vec2 CelestialSystem::getSunPosition(const WeatherSystem& weather, int screenWidth, int screenHeight) const {
+    const EphemerisSample& sky = weather.getSky();
+    return calculateCelestialPosition(sky.sunAltitude, sky.sunAzimuth, weather.getEphemeris().getLatitude(),
+                                      screenWidth, screenHeight);
+}
+
+glm::vec2 CelestialSystem::getMoonPosition(const WeatherSystem& weather, int screenWidth, int screenHeight) const {
+    const EphemerisSample& sky = weather.getSky();
+    return calculateCelestialPosition(sky.moonAltitude, sky.moonAzimuth, weather.getEphemeris().getLatitude(),
+                                      screenWidth, screenHeight);
+}
+
+float CelestialSystem::getShadowStrength(const WeatherSystem& weather) const {
+    // Direct sunlight fades in and out with the sun at dawn and dusk;
+    // moonlight casts faint shadows, fading out as the moon sets
+    const EphemerisSample& sky = weather.getSky();
+    if (sky.sunAltitude > kHorizonAltitude) {
+        float fade = std::min((sky.sunAltitude - kHorizonAltitude) / 10.0f, 1.0f);
+        return 0.2f + 0.4f * fade;
     }
+    float moonFade = std::min(std::max((sky.moonAltitude - kHorizonAltitude) / 10.0f, 0.0f), 1.0f);
+    return 0.2f * moonFade;
+}
+
+glm::vec2 CelestialSystem::calculateCelestialPosition(float altitude, float azimuth, float latitude, int screenWidth,
+                                                      int screenHeight) const {
+    // X: azimuth relative to the direction faced (south, or north below the
+    // equator); azimuth grows to the right whichever way we face
+    float facing = latitude >= 0.0f ? 180.0f : 0.0f;
+    float offset = std::fmod(azimuth - facing + 540.0f, 360.0f) - 180.0f;
+    float x = screenWidth * (0.5f + offset / kSkyViewSpan);
+    
+    // Y: the horizon sits at kSkyHorizonY (0.85 of the height) and the
+    // zenith near the top (Y increases downward)
+    float baseY = screenHeight * kSkyHorizonY;
+    float arcHeight = screenHeight * kSkyArcHeight;
+    float y = baseY - std::sin(altitude * 3.14159f / 180.0f) * arcHeight;
+    
+    return glm::vec2(x, y);
 }
 
 float CelestialSystem::random(float min, float max) const {
@@ -0,0 +1,263 @@
+#include "CloudImpostorAtlas.h"
+#include "Renderer.h"
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+
+// Slot size in texels. Clouds are wider than tall (see generateCloudShape:
+// offsets up to 0.5 x 0.3 of the size, puff radius up to 0.8), so slots are too.
+static const int kSlotWidth = 256;
+static const int kSlotHeight = 224;
+static const int kAtlasColumns = 4;
+
+// Puff offsets plus the largest puff radius, in units of the cloud size
+static const glm::vec2 kHalfExtent(1.3f, 1.1f);
+
+// Largest number of puffs per cloud; the baked overlap count is stored
+// divided by this to fit an 8-bit channel
+static const int kMaxCircles = 9;
+
+static const char* bakeVertexSource = R"(
+#version 330 core
+out vec2 local;
+
+uniform vec2 halfExtent;
+
+void main() {
+    vec2 corner = vec2(float(gl_VertexID & 1), float(gl_VertexID >> 1));
+    local = (corner * 2.0 - 1.0) * halfExtent;
+    gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+}
+)";
+
+// Count the puffs covering this texel, with a one-texel soft edge
+static const char* bakeFragmentSource = R"(
+#version 330 core
+in vec2 local;
+out vec4 FragColor;
+
+uniform vec3 circles[9];
+uniform int circleCount;
+uniform float texelSize;
+
+void main() {
+    float overlap = 0.0;
+    for (int i = 0; i < circleCount; i++) {
+        float distance = length(local - circles[i].xy) - circles[i].z;
+        overlap += clamp(0.5 - distance / texelSize, 0.0, 1.0);
+    }
+    FragColor = vec4(overlap / 9.0, 0.0, 0.0, 1.0);
+}
+)";
+
+static const char* drawVertexSource = R"(
+#version 330 core
+layout (location = 0) in vec2 aPos;
+layout (location = 1) in vec2 aTexCoord;
+layout (location = 2) in vec4 aColor;
+
+out vec2 texCoord;
+out vec4 tint;
+out vec2 lightCoord;
+
+uniform mat4 projection;
+
+void main() {
+    gl_Position = projection * vec4(aPos, 0.0, 1.0);
+    texCoord = aTexCoord;
+    tint = aColor;
+    lightCoord = gl_Position.xy * 0.5 + 0.5;
+}
+)";
+
+// n puffs of opacity a stacked with alpha blending give 1 - (1 - a)^n.
+// Local light (lightning, sun glow) is added to the cloud colour.
+static const char* drawFragmentSource = R"(
+#version 330 core
+in vec2 texCoord;
+in vec4 tint;
+in vec2 lightCoord;
+out vec4 FragColor;
+
+uniform sampler2D atlas;
+uniform sampler2D lightBuffer;
+uniform float maxOverlap;
+
+void main() {
+    float overlap = texture(atlas, texCoord).r * maxOverlap;
+    float alpha = 1.0 - pow(1.0 - tint.a, overlap);
+    if (alpha <= 0.0) discard;
+    FragColor = vec4(tint.rgb + texture(lightBuffer, lightCoord).rgb, alpha);
+}
+)";
+
+CloudImpostorAtlas::CloudImpostorAtlas()
+    : columns(kAtlasColumns), atlasWidth(0), atlasHeight(0), texture(0), framebuffer(0), bakeProgram(0),
+      drawProgram(0), bakeVAO(0), drawVAO(0), drawVBO(0), uCircles(-1), uCircleCount(-1), uHalfExtent(-1),
+      uTexelSize(-1), uProjection(-1), uAtlas(-1), uMaxOverlap(-1) {
+}
+
+CloudImpostorAtlas::~CloudImpostorAtlas() {
+    shutdown();
+}
+
+bool CloudImpostorAtlas::init(int slotCount) {
+    int rows = (slotCount + columns - 1) / columns;
+    atlasWidth = columns * kSlotWidth;
+    atlasHeight = rows * kSlotHeight;
+
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, atlasWidth, atlasHeight, 0, GL_RED, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (!complete) {
+        std::cerr << "Cloud impostor atlas framebuffer incomplete" << std::endl;
+        shutdown();
+        return false;
+    }
+
+    bakeProgram = Renderer::createShaderProgram(bakeVertexSource, bakeFragmentSource);
+    uCircles = glGetUniformLocation(bakeProgram, "circles");
+    uCircleCount = glGetUniformLocation(bakeProgram, "circleCount");
+    uHalfExtent = glGetUniformLocation(bakeProgram, "halfExtent");
+    uTexelSize = glGetUniformLocation(bakeProgram, "texelSize");
+
+    drawProgram = Renderer::createShaderProgram(drawVertexSource, drawFragmentSource);
+    uProjection = glGetUniformLocation(drawProgram, "projection");
+    uAtlas = glGetUniformLocation(drawProgram, "atlas");
+    uMaxOverlap = glGetUniformLocation(drawProgram, "maxOverlap");
+    Renderer::useLightBuffer(drawProgram);
+
+    glGenVertexArrays(1, &bakeVAO);
+    glGenVertexArrays(1, &drawVAO);
+    glGenBuffers(1, &drawVBO);
+    glBindVertexArray(drawVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, drawVBO);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(QuadVertex), (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(QuadVertex), (void*)offsetof(QuadVertex, uv));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(QuadVertex), (void*)offsetof(QuadVertex, color));
+    glEnableVertexAttribArray(2);
+    glBindVertexArray(0);
+
+    // Hand out low slots first
+    freeSlots.clear();
+    for (int slot = rows * columns - 1; slot >= 0; slot--) {
+        freeSlots.push_back(slot);
+    }
+    vertices.reserve(static_cast<size_t>(rows) * columns * 6);
+    return true;
+}
+
+void CloudImpostorAtlas::shutdown() {
+    if (drawVBO) glDeleteBuffers(1, &drawVBO);
+    if (drawVAO) glDeleteVertexArrays(1, &drawVAO);
+    if (bakeVAO) glDeleteVertexArrays(1, &bakeVAO);
+    if (drawProgram) glDeleteProgram(drawProgram);
+    if (bakeProgram) glDeleteProgram(bakeProgram);
+    if (framebuffer) glDeleteFramebuffers(1, &framebuffer);
+    if (texture) glDeleteTextures(1, &texture);
+    drawVBO = drawVAO = bakeVAO = 0;
+    drawProgram = bakeProgram = 0;
+    framebuffer = 0;
+    texture = 0;
+    freeSlots.clear();
+}
+
+int CloudImpostorAtlas::acquireSlot() {
+    if (freeSlots.empty()) return -1;
+    int slot = freeSlots.back();
+    freeSlots.pop_back();
+    return slot;
+}
+
+void CloudImpostorAtlas::releaseSlot(int slot) {
+    if (slot >= 0) freeSlots.push_back(slot);
+}
+
+glm::vec2 CloudImpostorAtlas::getHalfExtent() {
+    return kHalfExtent;
+}
+
+glm::ivec2 CloudImpostorAtlas::slotOrigin(int slot) const {
+    return glm::ivec2((slot % columns) * kSlotWidth, (slot / columns) * kSlotHeight);
+}
+
+void CloudImpostorAtlas::bake(int slot, const glm::vec3* circles, int count) {
+    if (!framebuffer || slot < 0) return;
+    count = std::min(count, kMaxCircles);
+
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    // The quad covers the whole slot, so it overwrites the previous cloud
+    glm::ivec2 origin = slotOrigin(slot);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(origin.x, origin.y, kSlotWidth, kSlotHeight);
+    glDisable(GL_BLEND);
+
+    glUseProgram(bakeProgram);
+    glUniform3fv(uCircles, count, &circles[0].x);
+    glUniform1i(uCircleCount, count);
+    glUniform2f(uHalfExtent, kHalfExtent.x, kHalfExtent.y);
+    glUniform1f(uTexelSize, 2.0f * kHalfExtent.x / kSlotWidth);
+    glBindVertexArray(bakeVAO);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    glBindVertexArray(0);
+
+    glEnable(GL_BLEND);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
+
+void CloudImpostorAtlas::draw(int slot, glm::vec2 center, float size, const glm::vec4& color) {
+    glm::ivec2 origin = slotOrigin(slot);
+    glm::vec2 uvMin(static_cast<float>(origin.x) / atlasWidth, static_cast<float>(origin.y) / atlasHeight);
+    glm::vec2 uvMax(static_cast<float>(origin.x + kSlotWidth) / atlasWidth,
+                    static_cast<float>(origin.y + kSlotHeight) / atlasHeight);
+
+    // Bake-local y (puff offsets, screen y down) increases with v
+    glm::vec2 halfSize = kHalfExtent * size;
+    glm::vec2 topLeft = center - halfSize;
+    glm::vec2 bottomRight = center + halfSize;
+    QuadVertex a = {topLeft, uvMin, color};
+    QuadVertex b = {glm::vec2(bottomRight.x, topLeft.y), glm::vec2(uvMax.x, uvMin.y), color};
+    QuadVertex c = {bottomRight, uvMax, color};
+    QuadVertex d = {glm::vec2(topLeft.x, bottomRight.y), glm::vec2(uvMin.x, uvMax.y), color};
+    vertices.push_back(a);
+    vertices.push_back(b);
+    vertices.push_back(c);
+    vertices.push_back(a);
+    vertices.push_back(c);
+    vertices.push_back(d);
+}
+
+void CloudImpostorAtlas::flush(const glm::mat4& projection) {
+    if (vertices.empty()) return;
+
+    glUseProgram(drawProgram);
+    glUniformMatrix4fv(uProjection, 1, GL_FALSE, &projection[0][0]);
+    glUniform1i(uAtlas, 0);
+    glUniform1f(uMaxOverlap, static_cast<float>(kMaxCircles));
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glBindVertexArray(drawVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, drawVBO);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(QuadVertex), vertices.data(), GL_DYNAMIC_DRAW);
+    glDrawArrays(GL_TRIANGLES, 0, static_cast<GLsizei>(vertices.size()));
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    vertices.clear();
+}
@@ -0,0 +1,193 @@
+#include "CloudShadowMap.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Optical depth is kept in fixed point so incremental updates never drift
+static const float kDepthScale = 256.0f;
+
+// Lowest light elevation used for the projection (sine of the angle);
+// below it shadows would stretch across the whole screen
+static const float kMinElevation = 0.25f;
+
+// Soft shadow edge: two box passes of this radius, in columns
+static const int kBlurRadius = 3;
+
+CloudShadowMap::CloudShadowMap(float columnWidth)
+    : columnWidth(columnWidth), columns(0), strength(0.0f), sourceTransmittance(1.0f) {
+}
+
+void CloudShadowMap::resize(int screenWidth) {
+    columns = static_cast<int>(std::ceil(screenWidth / columnWidth)) + 1;
+    size_t padded = (static_cast<size_t>(columns) + 4) / 4 * 4;
+
+    // Nothing is projected yet: every occluder starts from an empty interval
+    depthDelta.assign(padded, 0);
+    depth.assign(padded, 0);
+    transmittance.assign(columns, 1.0f);
+    blurScratch.assign(columns, 1.0f);
+    std::fill(intervalDepth.begin(), intervalDepth.end(), 0);
+}
+
+void CloudShadowMap::update(const ShadowOccluders& occluders, glm::vec2 lightPosition, float strength,
+                            int screenWidth, float groundY) {
+    if (columns != static_cast<int>(std::ceil(screenWidth / columnWidth)) + 1) {
+        resize(screenWidth);
+    }
+    this->strength = strength;
+
+    // Light direction as seen from the middle of the ground, kept above a
+    // minimum elevation. A circle of radius r projects to an interval of
+    // half-width r / sin(elevation), shifted away from the light.
+    glm::vec2 observer(screenWidth * 0.5f, groundY);
+    glm::vec2 direction = lightPosition - observer;
+    float length = glm::length(direction);
+    direction = length > 0.0f ? direction / length : glm::vec2(0.0f, -1.0f);
+    if (-direction.y < kMinElevation) {
+        direction = glm::vec2(direction.x < 0.0f ? -1.0f : 1.0f, 0.0f) * std::sqrt(1.0f - kMinElevation * kMinElevation);
+        direction.y = -kMinElevation;
+    }
+    float slope = direction.x / -direction.y;
+    float stretch = 1.0f / -direction.y;
+
+    size_t count = occluders.size();
+    if (intervalDepth.size() < count) {
+        intervalFirst.resize(count, 0);
+        intervalLast.resize(count, 0);
+        intervalDepth.resize(count, 0);
+    }
+    size_t padded = (count + 3) / 4 * 4;
+    nextFirst.resize(padded);
+    nextLast.resize(padded);
+    nextDepth.resize(padded);
+    project(occluders, count, slope, stretch, groundY);
+
+    // Swap in the intervals that changed; occluders that went away give theirs back
+    for (size_t i = 0; i < count; i++) {
+        if (nextFirst[i] == intervalFirst[i] && nextLast[i] == intervalLast[i] && nextDepth[i] == intervalDepth[i]) {
+            continue;
+        }
+        applyInterval(intervalFirst[i], intervalLast[i], -intervalDepth[i]);
+        applyInterval(nextFirst[i], nextLast[i], nextDepth[i]);
+        intervalFirst[i] = nextFirst[i];
+        intervalLast[i] = nextLast[i];
+        intervalDepth[i] = nextDepth[i];
+    }
+    for (size_t i = count; i < intervalDepth.size(); i++) {
+        applyInterval(intervalFirst[i], intervalLast[i], -intervalDepth[i]);
+    }
+    intervalFirst.resize(count);
+    intervalLast.resize(count);
+    intervalDepth.resize(count);
+
+    prefixSum();
+    for (int c = 0; c < columns; c++) {
+        transmittance[c] = std::exp(-depth[c] * (1.0f / kDepthScale));
+    }
+    boxBlur(transmittance, kBlurRadius);
+    boxBlur(transmittance, kBlurRadius);
+
+    sourceTransmittance = getTransmittance(observer.x);
+}
+
+void CloudShadowMap::project(const ShadowOccluders& occluders, size_t count, float slope, float stretch, float groundY) {
+    const float inverseWidth = 1.0f / columnWidth;
+    size_t i = 0;
+#if defined(__SSE2__)
+    // Column bounds are clamped to [-1, columns] and biased by +1 before the
+    // truncating conversion, which then rounds down like floor()
+    const __m128 vSlope = _mm_set1_ps(slope);
+    const __m128 vStretch = _mm_set1_ps(stretch);
+    const __m128 vGround = _mm_set1_ps(groundY);
+    const __m128 vScale = _mm_set1_ps(inverseWidth);
+    const __m128 vDepthScale = _mm_set1_ps(kDepthScale);
+    const __m128 vLow = _mm_set1_ps(-1.0f);
+    const __m128 vHigh = _mm_set1_ps(static_cast<float>(columns));
+    const __m128 vOne = _mm_set1_ps(1.0f);
+    const __m128i vOneInt = _mm_set1_epi32(1);
+    for (; i + 4 <= count; i += 4) {
+        __m128 x = _mm_loadu_ps(&occluders.x[i]);
+        __m128 y = _mm_loadu_ps(&occluders.y[i]);
+        __m128 halfWidth = _mm_mul_ps(_mm_loadu_ps(&occluders.radius[i]), vStretch);
+        __m128 groundX = _mm_sub_ps(x, _mm_mul_ps(_mm_sub_ps(vGround, y), vSlope));
+
+        __m128 first = _mm_mul_ps(_mm_sub_ps(groundX, halfWidth), vScale);
+        __m128 last = _mm_mul_ps(_mm_add_ps(groundX, halfWidth), vScale);
+        first = _mm_add_ps(_mm_min_ps(_mm_max_ps(first, vLow), vHigh), vOne);
+        last = _mm_add_ps(_mm_min_ps(_mm_max_ps(last, vLow), vHigh), vOne);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&nextFirst[i]), _mm_sub_epi32(_mm_cvttps_epi32(first), vOneInt));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&nextLast[i]), _mm_sub_epi32(_mm_cvttps_epi32(last), vOneInt));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&nextDepth[i]),
+                         _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(&occluders.depth[i]), vDepthScale)));
+    }
+#endif
+    for (; i < count; i++) {
+        float groundX = occluders.x[i] - (groundY - occluders.y[i]) * slope;
+        float halfWidth = occluders.radius[i] * stretch;
+        float first = std::min(std::max((groundX - halfWidth) * inverseWidth, -1.0f), static_cast<float>(columns));
+        float last = std::min(std::max((groundX + halfWidth) * inverseWidth, -1.0f), static_cast<float>(columns));
+        nextFirst[i] = static_cast<int32_t>(first + 1.0f) - 1;
+        nextLast[i] = static_cast<int32_t>(last + 1.0f) - 1;
+        nextDepth[i] = static_cast<int32_t>(std::lrint(occluders.depth[i] * kDepthScale));
+    }
+}
+
+void CloudShadowMap::applyInterval(int32_t first, int32_t last, int32_t amount) {
+    first = std::max(first, 0);
+    last = std::min(last, columns - 1);
+    if (amount == 0 || first > last) return;
+    depthDelta[first] += amount;
+    depthDelta[last + 1] -= amount;
+}
+
+void CloudShadowMap::prefixSum() {
+    int c = 0;
+#if defined(__SSE2__)
+    // In-register scan of four columns, then add the running total
+    __m128i carry = _mm_setzero_si128();
+    for (; c + 4 <= columns; c += 4) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&depthDelta[c]));
+        v = _mm_add_epi32(v, _mm_slli_si128(v, 4));
+        v = _mm_add_epi32(v, _mm_slli_si128(v, 8));
+        v = _mm_add_epi32(v, carry);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&depth[c]), v);
+        carry = _mm_shuffle_epi32(v, _MM_SHUFFLE(3, 3, 3, 3));
+    }
+    int32_t running = c > 0 ? depth[c - 1] : 0;
+#else
+    int32_t running = 0;
+#endif
+    for (; c < columns; c++) {
+        running += depthDelta[c];
+        depth[c] = running;
+    }
+}
+
+void CloudShadowMap::boxBlur(std::vector<float>& values, int radius) {
+    // Running window sum; the ends repeat the border value
+    int last = columns - 1;
+    float sum = 0.0f;
+    for (int k = -radius; k <= radius; k++) {
+        sum += values[std::min(std::max(k, 0), last)];
+    }
+    float scale = 1.0f / (2 * radius + 1);
+    for (int c = 0; c < columns; c++) {
+        blurScratch[c] = sum * scale;
+        sum += values[std::min(c + radius + 1, last)] - values[std::max(c - radius, 0)];
+    }
+    values.swap(blurScratch);
+}
+
+float CloudShadowMap::getTransmittance(float x) const {
+    if (columns == 0) return 1.0f;
+    int column = static_cast<int>(x / columnWidth);
+    return transmittance[std::min(std::max(column, 0), columns - 1)];
+}
+
+float CloudShadowMap::getLight(float x) const {
+    return 1.0f - strength * (1.0f - getTransmittance(x));
+}
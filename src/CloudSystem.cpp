@@ -1,33 +1,71 @@
 #include "CloudSystem.h"
 #include <cstdlib>
 #include <algorithm>
+#include <chrono>
+#include <cmath>
+
+// Upper bound on puffs generated per cloud (see generateCloudShape); also
+// the size of each cloud's block in the puff arena
+static const size_t kMaxPuffsPerCloud = 9;
+
+// Width of a coverage histogram column, in pixels
+static const float kCoverageColumnWidth = 8.0f;
+
+// Puff radius that counts as one unit of coverage at full opacity
+static const float kCoverageReferenceRadius = 100.0f;
+
+// Screen y the noise decks cast their shadows from (middle of the decks)
+static const float kNoiseShadowY = 160.0f;
 
 CloudSystem::CloudSystem(int maxClouds)
-    : maxClouds(maxClouds), cloudDensity(0.5f), screenWidth(1280), screenHeight(720) {
-    clouds.reserve(maxClouds);
+    : clouds(maxClouds), puffs(maxClouds * kMaxPuffsPerCloud), maxClouds(maxClouds), cloudDensity(0.5f),
+      screenWidth(1280), screenHeight(720), mode(CloudMode::PUFFS), workers(nullptr), noiseUpdateMs(0.0f),
+      moisture(nullptr), cloudCover(0.0f), deckOpacity(0.4f) {
+
+    // Room for wide screens without reallocating on resize
+    coverage.reserve(1024);
+    coverageDelta.reserve(1025);
+    size_t occluderCapacity = std::max<size_t>(maxClouds * kMaxPuffsPerCloud, 1024);
+    occluders.x.reserve(occluderCapacity);
+    occluders.y.reserve(occluderCapacity);
+    occluders.radius.reserve(occluderCapacity);
+    occluders.depth.reserve(occluderCapacity);
+}
+
+void CloudSystem::init() {
+    impostors.init(maxClouds);
+    
+    // Far deck: higher, slower, hazier; near deck: lower and denser
+    NoiseCloudLayer::Settings far = {20.0f, 200.0f, 1.0f / 16.0f, 0.5f, 0.6f, 1.05f, 0x9E3779B9u};
+    NoiseCloudLayer::Settings near = {60.0f, 240.0f, 1.0f / 24.0f, 1.0f, 0.9f, 1.0f, 0x85EBCA6Bu};
+    
+    decks[0].init(far);
+    decks[1].init(near);
 }
 
 void CloudSystem::update(float deltaTime, const WeatherSystem& weather, int screenWidth, int screenHeight) {
     this->screenWidth = screenWidth;
     this->screenHeight = screenHeight;
     
-    // Determine how many clouds based on cloud cover
-    float targetClouds = weather.getCloudCover() * maxClouds;
+    // Determine how many clouds based on cloud cover: the share of the
+    // moisture grid's columns that hold cloud water, or the weather's
+    cloudCover = moisture ? moisture->getCloudFraction() : weather.getCloudCover();
+    float targetClouds = cloudCover * maxClouds;
     
     // Spawn clouds if below target
-    while (clouds.size() < static_cast<size_t>(targetClouds)) {
+    while (clouds.size() < static_cast<size_t>(targetClouds) && !clouds.full()) {
         spawnCloud(screenWidth, screenHeight, weather);
     }
     
-    // Remove excess clouds if above target
+    // Remove excess clouds if above target (returned to the pool for reuse)
     while (clouds.size() > static_cast<size_t>(targetClouds)) {
-        clouds.pop_back();
+        removeCloud(clouds.size() - 1);
     }
     
     // Update cloud positions
-    glm::vec2 wind = weather.getWindVector();
     for (auto& cloud : clouds) {
-        // Move with wind
+        // Move with the wind where the cloud is
+        glm::vec2 wind = weather.getWindAt(cloud.position);
         cloud.position.x += (cloud.velocity.x + wind.x * 0.5f) * deltaTime;
         
         // Wrap around screen
@@ -37,9 +75,12 @@ void CloudSystem::update(float deltaTime, const WeatherSystem& weather, int scre
             cloud.position.x = screenWidth + cloud.size;
         }
         
-        // Adjust opacity based on weather state
+        // Adjust opacity based on the cloud water above the cloud, or else
+        // the weather state
         WeatherState state = weather.getState();
-        if (state == WeatherState::THUNDERSTORM || state == WeatherState::RAINING) {
+        if (moisture) {
+            cloud.opacity = 0.4f + 0.5f * moisture->getCoverAt(cloud.position.x / screenWidth);
+        } else if (state == WeatherState::THUNDERSTORM || state == WeatherState::RAINING) {
             cloud.opacity = 0.9f;  // Darker clouds
         } else if (state == WeatherState::CLOUDY) {
             cloud.opacity = 0.7f;
@@ -47,30 +88,160 @@ void CloudSystem::update(float deltaTime, const WeatherSystem& weather, int scre
             cloud.opacity = 0.4f;  // Light clouds
         }
     }
+    
+    // Decks darken as the puffs do, with the overall cover standing in for
+    // the cover above a single cloud
+    WeatherState state = weather.getState();
+    if (moisture) {
+        deckOpacity = 0.4f + 0.5f * cloudCover;
+    } else if (state == WeatherState::THUNDERSTORM || state == WeatherState::RAINING) {
+        deckOpacity = 0.9f;
+    } else if (state == WeatherState::CLOUDY) {
+        deckOpacity = 0.7f;
+    } else {
+        deckOpacity = 0.4f;
+    }
+    
+    if (mode == CloudMode::NOISE) {
+        auto start = std::chrono::steady_clock::now();
+        for (auto& deck : decks) {
+            // Each deck drifts with the wind across the middle of its band
+            float windX = weather.getWindAt(glm::vec2(screenWidth * 0.5f, deck.getCenterY())).x;
+            deck.update(deltaTime, windX, screenWidth, workers);
+        }
+        noiseUpdateMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+    
+    buildCoverage();
+    buildOccluders();
 }
 
-void CloudSystem::render(Renderer& renderer, const WeatherSystem& weather) {
-    glm::vec4 baseColor = getCloudColor(weather);
+float CloudSystem::getCoverageColumnWidth() const {
+    return kCoverageColumnWidth;
+}
+
+void CloudSystem::buildCoverage() {
+    size_t columns = static_cast<size_t>(std::ceil(screenWidth / kCoverageColumnWidth));
+    coverage.assign(columns, 0.0f);
+    coverageDelta.assign(columns + 1, 0.0f);
     
+    if (mode == CloudMode::NOISE) {
+        for (const auto& deck : decks) {
+            deck.accumulateCoverage(coverage, kCoverageColumnWidth, cloudCover, deckOpacity);
+        }
+        return;
+    }
+    
+    // Each puff adds a constant weight over the columns it spans. Recording
+    // only the interval ends in a difference array keeps this O(puffs), and
+    // one running sum below turns it into the histogram.
     for (const auto& cloud : clouds) {
-        // Draw each puff that makes up the cloud
-        for (size_t i = 0; i < cloud.puffOffsets.size(); i++) {
-            glm::vec2 puffPos = cloud.position + cloud.puffOffsets[i];
-            float puffSize = cloud.puffSizes[i];
+        const CloudPuff* puff = &puffs[cloud.puffStart];
+        for (uint32_t i = 0; i < cloud.puffCount; i++, puff++) {
+            float centerX = cloud.position.x + puff->offset.x;
+            float radius = puff->size;
             
-            glm::vec4 color = baseColor;
-            color.a = cloud.opacity;
+            int first = static_cast<int>((centerX - radius) / kCoverageColumnWidth);
+            int last = static_cast<int>((centerX + radius) / kCoverageColumnWidth);
+            first = std::max(first, 0);
+            last = std::min(last, static_cast<int>(columns) - 1);
+            if (first > last) continue;
             
-            renderer.drawCircle(puffPos, puffSize, color);
+            float weight = cloud.opacity * radius / kCoverageReferenceRadius;
+            coverageDelta[first] += weight;
+            coverageDelta[last + 1] -= weight;
+        }
+    }
+    
+    float running = 0.0f;
+    for (size_t c = 0; c < columns; c++) {
+        running += coverageDelta[c];
+        coverage[c] = std::max(running, 0.0f);  // Guard against float drift
+    }
+}
+
+void CloudSystem::buildOccluders() {
+    occluders.clear();
+    
+    // Each coverage column of a deck shades like a puff of its width
+    if (mode == CloudMode::NOISE) {
+        for (size_t c = 0; c < coverage.size(); c++) {
+            occluders.add((c + 0.5f) * kCoverageColumnWidth, kNoiseShadowY, kCoverageColumnWidth * 0.5f, coverage[c]);
+        }
+        return;
+    }
+    
+    // Same optical depth per puff as its coverage weight
+    for (const auto& cloud : clouds) {
+        const CloudPuff* puff = &puffs[cloud.puffStart];
+        for (uint32_t i = 0; i < cloud.puffCount; i++, puff++) {
+            glm::vec2 center = cloud.position + puff->offset;
+            occluders.add(center.x, center.y, puff->size, cloud.opacity * puff->size / kCoverageReferenceRadius);
+        }
+    }
+}
+
+void CloudSystem::render(Renderer& renderer, const WeatherSystem& weather) {
+    glm::vec4 baseColor = getCloudColor(weather);
+    
+    if (mode == CloudMode::NOISE) {
+        // Decks draw with their own shader; keep earlier batched sky behind them
+        renderer.flush();
+        glm::vec4 deckColor = baseColor;
+        deckColor.a = deckOpacity;
+        for (auto& deck : decks) {
+            deck.render(renderer.getProjection(), deckColor, cloudCover);
+        }
+        return;
+    }
+    
+    // Baked clouds are one quad each, drawn with their own shader
+    if (impostors.isInitialized()) {
+        renderer.flush();
+    }
+    
+    for (const auto& cloud : clouds) {
+        glm::vec4 color = baseColor;
+        color.a = cloud.opacity;
+        
+        if (cloud.atlasSlot >= 0) {
+            impostors.draw(cloud.atlasSlot, cloud.position, cloud.size, color);
+            continue;
+        }
+        
+        // Not baked: draw each puff that makes up the cloud
+        const CloudPuff* puff = &puffs[cloud.puffStart];
+        for (uint32_t i = 0; i < cloud.puffCount; i++, puff++) {
+            renderer.drawCircle(cloud.position + puff->offset, puff->size, color);
         }
     }
+    impostors.flush(renderer.getProjection());
 }
 
 void CloudSystem::spawnCloud(int screenWidth, int screenHeight, const WeatherSystem& weather) {
-    Cloud cloud;
+    Cloud* slot = clouds.acquire();
+    if (!slot) return;
+    Cloud& cloud = *slot;
     
-    // Random position
+    // New clouds are appended at the dense tail; their puff block matches
+    cloud.puffStart = static_cast<uint32_t>((clouds.size() - 1) * kMaxPuffsPerCloud);
+    
+    // Random position; with a moisture grid, over a column picked in
+    // proportion to its cloud cover
     cloud.position.x = static_cast<float>(rand() % screenWidth);
+    if (moisture) {
+        const std::vector<float>& cover = moisture->getColumnCover();
+        float total = 0.0f;
+        for (float c : cover) total += c;
+        float target = static_cast<float>(rand()) / (RAND_MAX + 1.0f) * total;
+        size_t column = 0;
+        while (column + 1 < cover.size() && target >= cover[column]) {
+            target -= cover[column];
+            column++;
+        }
+        float offset = static_cast<float>(rand()) / (RAND_MAX + 1.0f);
+        cloud.position.x = (column + offset) * screenWidth / cover.size();
+    }
     cloud.position.y = 50.0f + static_cast<float>(rand() % 200);  // Upper part of sky
     
     // Random size
@@ -85,33 +256,57 @@ void CloudSystem::spawnCloud(int screenWidth, int screenHeight, const WeatherSys
     
     // Generate cloud shape
     generateCloudShape(cloud);
-    
-    clouds.push_back(cloud);
+    bakeImpostor(cloud);
+}
+
+void CloudSystem::removeCloud(size_t dense) {
+    // The pool swaps the last cloud into this dense index; its puffs follow
+    // so every cloud keeps the block matching its position
+    size_t last = clouds.size() - 1;
+    impostors.releaseSlot(clouds[dense].atlasSlot);
+    if (dense != last) {
+        const Cloud& moved = clouds[last];
+        std::copy(puffs.begin() + moved.puffStart, puffs.begin() + moved.puffStart + moved.puffCount,
+                  puffs.begin() + dense * kMaxPuffsPerCloud);
+    }
+    clouds.releaseAt(dense);
+    if (dense != last) {
+        clouds[dense].puffStart = static_cast<uint32_t>(dense * kMaxPuffsPerCloud);
+    }
 }
 
 void CloudSystem::generateCloudShape(Cloud& cloud) {
     // Create a fluffy cloud from multiple overlapping circles
-    int numPuffs = 5 + rand() % 5;  // 5-9 puffs per cloud
+    int numPuffs = 5 + rand() % 5;  // 5-9 puffs per cloud (kMaxPuffsPerCloud)
     
-    cloud.puffOffsets.clear();
-    cloud.puffSizes.clear();
-    
-    for (int i = 0; i < numPuffs; i++) {
+    cloud.puffCount = static_cast<uint32_t>(numPuffs);
+    CloudPuff* puff = &puffs[cloud.puffStart];
+    for (int i = 0; i < numPuffs; i++, puff++) {
         // Random offset from cloud center
         float offsetX = (rand() % 100 - 50) * cloud.size / 100.0f;
         float offsetY = (rand() % 60 - 30) * cloud.size / 100.0f;
-        
-        cloud.puffOffsets.push_back(glm::vec2(offsetX, offsetY));
+        puff->offset = glm::vec2(offsetX, offsetY);
         
         // Random puff size
-        float puffSize = cloud.size * (0.4f + static_cast<float>(rand() % 40) / 100.0f);
-        cloud.puffSizes.push_back(puffSize);
+        puff->size = cloud.size * (0.4f + static_cast<float>(rand() % 40) / 100.0f);
+    }
+}
+
+void CloudSystem::bakeImpostor(Cloud& cloud) {
+    cloud.atlasSlot = impostors.isInitialized() ? impostors.acquireSlot() : -1;
+    if (cloud.atlasSlot < 0) return;
+    
+    glm::vec3 circles[kMaxPuffsPerCloud];
+    const CloudPuff* puff = &puffs[cloud.puffStart];
+    for (uint32_t i = 0; i < cloud.puffCount; i++, puff++) {
+        circles[i] = glm::vec3(puff->offset, puff->size) / cloud.size;
     }
+    impostors.bake(cloud.atlasSlot, circles, static_cast<int>(cloud.puffCount));
 }
 
 glm::vec4 CloudSystem::getCloudColor(const WeatherSystem& weather) const {
     WeatherState state = weather.getState();
-    float timeOfDay = weather.getTimeOfDay();
+    float timeOfDay = weather.getDayPhase();
     
     glm::vec4 color;
     
@@ -0,0 +1,214 @@
+#include "ColumnTemperature.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Columns solved together (one SSE register), and the fewest groups per
+// thread worth handing to the workers
+static const int kLanes = 4;
+static const size_t kParallelGroups = 8;
+
+// Longest step taken at once (seconds on screen), and simulated seconds
+// per turn of the time of day
+static const float kMaxStep = 0.05f;
+static const float kSecondsPerDay = 86400.0f;
+
+// Levels span kDepth metres above the ground; the base profile falls
+// kLapseRate degrees per metre (the standard atmosphere's)
+static const float kDepth = 3000.0f;
+static const float kLapseRate = 0.0065f;
+
+// Heating of the lowest level with the sun overhead in a clear sky, and
+// the ground's longwave loss (degrees per second). Cloud shades the sun by
+// kCloudShade and returns kCloudTrap of the loss at full cover.
+static const float kSolarHeating = 0.0025f;
+static const float kCooling = 0.0006f;
+static const float kCloudShade = 0.75f;
+static const float kCloudTrap = 0.8f;
+
+// Departures relax toward the base profile over this long (seconds)
+static const float kRelaxTime = kSecondsPerDay;
+
+// Eddy diffusivity (m^2/s) of stable air, and the extra where the
+// departure's lapse exceeds the base profile's stability margin (degrees
+// between levels, the dry adiabat's 9.8 against the base 6.5 per km) by up
+// to kConvectiveRange degrees
+static const float kStableDiffusion = 2.0f;
+static const float kConvectiveDiffusion = 150.0f;
+static const float kStabilityMargin = 0.0033f;
+static const float kConvectiveRange = 0.5f;
+
+ColumnTemperature::ColumnTemperature(float columnWidth, int levels)
+    : columnWidth(columnWidth), levels(std::max(levels, 2)), columns(0), screenWidth(0), workers(nullptr),
+      moisture(nullptr), stepMs(0.0f), base(0.0f), surfaceMean(0.0f), surfaceMin(0.0f), surfaceMax(0.0f),
+      stepSeconds(0.0f), keep(0.0f) {
+}
+
+void ColumnTemperature::resize(int screenWidth) {
+    this->screenWidth = screenWidth;
+    int needed = static_cast<int>(std::ceil(screenWidth / columnWidth));
+    columns = (needed + kLanes - 1) / kLanes * kLanes;
+
+    size_t cells = static_cast<size_t>(levels) * columns;
+    anomaly.assign(cells, 0.0f);
+    coupling.assign(cells, 0.0f);
+    ratio.assign(cells, 0.0f);
+    partial.assign(cells, 0.0f);
+    heating.assign(columns, 0.0f);
+    surface.assign(columns, base);
+}
+
+float ColumnTemperature::getTemperature(int column, int level) const {
+    if (columns == 0) return base;
+    column = std::min(std::max(column, 0), columns - 1);
+    level = std::min(std::max(level, 0), levels - 1);
+    float height = kDepth * level / (levels - 1);
+    return base - kLapseRate * height + anomaly[static_cast<size_t>(level) * columns + column];
+}
+
+void ColumnTemperature::update(float deltaTime, const WeatherSystem& weather, int screenWidth) {
+    if (screenWidth <= 0) return;
+    auto start = std::chrono::steady_clock::now();
+
+    base = weather.getTemperature();
+    if (screenWidth != this->screenWidth) {
+        resize(screenWidth);
+    }
+
+    stepSeconds = std::min(deltaTime, kMaxStep) * weather.timeScale * kSecondsPerDay;
+    keep = stepSeconds / kRelaxTime;
+
+    // Net heat into the lowest level of each column: the sun by its height
+    // and the cloud above, less what the ground radiates away
+    float sun = std::max(std::sin(weather.getSky().sunAltitude * 0.0174532925f), 0.0f);
+    for (int column = 0; column < columns; column++) {
+        float cover = moisture ? moisture->getCoverAt((column + 0.5f) * columnWidth / screenWidth)
+                               : weather.getCloudCover();
+        float gain = kSolarHeating * sun * (1.0f - kCloudShade * cover);
+        float loss = kCooling * (1.0f - kCloudTrap * cover);
+        heating[column] = (gain - loss) * stepSeconds;
+    }
+
+    int groups = columns / kLanes;
+    if (workers) {
+        workers->parallelFor(static_cast<size_t>(groups), [this](size_t begin, size_t end) {
+            solveGroups(static_cast<int>(begin), static_cast<int>(end));
+        }, kParallelGroups);
+    } else {
+        solveGroups(0, groups);
+    }
+
+    // Ground-level temperatures over the window's columns (not the padding)
+    int visible = std::min(columns, static_cast<int>(std::ceil(screenWidth / columnWidth)));
+    float sum = 0.0f;
+    surfaceMin = surfaceMax = base + anomaly[0];
+    for (int column = 0; column < columns; column++) {
+        surface[column] = base + anomaly[column];
+        if (column >= visible) continue;
+        sum += surface[column];
+        surfaceMin = std::min(surfaceMin, surface[column]);
+        surfaceMax = std::max(surfaceMax, surface[column]);
+    }
+    surfaceMean = sum / visible;
+
+    stepMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void ColumnTemperature::solveGroups(int begin, int end) {
+    float spacing = kDepth / (levels - 1);
+    float diffusionScale = stepSeconds / (spacing * spacing);
+    float margin = kStabilityMargin * spacing;
+    float diagonalBase = 1.0f + keep;
+    int top = levels - 1;
+
+    for (int group = begin; group < end; group++) {
+        int x = group * kLanes;
+        float* T = &anomaly[x];
+        float* K = &coupling[x];
+        float* E = &ratio[x];
+        float* D = &partial[x];
+        size_t stride = columns;
+
+#if defined(__SSE2__)
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 vMargin = _mm_set1_ps(margin);
+        const __m128 vRange = _mm_set1_ps(1.0f / kConvectiveRange);
+        const __m128 vStable = _mm_set1_ps(kStableDiffusion * diffusionScale);
+        const __m128 vConvective = _mm_set1_ps(kConvectiveDiffusion * diffusionScale);
+        const __m128 vDiagonal = _mm_set1_ps(diagonalBase);
+
+        // Coupling across each interface, stronger where the departure
+        // drops off faster than the base profile can hold (from the last
+        // step's profile)
+        for (int level = 0; level < top; level++) {
+            __m128 drop = _mm_sub_ps(_mm_loadu_ps(T + level * stride), _mm_loadu_ps(T + (level + 1) * stride));
+            __m128 unstable = _mm_mul_ps(_mm_sub_ps(drop, vMargin), vRange);
+            unstable = _mm_min_ps(_mm_max_ps(unstable, zero), one);
+            _mm_storeu_ps(K + level * stride, _mm_add_ps(vStable, _mm_mul_ps(vConvective, unstable)));
+        }
+
+        // Forward sweep. Level k: -a T[k-1] + (1 + keep + a + c) T[k] - c T[k+1]
+        // = T_old[k] (+ heating at the ground), with a and c the couplings
+        // below and above; no flux through the ground or the top.
+        __m128 lastRatio = zero;
+        __m128 lastPartial = zero;
+        for (int level = 0; level <= top; level++) {
+            __m128 below = level > 0 ? _mm_loadu_ps(K + (level - 1) * stride) : zero;
+            __m128 above = level < top ? _mm_loadu_ps(K + level * stride) : zero;
+            __m128 rhs = _mm_loadu_ps(T + level * stride);
+            if (level == 0) rhs = _mm_add_ps(rhs, _mm_loadu_ps(&heating[x]));
+
+            __m128 pivot = _mm_sub_ps(_mm_add_ps(vDiagonal, _mm_add_ps(below, above)), _mm_mul_ps(below, lastRatio));
+            __m128 inverse = _mm_div_ps(one, pivot);
+            lastRatio = _mm_mul_ps(above, inverse);
+            lastPartial = _mm_mul_ps(_mm_add_ps(rhs, _mm_mul_ps(below, lastPartial)), inverse);
+            _mm_storeu_ps(E + level * stride, lastRatio);
+            _mm_storeu_ps(D + level * stride, lastPartial);
+        }
+
+        // Back substitution from the top down
+        __m128 next = lastPartial;
+        _mm_storeu_ps(T + top * stride, next);
+        for (int level = top - 1; level >= 0; level--) {
+            next = _mm_add_ps(_mm_loadu_ps(D + level * stride), _mm_mul_ps(_mm_loadu_ps(E + level * stride), next));
+            _mm_storeu_ps(T + level * stride, next);
+        }
+#else
+        float stable = kStableDiffusion * diffusionScale;
+        float convective = kConvectiveDiffusion * diffusionScale;
+        for (int lane = 0; lane < kLanes; lane++) {
+            for (int level = 0; level < top; level++) {
+                float drop = T[level * stride + lane] - T[(level + 1) * stride + lane];
+                float unstable = std::min(std::max((drop - margin) / kConvectiveRange, 0.0f), 1.0f);
+                K[level * stride + lane] = stable + convective * unstable;
+            }
+
+            float lastRatio = 0.0f;
+            float lastPartial = 0.0f;
+            for (int level = 0; level <= top; level++) {
+                float below = level > 0 ? K[(level - 1) * stride + lane] : 0.0f;
+                float above = level < top ? K[level * stride + lane] : 0.0f;
+                float rhs = T[level * stride + lane] + (level == 0 ? heating[x + lane] : 0.0f);
+
+                float pivot = diagonalBase + below + above - below * lastRatio;
+                lastRatio = above / pivot;
+                lastPartial = (rhs + below * lastPartial) / pivot;
+                E[level * stride + lane] = lastRatio;
+                D[level * stride + lane] = lastPartial;
+            }
+
+            float next = lastPartial;
+            T[top * stride + lane] = next;
+            for (int level = top - 1; level >= 0; level--) {
+                next = D[level * stride + lane] + E[level * stride + lane] * next;
+                T[level * stride + lane] = next;
+            }
+        }
+#endif
+    }
+}
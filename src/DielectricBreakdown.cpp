@@ -0,0 +1,329 @@
+#include "DielectricBreakdown.h"
+#include "LightningSystem.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Growth exponent (an integer, so phi^eta is a few multiplies): higher
+// values give straighter, less branched channels
+static const int kEta = 3;
+
+// Over-relaxation factor
+static const float kOmega = 1.85f;
+
+// Red-black sweeps move a change about a cell per sweep, so after each
+// growth step only a window around the new cells is relaxed; every few
+// steps the whole region above the tip gets a sweep as well
+static const int kWindowRadius = 12;
+static const int kWindowSweeps = 4;
+static const int kGlobalSweepInterval = 8;
+static const int kInitialSweeps = 8;
+
+// Cells added between solves, and the channel size at which growth stops
+static const int kCellsPerStep = 8;
+static const int kMaxChannelCellsPerSide = 16;
+
+// Rows below the channel tip covered by the global sweeps
+static const int kSolveMargin = 48;
+
+// Smallest row band handed to a worker thread
+static const size_t kMinRowsPerChunk = 32;
+
+// Cells per output segment along an unbranched stretch of channel
+static const int kCellsPerSegment = 4;
+
+// Branch size (in cells) drawn at full branch brightness
+static const float kFullBranchCells = 200.0f;
+
+static inline uint32_t nextRandom(uint32_t& state) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+static inline float randomUnit(uint32_t& state) {
+    return static_cast<float>(nextRandom(state) >> 8) * (1.0f / 16777216.0f);
+}
+
+DielectricBreakdown::DielectricBreakdown(int gridSize)
+    : size((std::max(gridSize, 16) + 7) / 8 * 8), halfWidth(0), stride(0), workers(nullptr), lastMilliseconds(0.0f),
+      sweepColor(0), sweepFirstRow(0), sweepFirstColumn(0), sweepEndColumn(0) {
+    halfWidth = size / 2;
+    stride = halfWidth + 8;  // Four padding floats on each side of a row
+    for (int color = 0; color < 2; color++) {
+        potential[color].assign(static_cast<size_t>(stride) * size, 0.0f);
+        freeMask[color].assign(static_cast<size_t>(stride) * size, 0.0f);
+    }
+    size_t cells = static_cast<size_t>(size) * size;
+    state.assign(cells, 0);
+    channelIndex.assign(cells, -1);
+    channel.reserve(static_cast<size_t>(size) * kMaxChannelCellsPerSide);
+    parent.reserve(channel.capacity());
+}
+
+void DielectricBreakdown::reset() {
+    // Linear profile from cloud to ground: the exact solution before the
+    // channel exists, and the warm start for the first solve
+    for (int y = 0; y < size; y++) {
+        float value = static_cast<float>(y) / (size - 1);
+        bool boundaryRow = (y == 0 || y == size - 1);
+        for (int color = 0; color < 2; color++) {
+            float* row = &potential[color][static_cast<size_t>(y) * stride];
+            float* mask = &freeMask[color][static_cast<size_t>(y) * stride];
+            std::fill(row, row + stride, value);
+            std::fill(mask, mask + stride, 0.0f);
+            if (!boundaryRow) {
+                std::fill(mask + 4, mask + 4 + halfWidth, 1.0f);
+            }
+        }
+        // Side columns are set from their neighbours after each sweep
+        freeMask[y & 1][storageIndex(0, y)] = 0.0f;
+        freeMask[(size - 1 + y) & 1][storageIndex(size - 1, y)] = 0.0f;
+    }
+
+    for (uint32_t cell : channel) state[cell] = 0;
+    for (uint32_t cell : candidates) state[cell] = 0;
+    for (uint32_t cell : channel) channelIndex[cell] = -1;
+    channel.clear();
+    parent.clear();
+    candidates.clear();
+}
+
+void DielectricBreakdown::fixCell(int x, int y, float value) {
+    int color = (x + y) & 1;
+    size_t index = storageIndex(x, y);
+    potential[color][index] = value;
+    freeMask[color][index] = 0.0f;
+}
+
+void DielectricBreakdown::addToChannel(uint32_t cell, int32_t parentIndex) {
+    int x = static_cast<int>(cell % size);
+    int y = static_cast<int>(cell / size);
+    state[cell] = 2;
+    channelIndex[cell] = static_cast<int32_t>(channel.size());
+    channel.push_back(cell);
+    parent.push_back(parentIndex);
+    fixCell(x, y, 0.0f);
+
+    // Free interior neighbours become growth candidates
+    for (int dy = -1; dy <= 1; dy++) {
+        for (int dx = -1; dx <= 1; dx++) {
+            int nx = x + dx;
+            int ny = y + dy;
+            if (nx < 1 || ny < 1 || nx > size - 2 || ny > size - 2) continue;
+            uint32_t neighbour = static_cast<uint32_t>(ny * size + nx);
+            if (state[neighbour] == 0) {
+                state[neighbour] = 1;
+                candidates.push_back(neighbour);
+            }
+        }
+    }
+}
+
+void DielectricBreakdown::relaxRows(int color, int firstRow, int endRow, int firstColumn, int endColumn) {
+    const int other = 1 - color;
+    for (int y = firstRow; y < endRow; y++) {
+        // Same-row neighbours of this color's cells sit at h - 1, h (even x)
+        // or h, h + 1 (odd x) in the other color's row
+        int shift = ((color + y) & 1) ? 0 : -1;
+        const float* up = &potential[other][static_cast<size_t>(y - 1) * stride + 4];
+        const float* down = &potential[other][static_cast<size_t>(y + 1) * stride + 4];
+        const float* side = &potential[other][static_cast<size_t>(y) * stride + 4 + shift];
+        float* center = &potential[color][static_cast<size_t>(y) * stride + 4];
+        const float* mask = &freeMask[color][static_cast<size_t>(y) * stride + 4];
+
+        int h = firstColumn;
+#if defined(__SSE2__)
+        const __m128 quarter = _mm_set1_ps(0.25f);
+        const __m128 omega = _mm_set1_ps(kOmega);
+        for (; h + 4 <= endColumn; h += 4) {
+            __m128 sum = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(side + h), _mm_loadu_ps(side + h + 1)),
+                                    _mm_add_ps(_mm_loadu_ps(up + h), _mm_loadu_ps(down + h)));
+            __m128 value = _mm_loadu_ps(center + h);
+            __m128 step = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(sum, quarter), value), omega);
+            _mm_storeu_ps(center + h, _mm_add_ps(value, _mm_mul_ps(step, _mm_loadu_ps(mask + h))));
+        }
+#endif
+        for (; h < endColumn; h++) {
+            float average = 0.25f * (side[h] + side[h + 1] + up[h] + down[h]);
+            center[h] += kOmega * (average - center[h]) * mask[h];
+        }
+    }
+}
+
+void DielectricBreakdown::relax(int sweeps, int firstRow, int lastRow, int firstX, int lastX) {
+    firstRow = std::max(firstRow, 1);
+    lastRow = std::min(lastRow, size - 2);
+    if (firstRow > lastRow) return;
+    
+    // Columns in storage units, widened to whole SIMD groups
+    int firstColumn = std::max(firstX / 2, 0) / 4 * 4;
+    int endColumn = std::min((lastX / 2 + 1 + 3) / 4 * 4, halfWidth);
+    size_t rows = static_cast<size_t>(lastRow - firstRow + 1);
+    
+    for (int sweep = 0; sweep < sweeps; sweep++) {
+        for (int color = 0; color < 2; color++) {
+            if (workers) {
+                sweepColor = color;
+                sweepFirstRow = firstRow;
+                sweepFirstColumn = firstColumn;
+                sweepEndColumn = endColumn;
+                workers->parallelFor(rows, [this](size_t begin, size_t end) {
+                    relaxRows(sweepColor, sweepFirstRow + static_cast<int>(begin),
+                              sweepFirstRow + static_cast<int>(end), sweepFirstColumn, sweepEndColumn);
+                }, kMinRowsPerChunk);
+            } else {
+                relaxRows(color, firstRow, lastRow + 1, firstColumn, endColumn);
+            }
+        }
+        
+        // Sides are insulating (zero field across them): mirror the next column
+        if (firstX <= 1 || lastX >= size - 2) {
+            for (int y = firstRow; y <= lastRow; y++) {
+                potentialAt(0, y) = potentialAt(1, y);
+                potentialAt(size - 1, y) = potentialAt(size - 2, y);
+            }
+        }
+    }
+}
+
+uint32_t DielectricBreakdown::generate(LightningSegment* out, uint32_t budget, uint32_t seed) {
+    auto start = std::chrono::steady_clock::now();
+    uint32_t rng = seed ? seed : 1u;
+    reset();
+
+    // Leader starts just under the cloud, somewhere around the middle
+    int seedX = size / 2 + static_cast<int>((randomUnit(rng) - 0.5f) * size * 0.25f);
+    addToChannel(static_cast<uint32_t>(size + seedX), -1);
+    int deepestRow = 1;
+    uint32_t tip = channel[0];
+    relax(kInitialSweeps, 1, deepestRow + kSolveMargin, 0, size - 1);
+
+    size_t maxCells = static_cast<size_t>(size) * kMaxChannelCellsPerSide;
+    bool grounded = false;
+    for (int step = 1; !grounded && channel.size() < maxCells; step++) {
+        // Drop candidates that joined the channel, and weight the rest by phi^eta
+        size_t kept = 0;
+        candidateCdf.resize(candidates.size());
+        float total = 0.0f;
+        for (uint32_t cell : candidates) {
+            if (state[cell] != 1) continue;
+            int x = static_cast<int>(cell % size);
+            int y = static_cast<int>(cell / size);
+            float phi = std::max(potentialAt(x, y), 0.0f);
+            float weight = phi;
+            for (int e = 1; e < kEta; e++) weight *= phi;
+            total += weight;
+            candidateCdf[kept] = total;
+            candidates[kept++] = cell;
+        }
+        candidates.resize(kept);
+        if (kept == 0 || total <= 0.0f) break;
+
+        int grown[kCellsPerStep][2];
+        int grownCount = 0;
+        for (int g = 0; g < kCellsPerStep && !grounded; g++) {
+            float pick = randomUnit(rng) * total;
+            size_t index = std::upper_bound(candidateCdf.begin(), candidateCdf.begin() + kept, pick) - candidateCdf.begin();
+            uint32_t cell = candidates[std::min(index, kept - 1)];
+            if (state[cell] != 1) continue;
+
+            // Attach to a channel neighbour, preferring the ones above
+            static const int order[8][2] = {{0, -1}, {-1, -1}, {1, -1}, {-1, 0}, {1, 0}, {-1, 1}, {1, 1}, {0, 1}};
+            int x = static_cast<int>(cell % size);
+            int y = static_cast<int>(cell / size);
+            int32_t parentIndex = -1;
+            for (const auto& offset : order) {
+                int32_t neighbour = channelIndex[(y + offset[1]) * size + x + offset[0]];
+                if (neighbour >= 0) {
+                    parentIndex = neighbour;
+                    break;
+                }
+            }
+            addToChannel(cell, parentIndex);
+            grown[grownCount][0] = x;
+            grown[grownCount][1] = y;
+            grownCount++;
+
+            if (y > deepestRow) {
+                deepestRow = y;
+                tip = cell;
+            }
+            grounded = (y >= size - 2);
+        }
+
+        for (int i = 0; i < grownCount; i++) {
+            int x = grown[i][0];
+            int y = grown[i][1];
+            relax(kWindowSweeps, y - kWindowRadius, y + kWindowRadius, x - kWindowRadius, x + kWindowRadius);
+        }
+        if (step % kGlobalSweepInterval == 0) {
+            relax(1, 1, deepestRow + kSolveMargin, 0, size - 1);
+        }
+    }
+
+    uint32_t count = buildSegments(out, budget, tip);
+    lastMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return count;
+}
+
+uint32_t DielectricBreakdown::buildSegments(LightningSegment* out, uint32_t budget, uint32_t tip) {
+    size_t n = channel.size();
+    std::vector<int> children(n, 0);
+    std::vector<int> subtree(n, 1);
+    std::vector<uint8_t> mainChannel(n, 0);
+    std::vector<uint8_t> kept(n, 0);
+    std::vector<int32_t> keptAncestor(n, -1);
+    std::vector<int> sinceKept(n, 0);
+
+    // Parents always precede their children in growth order
+    for (size_t i = 1; i < n; i++) children[parent[i]]++;
+    for (size_t i = n - 1; i > 0; i--) subtree[parent[i]] += subtree[i];
+    for (int32_t i = channelIndex[tip]; i >= 0; i = parent[i]) mainChannel[i] = 1;
+
+    // Keep the root, tips, forks and every few cells along a stretch
+    kept[0] = 1;
+    for (size_t i = 1; i < n; i++) {
+        int32_t p = parent[i];
+        keptAncestor[i] = kept[p] ? p : keptAncestor[p];
+        sinceKept[i] = kept[p] ? 1 : sinceKept[p] + 1;
+        kept[i] = (children[i] != 1 || sinceKept[i] >= kCellsPerSegment) ? 1 : 0;
+    }
+
+    // Unit frame: root at the origin, the tip one unit below
+    int rootX = static_cast<int>(channel[0] % size);
+    int rootY = static_cast<int>(channel[0] / size);
+    float scale = 1.0f / std::max(1, static_cast<int>(tip / size) - rootY);
+    auto unit = [&](uint32_t cell) {
+        return glm::vec2(static_cast<int>(cell % size) - rootX, static_cast<int>(cell / size) - rootY) * scale;
+    };
+
+    // Main channel first, then branches from the largest down
+    uint32_t count = 0;
+    std::vector<std::pair<int, uint32_t>> branches;
+    for (size_t i = 1; i < n; i++) {
+        if (!kept[i]) continue;
+        if (!mainChannel[i]) {
+            branches.emplace_back(subtree[i], static_cast<uint32_t>(i));
+            continue;
+        }
+        if (count < budget) {
+            out[count++] = LightningSegment{unit(channel[keptAncestor[i]]), unit(channel[i]), 1.0f, true};
+        }
+    }
+    std::sort(branches.begin(), branches.end(), [](const std::pair<int, uint32_t>& a, const std::pair<int, uint32_t>& b) {
+        return a.first > b.first;
+    });
+    for (const auto& branch : branches) {
+        if (count >= budget) break;
+        uint32_t i = branch.second;
+        float intensity = 0.15f + 0.45f * std::min(1.0f, std::sqrt(branch.first / kFullBranchCells));
+        out[count++] = LightningSegment{unit(channel[keptAncestor[i]]), unit(channel[i]), intensity, false};
+    }
+    return count;
+}
@@ -0,0 +1,193 @@
+#include "Ephemeris.h"
+#include <algorithm>
+#include <cmath>
+
+// Table step: 5 minutes
+static const int kTableSteps = 24 * 12;
+
+// Sun altitude at rise and set: refraction plus the disc's semidiameter
+static const double kHorizonAltitude = -0.833;
+
+static const double kRadians = 3.14159265358979323846 / 180.0;
+
+static double wrapDegrees(double angle) {
+    angle = std::fmod(angle, 360.0);
+    return angle < 0.0 ? angle + 360.0 : angle;
+}
+
+// Julian date at 0h UT of a Gregorian calendar date
+static double julianFromCalendar(int year, int month, int day) {
+    if (month <= 2) {
+        year -= 1;
+        month += 12;
+    }
+    int a = year / 100;
+    int b = 2 - a + a / 4;
+    return std::floor(365.25 * (year + 4716)) + std::floor(30.6001 * (month + 1)) + day + b - 1524.5;
+}
+
+static void calendarFromJulian(double julian, int& year, int& month, int& day) {
+    double z = std::floor(julian + 0.5);
+    double alpha = std::floor((z - 1867216.25) / 36524.25);
+    double a = z + 1.0 + alpha - std::floor(alpha / 4.0);
+    double b = a + 1524.0;
+    double c = std::floor((b - 122.1) / 365.25);
+    double d = std::floor(365.25 * c);
+    double e = std::floor((b - d) / 30.6001);
+    day = static_cast<int>(b - d - std::floor(30.6001 * e));
+    month = static_cast<int>(e < 14.0 ? e - 1.0 : e - 13.0);
+    year = static_cast<int>(month > 2 ? c - 4716.0 : c - 4715.0);
+}
+
+// Equatorial (right ascension, declination) to altitude and azimuth for a
+// local sidereal time and latitude, all in degrees
+static void equatorialToHorizontal(double rightAscension, double declination, double siderealTime, double latitude,
+                                   double& altitude, double& azimuth) {
+    double hourAngle = (siderealTime - rightAscension) * kRadians;
+    double dec = declination * kRadians;
+    double lat = latitude * kRadians;
+    double sinAltitude = std::sin(lat) * std::sin(dec) + std::cos(lat) * std::cos(dec) * std::cos(hourAngle);
+    altitude = std::asin(std::fmax(-1.0, std::fmin(1.0, sinAltitude))) / kRadians;
+    azimuth = wrapDegrees(std::atan2(std::sin(hourAngle),
+                                     std::cos(hourAngle) * std::sin(lat) - std::tan(dec) * std::cos(lat)) / kRadians +
+                          180.0);
+}
+
+// Interpolate angles in degrees the short way round
+static float lerpDegrees(float a, float b, float t) {
+    float delta = b - a;
+    if (delta > 180.0f) delta -= 360.0f;
+    if (delta < -180.0f) delta += 360.0f;
+    float angle = a + delta * t;
+    return angle < 0.0f ? angle + 360.0f : (angle >= 360.0f ? angle - 360.0f : angle);
+}
+
+Ephemeris::Ephemeris()
+    : year(2024), month(3), day(20), julianDay(0.0), latitude(28.61f), longitude(77.21f), utcOffset(5.5f),
+      sunrise(-1.0f), sunset(-1.0f) {
+    rebuildTable();
+}
+
+void Ephemeris::setDate(int newYear, int newMonth, int newDay) {
+    if (newYear == year && newMonth == month && newDay == day) return;
+    year = newYear;
+    month = newMonth;
+    day = newDay;
+    rebuildTable();
+}
+
+void Ephemeris::getDate(int& outYear, int& outMonth, int& outDay) const {
+    outYear = year;
+    outMonth = month;
+    outDay = day;
+}
+
+void Ephemeris::advanceDay() {
+    int nextYear, nextMonth, nextDay;
+    calendarFromJulian(julianFromCalendar(year, month, day) + 1.0, nextYear, nextMonth, nextDay);
+    setDate(nextYear, nextMonth, nextDay);
+}
+
+void Ephemeris::setSite(float newLatitude, float newLongitude, float utcOffsetHours) {
+    if (newLatitude == latitude && newLongitude == longitude && utcOffsetHours == utcOffset) return;
+    latitude = newLatitude;
+    longitude = newLongitude;
+    utcOffset = utcOffsetHours;
+    rebuildTable();
+}
+
+EphemerisSample Ephemeris::sample(float timeOfDay) const {
+    float position = std::fmin(std::fmax(timeOfDay, 0.0f), 1.0f) * kTableSteps;
+    int row = std::min(static_cast<int>(position), kTableSteps - 1);
+    float t = position - row;
+    const EphemerisSample& a = table[row];
+    const EphemerisSample& b = table[row + 1];
+
+    EphemerisSample result;
+    result.sunAltitude = a.sunAltitude + (b.sunAltitude - a.sunAltitude) * t;
+    result.sunAzimuth = lerpDegrees(a.sunAzimuth, b.sunAzimuth, t);
+    result.moonAltitude = a.moonAltitude + (b.moonAltitude - a.moonAltitude) * t;
+    result.moonAzimuth = lerpDegrees(a.moonAzimuth, b.moonAzimuth, t);
+    // The age wraps from 1 back to 0 at new moon
+    result.moonPhase = lerpDegrees(a.moonPhase * 360.0f, b.moonPhase * 360.0f, t) / 360.0f;
+    result.moonIllumination = a.moonIllumination + (b.moonIllumination - a.moonIllumination) * t;
+    return result;
+}
+
+void Ephemeris::rebuildTable() {
+    julianDay = julianFromCalendar(year, month, day) - utcOffset / 24.0;
+
+    table.resize(kTableSteps + 1);
+    for (int i = 0; i <= kTableSteps; i++) {
+        table[i] = compute(julianDay + static_cast<double>(i) / kTableSteps);
+    }
+
+    // First upward and downward horizon crossings of the day
+    sunrise = sunset = -1.0f;
+    for (int i = 0; i < kTableSteps; i++) {
+        float a = table[i].sunAltitude - static_cast<float>(kHorizonAltitude);
+        float b = table[i + 1].sunAltitude - static_cast<float>(kHorizonAltitude);
+        float crossing = (i + a / (a - b)) / kTableSteps;
+        if (a < 0.0f && b >= 0.0f && sunrise < 0.0f) sunrise = crossing;
+        if (a >= 0.0f && b < 0.0f && sunset < 0.0f) sunset = crossing;
+    }
+}
+
+EphemerisSample Ephemeris::compute(double julianDate) const {
+    double d = julianDate - 2451545.0;
+    double centuries = d / 36525.0;
+    double obliquity = (23.439 - 0.0000004 * d) * kRadians;
+
+    // Sun: mean anomaly, mean longitude, then ecliptic longitude
+    double g = wrapDegrees(357.529 + 0.98560028 * d) * kRadians;
+    double q = wrapDegrees(280.459 + 0.98564736 * d);
+    double sunLongitude = wrapDegrees(q + 1.915 * std::sin(g) + 0.020 * std::sin(2.0 * g));
+    double lambda = sunLongitude * kRadians;
+    double sunRightAscension = std::atan2(std::cos(obliquity) * std::sin(lambda), std::cos(lambda)) / kRadians;
+    double sunDeclination = std::asin(std::sin(obliquity) * std::sin(lambda)) / kRadians;
+
+    // Moon: the main periodic terms of longitude, latitude and parallax
+    auto term = [centuries](double phase, double rate) {
+        return wrapDegrees(phase + rate * centuries) * kRadians;
+    };
+    double moonLongitude = wrapDegrees(218.32 + 481267.881 * centuries + 6.29 * std::sin(term(135.0, 477198.87)) -
+                                       1.27 * std::sin(term(259.3, -413335.36)) +
+                                       0.66 * std::sin(term(235.7, 890534.22)) +
+                                       0.21 * std::sin(term(269.9, 954397.74)) -
+                                       0.19 * std::sin(term(357.5, 35999.05)) -
+                                       0.11 * std::sin(term(186.5, 966404.03)));
+    double moonLatitude = 5.13 * std::sin(term(93.3, 483202.02)) + 0.28 * std::sin(term(228.2, 960400.89)) -
+                          0.28 * std::sin(term(318.3, 6003.15)) - 0.17 * std::sin(term(217.6, -407332.21));
+    double parallax = 0.9508 + 0.0518 * std::cos(term(135.0, 477198.87)) +
+                      0.0095 * std::cos(term(259.3, -413335.36)) + 0.0078 * std::cos(term(235.7, 890534.22)) +
+                      0.0028 * std::cos(term(269.9, 954397.74));
+
+    double lm = moonLongitude * kRadians;
+    double bm = moonLatitude * kRadians;
+    double x = std::cos(bm) * std::cos(lm);
+    double y = std::cos(bm) * std::sin(lm);
+    double z = std::sin(bm);
+    double yEquatorial = y * std::cos(obliquity) - z * std::sin(obliquity);
+    double zEquatorial = y * std::sin(obliquity) + z * std::cos(obliquity);
+    double moonRightAscension = std::atan2(yEquatorial, x) / kRadians;
+    double moonDeclination = std::asin(zEquatorial) / kRadians;
+
+    double siderealTime = wrapDegrees(280.46061837 + 360.98564736629 * d + longitude);
+
+    double sunAltitude, sunAzimuth, moonAltitude, moonAzimuth;
+    equatorialToHorizontal(sunRightAscension, sunDeclination, siderealTime, latitude, sunAltitude, sunAzimuth);
+    equatorialToHorizontal(moonRightAscension, moonDeclination, siderealTime, latitude, moonAltitude, moonAzimuth);
+    // Seen from the surface rather than the Earth's center, the moon sits lower
+    moonAltitude -= parallax * std::cos(moonAltitude * kRadians);
+
+    double elongation = wrapDegrees(moonLongitude - sunLongitude);
+
+    EphemerisSample sample;
+    sample.sunAltitude = static_cast<float>(sunAltitude);
+    sample.sunAzimuth = static_cast<float>(sunAzimuth);
+    sample.moonAltitude = static_cast<float>(moonAltitude);
+    sample.moonAzimuth = static_cast<float>(moonAzimuth);
+    sample.moonPhase = static_cast<float>(elongation / 360.0);
+    sample.moonIllumination = static_cast<float>(0.5 * (1.0 - std::cos(elongation * kRadians)));
+    return sample;
+}
@@ -1,51 +1,294 @@
 #include "FogSystem.h"
 #include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Grid resolution, independent of the window
+static const int kColumns = 160;
+static const int kRows = 96;
+
+// Below this many rows per thread the step stays on the calling thread
+static const size_t kParallelRows = 16;
+
+// Longest step taken at once (seconds), so a hitch does not smear the field
+static const float kMaxStep = 0.1f;
+
+// Fog drifts with the local wind like the precipitation does (pixels per
+// second per unit of wind)
+static const float kWindDrift = 3.0f;
+
+// Diffusion in cells^2 per second, capped per step for stability
+static const float kDiffusion = 2.0f;
+static const float kMaxDiffusionStep = 0.2f;
+
+// Fog thins out on its own at this rate (per second); seeding balances it
+// at the target density near the ground
+static const float kDecay = 0.2f;
+
+// Height (fraction of the window) over which the seeding falls off by 1/e
+static const float kSeedHeight = 0.3f;
+
+// Drift of the seeding pattern along the ground (radians per second)
+static const float kSeedDrift = 0.05f;
+
+static const glm::vec3 kFogColor(0.8f, 0.8f, 0.85f);
+static const float kOpacity = 0.55f;
+
+static const char* vertexSource = R"(
+#version 330 core
+out vec2 uv;
+
+void main() {
+    vec2 corner = vec2(float((gl_VertexID << 1) & 2), float(gl_VertexID & 2));
+    uv = corner;
+    gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+}
+)";
+
+static const char* fragmentSource = R"(
+#version 330 core
+in vec2 uv;
+out vec4 FragColor;
+
+uniform sampler2D density;
+uniform sampler2D lightBuffer;
+uniform vec3 color;
+uniform float opacity;
+
+void main() {
+    float fog = clamp(texture(density, uv).r, 0.0, 1.0);
+    FragColor = vec4(color + texture(lightBuffer, uv).rgb, fog * opacity);
+}
+)";
+
+// Bilinear sample of the grid at a position already clamped to it
+static inline float sampleGrid(const float* grid, float x, float y) {
+    int x0 = std::min(static_cast<int>(x), kColumns - 2);
+    int y0 = std::min(static_cast<int>(y), kRows - 2);
+    float fx = x - x0;
+    float fy = y - y0;
+    const float* a = grid + static_cast<size_t>(y0) * kColumns + x0;
+    const float* b = a + kColumns;
+    float left = a[0] + (b[0] - a[0]) * fy;
+    float right = a[1] + (b[1] - a[1]) * fy;
+    return left + (right - left) * fx;
+}
+
+// One cell of the diffusion, decay and seeding step
+static inline float diffuseCell(float center, float neighbours, float k, float keep, float seed) {
+    float value = (center + k * (neighbours - 4.0f * center)) * keep + seed;
+    return std::min(std::max(value, 0.0f), 1.0f);
+}
 
 FogSystem::FogSystem()
-    : enabled(true), density(0.0f), targetDensity(0.0f), transitionSpeed(0.2f) {
+    : enabled(true), density(0.0f), seedPhase(0.0f), workers(nullptr), stepWeather(nullptr), cellSize(0.0f),
+      windCells(0.0f),
+      cells(static_cast<size_t>(kColumns) * kRows, 0.0f), advected(cells.size(), 0.0f), rowSeed(kRows, 0.0f),
+      columnSeed(kColumns, 0.0f), rowDensity(kRows, 0.0f), texture(0), program(0), vao(0), uColor(-1),
+      uOpacity(-1) {
 }
 
-void FogSystem::update(float deltaTime, const WeatherSystem& weather) {
-    if (!enabled) return;
-    
-    // Calculate target fog density
-    targetDensity = calculateTargetDensity(weather);
-    
-    // Smoothly transition to target density
-    if (density < targetDensity) {
-        density += deltaTime * transitionSpeed;
-        if (density > targetDensity) density = targetDensity;
-    } else if (density > targetDensity) {
-        density -= deltaTime * transitionSpeed;
-        if (density < targetDensity) density = targetDensity;
+FogSystem::~FogSystem() {
+    shutdown();
+}
+
+void FogSystem::init() {
+    program = Renderer::createShaderProgram(vertexSource, fragmentSource);
+    uColor = glGetUniformLocation(program, "color");
+    uOpacity = glGetUniformLocation(program, "opacity");
+    Renderer::useLightBuffer(program);
+
+    glGenVertexArrays(1, &vao);
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R16F, kColumns, kRows, 0, GL_RED, GL_FLOAT, cells.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void FogSystem::shutdown() {
+    if (vao) glDeleteVertexArrays(1, &vao);
+    if (texture) glDeleteTextures(1, &texture);
+    if (program) glDeleteProgram(program);
+    vao = 0;
+    texture = 0;
+    program = 0;
+}
+
+void FogSystem::update(float deltaTime, const WeatherSystem& weather, int screenWidth, int screenHeight) {
+    if (!enabled || !texture || screenWidth <= 0 || screenHeight <= 0) return;
+    float step = std::min(deltaTime, kMaxStep);
+
+    // Seeding: strongest at the ground, in slowly drifting patches
+    float target = calculateTargetDensity(weather);
+    for (int row = 0; row < kRows; row++) {
+        float height = (row + 0.5f) / kRows;
+        rowSeed[row] = kDecay * target * std::exp(-height / kSeedHeight);
+    }
+    seedPhase += kSeedDrift * step;
+    for (int column = 0; column < kColumns; column++) {
+        float u = (column + 0.5f) / kColumns;
+        columnSeed[column] = 0.65f + 0.35f * std::sin(u * 9.0f + seedPhase) * std::sin(u * 23.0f - seedPhase * 1.7f);
+    }
+
+    // Cells moved per unit of wind in this step; rows count up from the
+    // ground, screen y down
+    stepWeather = &weather;
+    cellSize = glm::vec2(static_cast<float>(screenWidth) / kColumns, static_cast<float>(screenHeight) / kRows);
+    windCells = glm::vec2(kWindDrift * step / cellSize.x, -kWindDrift * step / cellSize.y);
+
+    // Capture only this: larger captures would make std::function allocate
+    auto advect = [this](size_t begin, size_t end) { advectRows(begin, end); };
+    auto diffuse = [this, step](size_t begin, size_t end) { diffuseRows(begin, end, step); };
+    if (workers) {
+        workers->parallelFor(kRows, advect, kParallelRows);
+        workers->parallelFor(kRows, diffuse, kParallelRows);
+    } else {
+        advect(0, kRows);
+        diffuse(0, kRows);
+    }
+
+    float sum = 0.0f;
+    for (int row = 0; row < kRows / 2; row++) {
+        sum += rowDensity[row];
     }
+    density = sum / (kColumns * (kRows / 2));
+
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, kColumns, kRows, GL_RED, GL_FLOAT, cells.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
 }
 
-void FogSystem::render(Renderer& renderer, int screenWidth, int screenHeight) {
-    if (!enabled || density < 0.01f) return;
-    
-    // Render fog as gradient layers from bottom to top
-    int numLayers = 5;
-    float layerHeight = screenHeight / static_cast<float>(numLayers);
-    
-    for (int i = 0; i < numLayers; i++) {
-        float y = screenHeight - (i + 1) * layerHeight;
-        
-        // Fog is denser at bottom, lighter at top
-        float layerDensity = density * (1.0f - static_cast<float>(i) / numLayers);
-        
-        // Fog color: light gray/white
-        glm::vec4 fogColor(0.8f, 0.8f, 0.85f, layerDensity * 0.4f);
-        
-        // Draw horizontal fog band
-        renderer.drawRectangle(
-            glm::vec2(0.0f, y), 
-            glm::vec2(static_cast<float>(screenWidth), layerHeight), 
-            fogColor
-        );
+void FogSystem::advectRows(size_t begin, size_t end) {
+    const WeatherSystem& weather = *stepWeather;
+    float maxX = static_cast<float>(kColumns - 1);
+    float maxY = static_cast<float>(kRows - 1);
+    float screenHeight = cellSize.y * kRows;
+
+    for (size_t r = begin; r < end; r++) {
+        int row = static_cast<int>(r);
+        float* out = &advected[static_cast<size_t>(row) * kColumns];
+
+        // Wind at each cell's centre, from the weather's wind field
+        float windX[kColumns];
+        float windY[kColumns];
+        float y = screenHeight - (row + 0.5f) * cellSize.y;
+        for (int x = 0; x < kColumns; x++) {
+            glm::vec2 wind = weather.getWindAt(glm::vec2((x + 0.5f) * cellSize.x, y));
+            windX[x] = wind.x;
+            windY[x] = wind.y;
+        }
+
+        // Every cell looks back along its wind and interpolates there;
+        // the back-traced positions are found four at a time
+        int x = 0;
+#if defined(__SSE2__)
+        __m128 stepX = _mm_set1_ps(windCells.x);
+        __m128 stepY = _mm_set1_ps(windCells.y);
+        __m128 limitX = _mm_set1_ps(maxX);
+        __m128 limitY = _mm_set1_ps(maxY);
+        __m128 zero = _mm_setzero_ps();
+        __m128 rowY = _mm_set1_ps(static_cast<float>(row));
+        for (; x + 4 <= kColumns; x += 4) {
+            __m128 px = _mm_set_ps(x + 3.0f, x + 2.0f, x + 1.0f, static_cast<float>(x));
+            px = _mm_sub_ps(px, _mm_mul_ps(_mm_loadu_ps(windX + x), stepX));
+            __m128 py = _mm_sub_ps(rowY, _mm_mul_ps(_mm_loadu_ps(windY + x), stepY));
+            float backX[4], backY[4];
+            _mm_storeu_ps(backX, _mm_min_ps(_mm_max_ps(px, zero), limitX));
+            _mm_storeu_ps(backY, _mm_min_ps(_mm_max_ps(py, zero), limitY));
+            for (int lane = 0; lane < 4; lane++) {
+                out[x + lane] = sampleGrid(cells.data(), backX[lane], backY[lane]);
+            }
+        }
+#endif
+        for (; x < kColumns; x++) {
+            float backX = std::min(std::max(x - windX[x] * windCells.x, 0.0f), maxX);
+            float backY = std::min(std::max(row - windY[x] * windCells.y, 0.0f), maxY);
+            out[x] = sampleGrid(cells.data(), backX, backY);
+        }
     }
 }
 
+void FogSystem::diffuseRows(size_t begin, size_t end, float deltaTime) {
+    float k = std::min(kDiffusion * deltaTime, kMaxDiffusionStep);
+    float keep = 1.0f - kDecay * deltaTime;
+
+    for (size_t r = begin; r < end; r++) {
+        int row = static_cast<int>(r);
+        // No flux through the grid's edges
+        const float* center = &advected[static_cast<size_t>(row) * kColumns];
+        const float* below = row > 0 ? center - kColumns : center;
+        const float* above = row + 1 < kRows ? center + kColumns : center;
+        float* out = &cells[static_cast<size_t>(row) * kColumns];
+        float seed = rowSeed[row] * deltaTime;
+        float sum = 0.0f;
+
+        out[0] = diffuseCell(center[0], above[0] + below[0] + center[0] + center[1], k, keep,
+                             seed * columnSeed[0]);
+        sum += out[0];
+
+        int x = 1;
+#if defined(__SSE2__)
+        __m128 vk = _mm_set1_ps(k);
+        __m128 vkeep = _mm_set1_ps(keep);
+        __m128 vseed = _mm_set1_ps(seed);
+        __m128 four = _mm_set1_ps(4.0f);
+        __m128 zero = _mm_setzero_ps();
+        __m128 one = _mm_set1_ps(1.0f);
+        __m128 vsum = _mm_setzero_ps();
+        for (; x + 4 <= kColumns - 1; x += 4) {
+            __m128 c = _mm_loadu_ps(center + x);
+            __m128 neighbours = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(above + x), _mm_loadu_ps(below + x)),
+                                           _mm_add_ps(_mm_loadu_ps(center + x - 1), _mm_loadu_ps(center + x + 1)));
+            __m128 value = _mm_add_ps(c, _mm_mul_ps(vk, _mm_sub_ps(neighbours, _mm_mul_ps(four, c))));
+            value = _mm_add_ps(_mm_mul_ps(value, vkeep), _mm_mul_ps(vseed, _mm_loadu_ps(&columnSeed[x])));
+            value = _mm_min_ps(_mm_max_ps(value, zero), one);
+            _mm_storeu_ps(out + x, value);
+            vsum = _mm_add_ps(vsum, value);
+        }
+        float lanes[4];
+        _mm_storeu_ps(lanes, vsum);
+        sum += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+        for (; x < kColumns - 1; x++) {
+            out[x] = diffuseCell(center[x], above[x] + below[x] + center[x - 1] + center[x + 1], k, keep,
+                                 seed * columnSeed[x]);
+            sum += out[x];
+        }
+
+        int lastColumn = kColumns - 1;
+        out[lastColumn] = diffuseCell(center[lastColumn],
+                                      above[lastColumn] + below[lastColumn] + center[lastColumn - 1] +
+                                          center[lastColumn],
+                                      k, keep, seed * columnSeed[lastColumn]);
+        sum += out[lastColumn];
+        rowDensity[row] = sum;
+    }
+}
+
+void FogSystem::render(Renderer& renderer) {
+    if (!enabled || !texture || density < 0.001f) return;
+
+    // Batched geometry underneath has to be on screen before the fog
+    renderer.flush();
+
+    glUseProgram(program);
+    glUniform3f(uColor, kFogColor.r, kFogColor.g, kFogColor.b);
+    glUniform1f(uOpacity, kOpacity);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glBindVertexArray(vao);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
 float FogSystem::calculateTargetDensity(const WeatherSystem& weather) const {
     float baseDensity = 0.0f;
     
@@ -74,7 +317,7 @@ float FogSystem::calculateTargetDensity(const WeatherSystem& weather) const {
     }
     
     // Time of day - more fog at dawn/dusk
-    float timeOfDay = weather.getTimeOfDay();
+    float timeOfDay = weather.getDayPhase();
     if ((timeOfDay > 0.2f && timeOfDay < 0.35f) || (timeOfDay > 0.65f && timeOfDay < 0.8f)) {
         baseDensity += 0.2f;
     }
@@ -0,0 +1,406 @@
+#include "GpuParticleBackend.h"
+#include "Renderer.h"
+#include <algorithm>
+#include <iostream>
+#include <limits>
+
+// Ring slots per expiry block, and how long a slot can stay alive after it
+// was emitted into: the longest lifetime in the update shader (snow), plus
+// a second so the older of the two buffers has died too
+static const int kBlockSize = 4096;
+static const float kBlockExpiry = 10.0f + 1.0f;
+
+// Update pass: one vertex per particle, results captured by transform feedback.
+// Spawn distributions match ParticleSystem::spawnParticle on the CPU path.
+static const char* updateVertexSource = R"(
+#version 330 core
+layout (location = 0) in vec2 inPosition;
+layout (location = 1) in vec2 inVelocity;
+layout (location = 2) in vec2 inLife;
+layout (location = 3) in vec2 inAttributes;
+
+out vec2 outPosition;
+out vec2 outVelocity;
+out vec2 outLife;
+out vec2 outAttributes;
+
+uniform float deltaTime;
+uniform uint seed;
+uniform int emitStart;
+uniform int emitCount;
+uniform int capacity;
+uniform int streakCount;  // The first streakCount emitted are rain, the rest snow
+uniform vec2 wind;
+uniform float screenWidth;
+uniform float groundY;
+uniform sampler1D spawnTable;
+uniform int spawnTableSize;  // 0 = no table, spawn uniformly
+
+// PCG hash -> [0, 1)
+float random(inout uint state) {
+    state = state * 747796405u + 2891336453u;
+    uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    word = (word >> 22u) ^ word;
+    return float(word) / 4294967296.0;
+}
+
+void main() {
+    uint state = uint(gl_VertexID) * 1664525u + seed * 1013904223u;
+
+    int ringOffset = gl_VertexID - emitStart;
+    if (ringOffset < 0) ringOffset += capacity;
+
+    vec2 position = inPosition;
+    vec2 velocity = inVelocity;
+    vec2 life = inLife;
+    vec2 attributes = inAttributes;
+
+    if (ringOffset < emitCount) {
+        // Spawn at the top of the screen
+        float kind = ringOffset < streakCount ? 0.0 : 1.0;
+        if (spawnTableSize > 0) {
+            // Sample the inverse CDF, mapping [0, 1] onto the texel centres
+            float u = random(state) * float(spawnTableSize - 1) + 0.5;
+            position.x = texture(spawnTable, u / float(spawnTableSize)).r;
+        } else {
+            position.x = random(state) * screenWidth;
+        }
+        position.y = -20.0 - random(state) * 50.0;
+        if (kind < 0.5) {
+            velocity.x = wind.x * 3.0 + random(state) * 20.0 - 10.0;
+            velocity.y = 300.0 + random(state) * 200.0;
+            attributes.x = 1.5 + random(state) * 0.9;
+            life = vec2(5.0);
+        } else {
+            velocity.x = wind.x * 5.0 + random(state) * 40.0 - 20.0;
+            velocity.y = 30.0 + random(state) * 50.0;
+            attributes.x = 2.0 + random(state) * 1.9;
+            life = vec2(10.0);
+        }
+        attributes.y = kind;
+    } else if (life.x > 0.0) {
+        position += velocity * deltaTime;
+
+        // Snow sways
+        if (attributes.y > 0.5) {
+            velocity.x += (random(state) * 20.0 - 10.0) * deltaTime;
+        }
+
+        life.x -= deltaTime;
+        if (position.y > groundY) {
+            life.x = 0.0;
+        }
+    }
+
+    outPosition = position;
+    outVelocity = velocity;
+    outLife = life;
+    outAttributes = attributes;
+}
+)";
+
+// Render pass: one instanced quad per particle, read straight from the
+// simulation buffer. Rain is a streak along the velocity, snow a disc.
+static const char* renderVertexSource = R"(
+#version 330 core
+layout (location = 0) in vec2 iPosition;
+layout (location = 1) in vec2 iVelocity;
+layout (location = 2) in vec2 iLife;
+layout (location = 3) in vec2 iAttributes;
+
+out vec4 vertexColor;
+out vec2 localPosition;
+out vec2 lightCoord;
+flat out float particleKind;
+
+uniform mat4 projection;
+
+void main() {
+    if (iLife.x <= 0.0) {
+        gl_Position = vec4(2.0, 2.0, 2.0, 1.0);  // Dead: clipped away
+        return;
+    }
+
+    vec2 corner = vec2(float(gl_VertexID & 1), float(gl_VertexID >> 1));
+    float alpha = clamp(iLife.x / iLife.y, 0.0, 1.0) * 0.8;
+    vec2 position;
+
+    if (iAttributes.y < 0.5) {
+        vec2 streak = iVelocity * 0.02;
+        float len = length(streak);
+        vec2 dir = len > 0.001 ? streak / len : vec2(0.0, 1.0);
+        vec2 perpendicular = vec2(-dir.y, dir.x);
+        position = iPosition + streak * corner.y + perpendicular * (corner.x - 0.5) * iAttributes.x;
+        vertexColor = vec4(0.6, 0.6, 0.8, alpha);
+        localPosition = vec2(0.0);
+    } else {
+        localPosition = corner * 2.0 - 1.0;
+        position = iPosition + localPosition * iAttributes.x;
+        vertexColor = vec4(1.0, 1.0, 1.0, alpha);
+    }
+
+    particleKind = iAttributes.y;
+    gl_Position = projection * vec4(position, 0.0, 1.0);
+    lightCoord = gl_Position.xy * 0.5 + 0.5;
+}
+)";
+
+static const char* renderFragmentSource = R"(
+#version 330 core
+in vec4 vertexColor;
+in vec2 localPosition;
+in vec2 lightCoord;
+flat in float particleKind;
+out vec4 FragColor;
+
+uniform sampler2D lightBuffer;
+
+void main() {
+    if (particleKind > 0.5 && dot(localPosition, localPosition) > 1.0) {
+        discard;
+    }
+    FragColor = vec4(vertexColor.rgb + texture(lightBuffer, lightCoord).rgb, vertexColor.a);
+}
+)";
+
+GpuParticleBackend::GpuParticleBackend()
+    : initialized(false), capacity(0), emitHead(0), activeExtent(0), filled(0), elapsed(0.0f), frameSeed(0), current(0),
+      buffers{0, 0}, updateVAO{0, 0}, renderVAO{0, 0}, spawnTexture(0), spawnTableSize(0),
+      updateProgram(0), renderProgram(0),
+      uDeltaTime(-1), uSeed(-1), uEmitStart(-1), uEmitCount(-1), uCapacity(-1), uStreakCount(-1),
+      uWind(-1), uScreenWidth(-1), uGroundY(-1), uSpawnTable(-1), uSpawnTableSize(-1),
+      uProjection(-1) {
+}
+
+GpuParticleBackend::~GpuParticleBackend() {
+    shutdown();
+}
+
+bool GpuParticleBackend::init(int capacity) {
+    if (initialized) return true;
+    this->capacity = capacity;
+
+    updateProgram = createUpdateProgram();
+    renderProgram = Renderer::createShaderProgram(renderVertexSource, renderFragmentSource);
+
+    GLint linked = 0;
+    glGetProgramiv(updateProgram, GL_LINK_STATUS, &linked);
+    GLint renderLinked = 0;
+    glGetProgramiv(renderProgram, GL_LINK_STATUS, &renderLinked);
+    if (!linked || !renderLinked) {
+        std::cerr << "GPU particle backend unavailable, using CPU particles" << std::endl;
+        shutdown();
+        return false;
+    }
+
+    uDeltaTime = glGetUniformLocation(updateProgram, "deltaTime");
+    uSeed = glGetUniformLocation(updateProgram, "seed");
+    uEmitStart = glGetUniformLocation(updateProgram, "emitStart");
+    uEmitCount = glGetUniformLocation(updateProgram, "emitCount");
+    uCapacity = glGetUniformLocation(updateProgram, "capacity");
+    uStreakCount = glGetUniformLocation(updateProgram, "streakCount");
+    uWind = glGetUniformLocation(updateProgram, "wind");
+    uScreenWidth = glGetUniformLocation(updateProgram, "screenWidth");
+    uGroundY = glGetUniformLocation(updateProgram, "groundY");
+    uSpawnTable = glGetUniformLocation(updateProgram, "spawnTable");
+    uSpawnTableSize = glGetUniformLocation(updateProgram, "spawnTableSize");
+    uProjection = glGetUniformLocation(renderProgram, "projection");
+    Renderer::useLightBuffer(renderProgram);
+
+    // Buffers start uninitialised: slots are only read once emitted into
+    blockWritten.assign((capacity + kBlockSize - 1) / kBlockSize, std::numeric_limits<float>::lowest());
+    emitHead = 0;
+    activeExtent = 0;
+    filled = 0;
+
+    glGenBuffers(2, buffers);
+    glGenVertexArrays(2, updateVAO);
+    glGenVertexArrays(2, renderVAO);
+    for (int i = 0; i < 2; i++) {
+        glBindBuffer(GL_ARRAY_BUFFER, buffers[i]);
+        glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(GpuParticle), nullptr, GL_DYNAMIC_COPY);
+        setupVertexArray(updateVAO[i], buffers[i], false);
+        setupVertexArray(renderVAO[i], buffers[i], true);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glGenTextures(1, &spawnTexture);
+    glBindTexture(GL_TEXTURE_1D, spawnTexture);
+    glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_1D, 0);
+    spawnTableSize = 0;
+
+    initialized = true;
+    std::cout << "GPU particle backend initialized (" << capacity << " particles)" << std::endl;
+    return true;
+}
+
+void GpuParticleBackend::shutdown() {
+    if (updateVAO[0]) glDeleteVertexArrays(2, updateVAO);
+    if (renderVAO[0]) glDeleteVertexArrays(2, renderVAO);
+    if (buffers[0]) glDeleteBuffers(2, buffers);
+    if (spawnTexture) glDeleteTextures(1, &spawnTexture);
+    if (updateProgram) glDeleteProgram(updateProgram);
+    if (renderProgram) glDeleteProgram(renderProgram);
+    updateVAO[0] = updateVAO[1] = 0;
+    renderVAO[0] = renderVAO[1] = 0;
+    buffers[0] = buffers[1] = 0;
+    spawnTexture = 0;
+    updateProgram = renderProgram = 0;
+    initialized = false;
+}
+
+void GpuParticleBackend::update(float deltaTime, int streakCount, int discCount, glm::vec2 wind, int screenWidth, float groundY) {
+    if (!initialized) return;
+    int emitCount = std::min(streakCount + discCount, capacity);
+
+    elapsed += deltaTime;
+
+    // Go back to the start of the ring as soon as its first blocks have
+    // expired, so a light emit rate keeps the live range near slot 0
+    // instead of marching it through the whole buffer
+    if (emitHead > 0 && emitCount > 0) {
+        int lastBlock = (emitCount - 1) / kBlockSize;
+        bool expired = true;
+        for (int block = 0; block <= lastBlock && expired; block++) {
+            expired = elapsed - blockWritten[block] >= kBlockExpiry;
+        }
+        if (expired) emitHead = 0;
+    }
+
+    // Mark the slots written this frame (two runs if the ring wraps)
+    int emitStart = emitHead;
+    if (emitCount > 0) {
+        int end = emitStart + emitCount;
+        markWritten(emitStart, std::min(end, capacity));
+        if (end > capacity) markWritten(0, end - capacity);
+        filled = std::max(filled, std::min(end, capacity));
+    }
+    emitHead = (emitHead + emitCount) % capacity;
+
+    // Process up to the last block with a recent emit. Once every block has
+    // expired the ring is empty and starts over at slot 0.
+    activeExtent = 0;
+    for (int block = static_cast<int>(blockWritten.size()) - 1; block >= 0; block--) {
+        if (elapsed - blockWritten[block] < kBlockExpiry) {
+            activeExtent = std::min((block + 1) * kBlockSize, filled);
+            break;
+        }
+    }
+    if (activeExtent == 0) {
+        emitHead = 0;
+        return;
+    }
+
+    int next = 1 - current;
+
+    glUseProgram(updateProgram);
+    glUniform1f(uDeltaTime, deltaTime);
+    glUniform1ui(uSeed, frameSeed++);
+    glUniform1i(uEmitStart, emitStart);
+    glUniform1i(uEmitCount, emitCount);
+    glUniform1i(uCapacity, capacity);
+    glUniform1i(uStreakCount, streakCount);
+    glUniform2f(uWind, wind.x, wind.y);
+    glUniform1f(uScreenWidth, static_cast<float>(screenWidth));
+    glUniform1f(uGroundY, groundY);
+    glUniform1i(uSpawnTableSize, spawnTableSize);
+    glUniform1i(uSpawnTable, 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_1D, spawnTexture);
+
+    glEnable(GL_RASTERIZER_DISCARD);
+    glBindVertexArray(updateVAO[current]);
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, buffers[next]);
+
+    glBeginTransformFeedback(GL_POINTS);
+    glDrawArrays(GL_POINTS, 0, activeExtent);
+    glEndTransformFeedback();
+
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+    glBindTexture(GL_TEXTURE_1D, 0);
+    glBindVertexArray(0);
+    glDisable(GL_RASTERIZER_DISCARD);
+
+    current = next;
+}
+
+void GpuParticleBackend::setSpawnTable(const float* table, int size) {
+    if (!initialized) return;
+
+    glBindTexture(GL_TEXTURE_1D, spawnTexture);
+    if (size == spawnTableSize) {
+        glTexSubImage1D(GL_TEXTURE_1D, 0, 0, size, GL_RED, GL_FLOAT, table);
+    } else {
+        glTexImage1D(GL_TEXTURE_1D, 0, GL_R32F, size, 0, GL_RED, GL_FLOAT, table);
+        spawnTableSize = size;
+    }
+    glBindTexture(GL_TEXTURE_1D, 0);
+}
+
+void GpuParticleBackend::render(const glm::mat4& projection) {
+    if (!initialized || activeExtent == 0) return;
+
+    glUseProgram(renderProgram);
+    glUniformMatrix4fv(uProjection, 1, GL_FALSE, &projection[0][0]);
+
+    glBindVertexArray(renderVAO[current]);
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, activeExtent);
+    glBindVertexArray(0);
+}
+
+void GpuParticleBackend::clear() {
+    if (!initialized) return;
+
+    // Old particles stay in the buffers but are never read again: slots
+    // are processed only after being emitted into
+    std::fill(blockWritten.begin(), blockWritten.end(), std::numeric_limits<float>::lowest());
+    emitHead = 0;
+    activeExtent = 0;
+    filled = 0;
+}
+
+void GpuParticleBackend::markWritten(int begin, int end) {
+    for (int block = begin / kBlockSize; block <= (end - 1) / kBlockSize; block++) {
+        blockWritten[block] = elapsed;
+    }
+}
+
+GLuint GpuParticleBackend::createUpdateProgram() {
+    GLuint vertexShader = Renderer::compileShader(GL_VERTEX_SHADER, updateVertexSource);
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vertexShader);
+
+    // Captured outputs must be declared before linking
+    const char* varyings[] = { "outPosition", "outVelocity", "outLife", "outAttributes" };
+    glTransformFeedbackVaryings(program, 4, varyings, GL_INTERLEAVED_ATTRIBS);
+    glLinkProgram(program);
+
+    GLint success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        char infoLog[512];
+        glGetProgramInfoLog(program, 512, nullptr, infoLog);
+        std::cerr << "Particle update shader linking error: " << infoLog << std::endl;
+    }
+
+    glDeleteShader(vertexShader);
+    return program;
+}
+
+void GpuParticleBackend::setupVertexArray(GLuint vao, GLuint buffer, bool instanced) {
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+
+    for (GLuint attribute = 0; attribute < 4; attribute++) {
+        glVertexAttribPointer(attribute, 2, GL_FLOAT, GL_FALSE, sizeof(GpuParticle),
+                              (void*)(attribute * sizeof(glm::vec2)));
+        glEnableVertexAttribArray(attribute);
+        glVertexAttribDivisor(attribute, instanced ? 1 : 0);
+    }
+
+    glBindVertexArray(0);
+}
@@ -0,0 +1,44 @@
+#include "GpuTimer.h"
+
+GpuTimer::GpuTimer() : queries{}, pending{}, next(0), milliseconds(0.0f) {
+}
+
+GpuTimer::~GpuTimer() {
+    shutdown();
+}
+
+void GpuTimer::init() {
+    glGenQueries(kQueryCount, queries);
+}
+
+void GpuTimer::shutdown() {
+    if (queries[0]) glDeleteQueries(kQueryCount, queries);
+    for (int i = 0; i < kQueryCount; i++) {
+        queries[i] = 0;
+        pending[i] = false;
+    }
+}
+
+void GpuTimer::begin() {
+    if (!queries[0]) return;
+
+    // Collect the oldest query before reusing it. It was issued
+    // kQueryCount frames ago, so reading it normally does not wait.
+    if (pending[next]) {
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(queries[next], GL_QUERY_RESULT, &elapsed);
+        float sample = static_cast<float>(elapsed) / 1.0e6f;
+        milliseconds += (sample - milliseconds) * 0.1f;
+        pending[next] = false;
+    }
+
+    glBeginQuery(GL_TIME_ELAPSED, queries[next]);
+}
+
+void GpuTimer::end() {
+    if (!queries[0]) return;
+
+    glEndQuery(GL_TIME_ELAPSED);
+    pending[next] = true;
+    next = (next + 1) % kQueryCount;
+}
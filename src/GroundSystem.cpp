@@ -0,0 +1,285 @@
+#include "GroundSystem.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Sub-histograms used when binning impacts (one per SIMD lane)
+static const size_t kHistogramLanes = 4;
+
+// Depth added by one impact at weight 1, in pixels
+static const float kSnowPerImpact = 0.15f;
+static const float kWaterPerImpact = 0.02f;
+
+// Accumulation limits, in pixels
+static const float kMaxSnowDepth = 40.0f;
+static const float kMaxWaterDepth = 6.0f;
+
+// Snow melt per degree above freezing, and water evaporation (pixels per second)
+static const float kMeltPerDegree = 0.05f;
+static const float kBaseEvaporation = 0.01f;
+static const float kEvaporationPerDegree = 0.002f;
+
+// Water left by a pixel of melted snow
+static const float kMeltWaterRatio = 0.3f;
+
+// Snow slides off when a column stands this much above its neighbour
+static const float kSnowReposeHeight = 4.0f;
+
+// Fraction of a level difference that flows per second
+static const float kSnowSlideRate = 2.0f;
+static const float kWaterFlowRate = 8.0f;
+
+// Below this a column counts as bare
+static const float kMinDepth = 0.01f;
+
+GroundSystem::GroundSystem(float columnWidth)
+    : columnWidth(columnWidth), shadows(nullptr), terrainTopY(0.0f), topY(0.0f), screenWidth(0), screenHeight(0) {
+}
+
+void GroundSystem::update(float deltaTime, const WeatherSystem& weather, int screenWidth, int screenHeight) {
+    if (screenWidth != this->screenWidth || screenHeight != this->screenHeight) {
+        this->screenWidth = screenWidth;
+        this->screenHeight = screenHeight;
+        generateHeightfield();
+    }
+    
+    if (activeColumns.empty()) return;
+    
+    float temperature = weather.getSurfaceTemperature();
+    float meltRate = std::max(temperature, 0.0f) * kMeltPerDegree;
+    float evaporationRate = kBaseEvaporation + std::max(temperature, 0.0f) * kEvaporationPerDegree;
+    
+    // Neighbours activated while levelling are appended and picked up in the
+    // same pass
+    for (size_t i = 0; i < activeColumns.size(); i++) {
+        updateColumn(activeColumns[i], deltaTime, meltRate, evaporationRate);
+    }
+    
+    // Drop columns that are bare again, and refresh the surface of the rest
+    topY = terrainTopY;
+    size_t kept = 0;
+    for (uint32_t column : activeColumns) {
+        if (snowDepth[column] < kMinDepth && waterDepth[column] < kMinDepth) {
+            snowDepth[column] = 0.0f;
+            waterDepth[column] = 0.0f;
+            surfaceY[column] = terrainY[column];
+            isActive[column] = 0;
+            continue;
+        }
+        surfaceY[column] = terrainY[column] - snowDepth[column];
+        topY = std::min(topY, surfaceY[column]);
+        activeColumns[kept++] = column;
+    }
+    activeColumns.resize(kept);
+}
+
+void GroundSystem::updateColumn(uint32_t column, float deltaTime, float meltRate, float evaporationRate) {
+    float& snow = snowDepth[column];
+    float& water = waterDepth[column];
+    
+    // Melt snow into water, and evaporate water
+    float melted = std::min(snow, meltRate * deltaTime);
+    snow -= melted;
+    water = std::min(water + melted * kMeltWaterRatio, kMaxWaterDepth);
+    water = std::max(water - evaporationRate * deltaTime, 0.0f);
+    
+    // Level out against both neighbours: snow slides off steep steps, water
+    // runs toward lower water surfaces and collects in the dips
+    uint32_t last = static_cast<uint32_t>(terrainY.size() - 1);
+    for (int side = -1; side <= 1; side += 2) {
+        if ((side < 0 && column == 0) || (side > 0 && column == last)) continue;
+        uint32_t neighbour = column + side;
+        
+        if (snow > 0.0f) {
+            float step = (terrainY[neighbour] - snowDepth[neighbour]) - (terrainY[column] - snow);
+            if (step > kSnowReposeHeight) {
+                float moved = std::min(snow, (step - kSnowReposeHeight) * 0.5f * std::min(kSnowSlideRate * deltaTime, 1.0f));
+                snow -= moved;
+                snowDepth[neighbour] += moved;
+                activateColumn(neighbour);
+            }
+        }
+        
+        if (water > 0.0f) {
+            float level = terrainY[column] - snowDepth[column] - water;
+            float neighbourLevel = terrainY[neighbour] - snowDepth[neighbour] - waterDepth[neighbour];
+            float drop = neighbourLevel - level;
+            if (drop > 0.0f) {
+                float moved = std::min(water, drop * 0.5f * std::min(kWaterFlowRate * deltaTime, 1.0f));
+                water -= moved;
+                waterDepth[neighbour] = std::min(waterDepth[neighbour] + moved, kMaxWaterDepth);
+                activateColumn(neighbour);
+            }
+        }
+    }
+}
+
+void GroundSystem::addImpacts(const std::vector<float>& impactX, GroundCover cover, float weight) {
+    size_t count = impactX.size();
+    if (count == 0 || terrainY.empty()) return;
+    
+    size_t columns = terrainY.size();
+    size_t stride = hits.size();  // Columns rounded up to a multiple of the lane count
+    std::fill(laneHits.begin(), laneHits.end(), 0.0f);
+    
+    const float* x = impactX.data();
+    float* lanes = laneHits.data();
+    float inverseWidth = 1.0f / columnWidth;
+    float lastColumn = static_cast<float>(columns - 1);
+    size_t i = 0;
+    
+#if defined(__SSE2__)
+    // Column indices for four impacts at a time (nearest sample, clamped),
+    // then one scatter-add per lane into that lane's own sub-histogram
+    const __m128 scale = _mm_set1_ps(inverseWidth);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 top = _mm_set1_ps(lastColumn);
+    alignas(16) int32_t index[4];
+    
+    for (; i + 4 <= count; i += 4) {
+        __m128 column = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(x + i), scale), half);
+        column = _mm_min_ps(_mm_max_ps(column, zero), top);
+        _mm_store_si128(reinterpret_cast<__m128i*>(index), _mm_cvttps_epi32(column));
+        
+        lanes[index[0]] += 1.0f;
+        lanes[stride + index[1]] += 1.0f;
+        lanes[2 * stride + index[2]] += 1.0f;
+        lanes[3 * stride + index[3]] += 1.0f;
+    }
+#endif
+    
+    for (; i < count; i++) {
+        float column = std::min(std::max(x[i] * inverseWidth + 0.5f, 0.0f), lastColumn);
+        lanes[(i % kHistogramLanes) * stride + static_cast<size_t>(column)] += 1.0f;
+    }
+    
+    // Merge the sub-histograms
+    size_t c = 0;
+#if defined(__SSE2__)
+    for (; c + 4 <= stride; c += 4) {
+        __m128 sum = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(lanes + c), _mm_loadu_ps(lanes + stride + c)),
+                                _mm_add_ps(_mm_loadu_ps(lanes + 2 * stride + c), _mm_loadu_ps(lanes + 3 * stride + c)));
+        _mm_storeu_ps(&hits[c], sum);
+    }
+#endif
+    for (; c < stride; c++) {
+        hits[c] = lanes[c] + lanes[stride + c] + lanes[2 * stride + c] + lanes[3 * stride + c];
+    }
+    
+    // Apply, touching only the columns that were hit
+    std::vector<float>& depth = (cover == GroundCover::SNOW) ? snowDepth : waterDepth;
+    float maxDepth = (cover == GroundCover::SNOW) ? kMaxSnowDepth : kMaxWaterDepth;
+    float perImpact = weight * ((cover == GroundCover::SNOW) ? kSnowPerImpact : kWaterPerImpact);
+    for (size_t column = 0; column < columns; column++) {
+        if (hits[column] == 0.0f) continue;
+        depth[column] = std::min(depth[column] + hits[column] * perImpact, maxDepth);
+        activateColumn(static_cast<uint32_t>(column));
+    }
+}
+
+void GroundSystem::activateColumn(uint32_t column) {
+    if (isActive[column]) return;
+    isActive[column] = 1;
+    activeColumns.push_back(column);
+}
+
+void GroundSystem::render(Renderer& renderer, const WeatherSystem& weather) {
+    glm::vec4 color = getGroundColor(weather);
+    
+    for (size_t i = 0; i < terrainY.size(); i++) {
+        float x = i * columnWidth;
+        float shade = shadows ? shadows->getLight(x + columnWidth * 0.5f) : 1.0f;
+        renderer.drawRectangle(
+            glm::vec2(x, terrainY[i]),
+            glm::vec2(columnWidth, screenHeight - terrainY[i]),
+            glm::vec4(glm::vec3(color) * shade, color.a)
+        );
+    }
+    
+    // Snow and puddles as a band on top of the terrain, lit like the ground
+    float light = color.g / 0.35f;
+    glm::vec4 snowColor(0.92f * light, 0.94f * light, 0.98f * light, 1.0f);
+    glm::vec4 waterColor(0.35f * light, 0.45f * light, 0.6f * light, 0.75f);
+    
+    for (uint32_t column : activeColumns) {
+        float x = column * columnWidth;
+        float snow = snowDepth[column];
+        float water = waterDepth[column];
+        float shade = shadows ? shadows->getLight(x + columnWidth * 0.5f) : 1.0f;
+        if (snow > 0.5f) {
+            glm::vec4 shaded(glm::vec3(snowColor) * shade, snowColor.a);
+            renderer.drawRectangle(glm::vec2(x, terrainY[column] - snow), glm::vec2(columnWidth, snow), shaded);
+        }
+        if (water > 0.3f) {
+            float top = terrainY[column] - snow - water;
+            glm::vec4 shaded(glm::vec3(waterColor) * shade, waterColor.a);
+            renderer.drawRectangle(glm::vec2(x, top), glm::vec2(columnWidth, water), shaded);
+        }
+    }
+}
+
+float GroundSystem::getSurfaceY(float x) const {
+    if (surfaceY.empty()) return static_cast<float>(screenHeight);
+    
+    float column = x / columnWidth;
+    if (column <= 0.0f) return surfaceY.front();
+    
+    size_t index = static_cast<size_t>(column);
+    if (index + 1 >= surfaceY.size()) return surfaceY.back();
+    
+    float t = column - index;
+    return surfaceY[index] + (surfaceY[index + 1] - surfaceY[index]) * t;
+}
+
+void GroundSystem::generateHeightfield() {
+    size_t columns = static_cast<size_t>(std::ceil(screenWidth / columnWidth)) + 1;
+    terrainY.resize(columns);
+    
+    // Gentle rolling hills around the mean ground line
+    float baseY = getBaseY();
+    for (size_t i = 0; i < columns; i++) {
+        float x = i * columnWidth;
+        float hills = 12.0f * std::sin(x * 0.004f) + 6.0f * std::sin(x * 0.013f + 1.3f);
+        terrainY[i] = baseY - hills;
+    }
+    
+    terrainTopY = *std::min_element(terrainY.begin(), terrainY.end());
+    topY = terrainTopY;
+    surfaceY = terrainY;
+    
+    // Accumulation does not carry over a resize
+    snowDepth.assign(columns, 0.0f);
+    waterDepth.assign(columns, 0.0f);
+    isActive.assign(columns, 0);
+    activeColumns.clear();
+    activeColumns.reserve(columns);
+    
+    size_t stride = (columns + kHistogramLanes - 1) / kHistogramLanes * kHistogramLanes;
+    hits.assign(stride, 0.0f);
+    laneHits.assign(stride * kHistogramLanes, 0.0f);
+}
+
+glm::vec4 GroundSystem::getGroundColor(const WeatherSystem& weather) const {
+    float timeOfDay = weather.getDayPhase();
+    
+    // Dark grass green
+    glm::vec4 color(0.2f, 0.35f, 0.15f, 1.0f);
+    
+    if (timeOfDay < 0.25f || timeOfDay > 0.75f) {
+        // Night time - much darker
+        color.r *= 0.3f;
+        color.g *= 0.3f;
+        color.b *= 0.4f;
+    } else if (timeOfDay < 0.35f || timeOfDay > 0.65f) {
+        // Dawn/dusk - dimmer, warmer
+        color.r *= 0.9f;
+        color.g *= 0.7f;
+        color.b *= 0.6f;
+    }
+    
+    return color;
+}
@@ -0,0 +1,230 @@
+#include "LightBuffer.h"
+#include "Renderer.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+// Buffer resolution: one texel per kDownsample x kDownsample pixels
+static const int kDownsample = 8;
+
+// Blur taps on each side of the centre, and their spread (in texels)
+static const int kBlurRadius = 16;
+static const float kBlurSigma = 7.0f;
+
+// Emitted light is scaled up before the blur spreads it thin
+static const float kEmissionGain = 10.0f;
+
+// Sun and moon: altitude at rise and set (degrees), as in CelestialSystem,
+// glow strength at full height, and glow radius as a fraction of the
+// screen height
+static const float kHorizonAltitude = -0.833f;
+static const float kSunLight = 0.25f;
+static const float kMoonLight = 0.1f;
+static const float kSourceRadius = 0.3f;
+
+static float smoothstep(float edge0, float edge1, float x) {
+    float t = std::min(std::max((x - edge0) / (edge1 - edge0), 0.0f), 1.0f);
+    return t * t * (3.0f - 2.0f * t);
+}
+
+static const char* fullscreenVertexSource = R"(
+#version 330 core
+out vec2 uv;
+
+void main() {
+    vec2 corner = vec2(float((gl_VertexID << 1) & 2), float(gl_VertexID & 2));
+    uv = corner;
+    gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+}
+)";
+
+// One direction of the Gaussian blur. The vertical pass also adds the
+// glow of the sun and moon (their colours are zero in the horizontal one).
+static const char* blurFragmentSource = R"(
+#version 330 core
+in vec2 uv;
+out vec4 FragColor;
+
+uniform sampler2D source;
+uniform vec2 direction;  // One texel along the blur
+uniform float gain;
+uniform float aspect;
+uniform vec2 sunPosition;
+uniform vec3 sunColor;
+uniform vec2 moonPosition;
+uniform vec3 moonColor;
+uniform int radius;
+uniform float sigma;
+uniform float sourceRadius;  // Fraction of the screen height
+
+void main() {
+    // Taps in pairs: one filtered fetch between two texels, placed so the
+    // interpolation weighs them as the kernel does
+    vec3 sum = vec3(0.0);
+    float total = 0.0;
+    for (int i = -radius; i <= radius; i += 2) {
+        float first = exp(-float(i * i) / (2.0 * sigma * sigma));
+        float second = i < radius ? exp(-float((i + 1) * (i + 1)) / (2.0 * sigma * sigma)) : 0.0;
+        float weight = first + second;
+        sum += texture(source, uv + direction * (float(i) + second / weight)).rgb * weight;
+        total += weight;
+    }
+    vec3 light = sum / total * gain;
+
+    vec2 toSun = (uv - sunPosition) * vec2(aspect, 1.0);
+    vec2 toMoon = (uv - moonPosition) * vec2(aspect, 1.0);
+    float r2 = sourceRadius * sourceRadius;
+    light += sunColor * exp(-dot(toSun, toSun) / r2);
+    light += moonColor * exp(-dot(toMoon, toMoon) / r2);
+    FragColor = vec4(light, 1.0);
+}
+)";
+
+LightBuffer::LightBuffer()
+    : enabled(true), screenWidth(0), screenHeight(0), framebuffers{0, 0, 0}, textures{0, 0, 0}, bufferWidth(0),
+      bufferHeight(0), program(0), VAO(0), uSource(-1), uDirection(-1), uGain(-1), uAspect(-1),
+      uSunPosition(-1), uSunColor(-1), uMoonPosition(-1), uMoonColor(-1), uRadius(-1), uSigma(-1),
+      uSourceRadius(-1) {
+}
+
+LightBuffer::~LightBuffer() {
+    shutdown();
+}
+
+void LightBuffer::init() {
+    program = Renderer::createShaderProgram(fullscreenVertexSource, blurFragmentSource);
+    uSource = glGetUniformLocation(program, "source");
+    uDirection = glGetUniformLocation(program, "direction");
+    uGain = glGetUniformLocation(program, "gain");
+    uAspect = glGetUniformLocation(program, "aspect");
+    uSunPosition = glGetUniformLocation(program, "sunPosition");
+    uSunColor = glGetUniformLocation(program, "sunColor");
+    uMoonPosition = glGetUniformLocation(program, "moonPosition");
+    uMoonColor = glGetUniformLocation(program, "moonColor");
+    uRadius = glGetUniformLocation(program, "radius");
+    uSigma = glGetUniformLocation(program, "sigma");
+    uSourceRadius = glGetUniformLocation(program, "sourceRadius");
+    glGenVertexArrays(1, &VAO);
+}
+
+void LightBuffer::shutdown() {
+    destroyTargets();
+    if (VAO) glDeleteVertexArrays(1, &VAO);
+    if (program) glDeleteProgram(program);
+    VAO = 0;
+    program = 0;
+}
+
+bool LightBuffer::beginEmission(int screenWidth, int screenHeight) {
+    // Last frame's light is not read while the new one is built (nor at
+    // all when disabled: the scene then samples black)
+    glActiveTexture(GL_TEXTURE0 + Renderer::kLightTextureUnit);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(GL_TEXTURE0);
+    if (!enabled || !VAO) return false;
+
+    this->screenWidth = screenWidth;
+    this->screenHeight = screenHeight;
+    int width = std::max(1, screenWidth / kDownsample);
+    int height = std::max(1, screenHeight / kDownsample);
+    if (width != bufferWidth || height != bufferHeight) {
+        createTargets(width, height);
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[0]);
+    glViewport(0, 0, bufferWidth, bufferHeight);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    // Sources add up
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+    return true;
+}
+
+void LightBuffer::resolve(const WeatherSystem& weather, glm::vec2 sunPosition, glm::vec2 moonPosition) {
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    // Sun and moon glow fade in over the first degrees above the horizon
+    const EphemerisSample& sky = weather.getSky();
+    float sunStrength = kSunLight * smoothstep(kHorizonAltitude, 10.0f, sky.sunAltitude);
+    float moonStrength = kMoonLight * sky.moonIllumination * smoothstep(kHorizonAltitude, 10.0f, sky.moonAltitude);
+    float warmth = smoothstep(0.0f, 30.0f, sky.sunAltitude);
+    glm::vec3 sunColor = glm::mix(glm::vec3(1.0f, 0.6f, 0.3f), glm::vec3(1.0f, 0.95f, 0.85f), warmth) * sunStrength;
+    glm::vec3 moonColor = glm::vec3(0.7f, 0.75f, 0.9f) * moonStrength;
+
+    glDisable(GL_BLEND);
+    glUseProgram(program);
+    glUniform1i(uSource, 0);
+    glUniform1f(uAspect, static_cast<float>(screenWidth) / screenHeight);
+    glUniform1i(uRadius, kBlurRadius);
+    glUniform1f(uSigma, kBlurSigma);
+    glUniform1f(uSourceRadius, kSourceRadius);
+    glUniform2f(uSunPosition, sunPosition.x / screenWidth, 1.0f - sunPosition.y / screenHeight);
+    glUniform2f(uMoonPosition, moonPosition.x / screenWidth, 1.0f - moonPosition.y / screenHeight);
+    glActiveTexture(GL_TEXTURE0);
+    glBindVertexArray(VAO);
+
+    // Horizontal: emission -> scratch
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[1]);
+    glUniform2f(uDirection, 1.0f / bufferWidth, 0.0f);
+    glUniform1f(uGain, kEmissionGain);
+    glUniform3f(uSunColor, 0.0f, 0.0f, 0.0f);
+    glUniform3f(uMoonColor, 0.0f, 0.0f, 0.0f);
+    glBindTexture(GL_TEXTURE_2D, textures[0]);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+
+    // Vertical, plus the sun and moon: scratch -> light
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[2]);
+    glUniform2f(uDirection, 0.0f, 1.0f / bufferHeight);
+    glUniform1f(uGain, 1.0f);
+    glUniform3f(uSunColor, sunColor.r, sunColor.g, sunColor.b);
+    glUniform3f(uMoonColor, moonColor.r, moonColor.g, moonColor.b);
+    glBindTexture(GL_TEXTURE_2D, textures[1]);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glEnable(GL_BLEND);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, screenWidth, screenHeight);
+
+    // Stays bound on its own unit for the rest of the frame
+    glActiveTexture(GL_TEXTURE0 + Renderer::kLightTextureUnit);
+    glBindTexture(GL_TEXTURE_2D, textures[2]);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void LightBuffer::createTargets(int width, int height) {
+    destroyTargets();
+    bufferWidth = width;
+    bufferHeight = height;
+
+    glGenFramebuffers(3, framebuffers);
+    glGenTextures(3, textures);
+    for (int i = 0; i < 3; i++) {
+        glBindTexture(GL_TEXTURE_2D, textures[i]);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_FLOAT, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[i]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textures[i], 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::cerr << "Light buffer framebuffer incomplete" << std::endl;
+        }
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void LightBuffer::destroyTargets() {
+    if (framebuffers[0]) glDeleteFramebuffers(3, framebuffers);
+    if (textures[0]) glDeleteTextures(3, textures);
+    for (int i = 0; i < 3; i++) {
+        framebuffers[i] = 0;
+        textures[i] = 0;
+    }
+    bufferWidth = bufferHeight = 0;
+}
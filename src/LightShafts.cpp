@@ -0,0 +1,232 @@
+#include "LightShafts.h"
+#include "Renderer.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+// Mask and rays resolution: one texel per kDownsample x kDownsample pixels
+static const int kDownsample = 4;
+
+// Samples per ray texel, from the texel toward the sun
+static const int kSamples = 48;
+
+// Sun altitude at rise and set (degrees), as in CelestialSystem
+static const float kHorizonAltitude = -0.833f;
+
+// Below this cloud cover there are no gaps worth drawing rays through
+static const float kMinCloudCover = 0.05f;
+
+// Shafts are strongest with the sun low; by this altitude (degrees) they
+// have faded to kHighSunStrength
+static const float kLowSunAltitude = 10.0f;
+static const float kHighSunAltitude = 40.0f;
+static const float kHighSunStrength = 0.3f;
+
+static const float kMaxIntensity = 0.45f;
+
+static float smoothstep(float edge0, float edge1, float x) {
+    float t = std::min(std::max((x - edge0) / (edge1 - edge0), 0.0f), 1.0f);
+    return t * t * (3.0f - 2.0f * t);
+}
+
+static const char* fullscreenVertexSource = R"(
+#version 330 core
+out vec2 uv;
+
+void main() {
+    vec2 corner = vec2(float((gl_VertexID << 1) & 2), float(gl_VertexID & 2));
+    uv = corner;
+    gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+}
+)";
+
+// March from the texel toward the sun. Each sample adds the light around
+// the sun that the mask lets through, weighted down the farther along the
+// ray it is, so gaps near the sun throw streaks outward and clouds throw
+// shadows along the same lines.
+static const char* blurFragmentSource = R"(
+#version 330 core
+in vec2 uv;
+out vec4 FragColor;
+
+uniform sampler2D mask;
+uniform vec2 sunPosition;  // Texture coordinates, may lie off screen
+uniform float aspect;
+uniform int samples;
+
+void main() {
+    vec2 step = (sunPosition - uv) / float(samples);
+    vec2 position = uv;
+    float weight = 1.0;
+    float light = 0.0;
+    float total = 0.0;
+    for (int i = 0; i < samples; i++) {
+        float open = 1.0 - texture(mask, position).a;
+        vec2 offset = (position - sunPosition) * vec2(aspect, 1.0);
+        light += open * exp(-dot(offset, offset) * 16.0) * weight;
+        total += weight;
+        weight *= 0.97;
+        position += step;
+    }
+    vec2 offset = (uv - sunPosition) * vec2(aspect, 1.0);
+    float falloff = 1.0 / (1.0 + 3.0 * dot(offset, offset));
+    FragColor = vec4(light / total * falloff, 0.0, 0.0, 1.0);
+}
+)";
+
+static const char* compositeFragmentSource = R"(
+#version 330 core
+in vec2 uv;
+out vec4 FragColor;
+
+uniform sampler2D rays;
+uniform vec3 color;
+
+void main() {
+    FragColor = vec4(color * texture(rays, uv).r, 1.0);
+}
+)";
+
+LightShafts::LightShafts()
+    : enabled(true), intensity(0.0f), sunPosition(0.0f), color(1.0f), screenWidth(0), screenHeight(0),
+      framebuffers{0, 0}, textures{0, 0}, bufferWidth(0), bufferHeight(0), blurProgram(0), compositeProgram(0),
+      VAO(0), uMask(-1), uSunPosition(-1), uAspect(-1), uSamples(-1), uRays(-1), uColor(-1) {
+}
+
+LightShafts::~LightShafts() {
+    shutdown();
+}
+
+void LightShafts::init() {
+    blurProgram = Renderer::createShaderProgram(fullscreenVertexSource, blurFragmentSource);
+    compositeProgram = Renderer::createShaderProgram(fullscreenVertexSource, compositeFragmentSource);
+    uMask = glGetUniformLocation(blurProgram, "mask");
+    uSunPosition = glGetUniformLocation(blurProgram, "sunPosition");
+    uAspect = glGetUniformLocation(blurProgram, "aspect");
+    uSamples = glGetUniformLocation(blurProgram, "samples");
+    uRays = glGetUniformLocation(compositeProgram, "rays");
+    uColor = glGetUniformLocation(compositeProgram, "color");
+    glGenVertexArrays(1, &VAO);
+}
+
+void LightShafts::shutdown() {
+    destroyTargets();
+    if (VAO) glDeleteVertexArrays(1, &VAO);
+    if (blurProgram) glDeleteProgram(blurProgram);
+    if (compositeProgram) glDeleteProgram(compositeProgram);
+    VAO = 0;
+    blurProgram = compositeProgram = 0;
+}
+
+bool LightShafts::beginOcclusion(const WeatherSystem& weather, float cloudCover, glm::vec2 sunPosition,
+                                 int screenWidth, int screenHeight) {
+    intensity = 0.0f;
+    float sunAltitude = weather.getSky().sunAltitude;
+    if (!enabled || !VAO || sunAltitude <= kHorizonAltitude || cloudCover < kMinCloudCover) return false;
+
+    // Fade in over the first few degrees after sunrise and with the first
+    // clouds; weaker once the sun is high
+    float rise = smoothstep(kHorizonAltitude, 3.0f, sunAltitude);
+    float lowSun = 1.0f - (1.0f - kHighSunStrength) * smoothstep(kLowSunAltitude, kHighSunAltitude, sunAltitude);
+    float cover = smoothstep(kMinCloudCover, 0.3f, cloudCover);
+    intensity = kMaxIntensity * rise * lowSun * cover;
+
+    // Golden near the horizon, near white higher up
+    float warmth = smoothstep(0.0f, 30.0f, sunAltitude);
+    color = glm::mix(glm::vec3(1.0f, 0.6f, 0.3f), glm::vec3(1.0f, 0.95f, 0.85f), warmth) * intensity;
+
+    this->sunPosition = sunPosition;
+    this->screenWidth = screenWidth;
+    this->screenHeight = screenHeight;
+
+    int width = std::max(1, screenWidth / kDownsample);
+    int height = std::max(1, screenHeight / kDownsample);
+    if (width != bufferWidth || height != bufferHeight) {
+        createTargets(width, height);
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[0]);
+    glViewport(0, 0, bufferWidth, bufferHeight);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    // Alpha accumulates coverage: overlapping clouds block more
+    glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    return true;
+}
+
+void LightShafts::endOcclusion() {
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    // Blur into the rays target (overwrite, no blending)
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[1]);
+    glDisable(GL_BLEND);
+    glUseProgram(blurProgram);
+    glUniform1i(uMask, 0);
+    glUniform2f(uSunPosition, sunPosition.x / screenWidth, 1.0f - sunPosition.y / screenHeight);
+    glUniform1f(uAspect, static_cast<float>(screenWidth) / screenHeight);
+    glUniform1i(uSamples, kSamples);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, textures[0]);
+    glBindVertexArray(VAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glEnable(GL_BLEND);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, screenWidth, screenHeight);
+}
+
+void LightShafts::composite() {
+    if (intensity <= 0.0f || !textures[1]) return;
+
+    glBlendFunc(GL_ONE, GL_ONE);
+    glUseProgram(compositeProgram);
+    glUniform1i(uRays, 0);
+    glUniform3f(uColor, color.r, color.g, color.b);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, textures[1]);
+    glBindVertexArray(VAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+void LightShafts::createTargets(int width, int height) {
+    destroyTargets();
+    bufferWidth = width;
+    bufferHeight = height;
+
+    // The mask only needs coverage (alpha); the rays are one smooth channel
+    const GLint formats[2] = {GL_RGBA8, GL_R16F};
+    const GLenum layouts[2] = {GL_RGBA, GL_RED};
+
+    glGenFramebuffers(2, framebuffers);
+    glGenTextures(2, textures);
+    for (int i = 0; i < 2; i++) {
+        glBindTexture(GL_TEXTURE_2D, textures[i]);
+        glTexImage2D(GL_TEXTURE_2D, 0, formats[i], width, height, 0, layouts[i], GL_UNSIGNED_BYTE, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[i]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textures[i], 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::cerr << "Light shaft framebuffer incomplete" << std::endl;
+        }
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void LightShafts::destroyTargets() {
+    if (framebuffers[0]) glDeleteFramebuffers(2, framebuffers);
+    if (textures[0]) glDeleteTextures(2, textures);
+    framebuffers[0] = framebuffers[1] = 0;
+    textures[0] = textures[1] = 0;
+    bufferWidth = bufferHeight = 0;
+}
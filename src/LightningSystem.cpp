@@ -3,179 +3,371 @@
 #include <cmath>
 #include <algorithm>
 
+// Bolt library size and the segment block each template gets in the arena
+static const int kLibrarySize = 32;
+static const uint32_t kSegmentBudget = 256;
+
+// Breakdown channels kept after the random-walk ones, and the solver grid;
+// 256 cells is already finer than a channel's 256 output segments show
+static const int kBreakdownSlots = 16;
+static const int kBreakdownGridSize = 256;
+
+// Helper threads for the breakdown sweeps: about half the cores, leaving
+// the rest to the frame's own pool
+static unsigned breakdownThreadCount() {
+    unsigned hardware = std::thread::hardware_concurrency();
+    return hardware > 3 ? hardware / 2 - 1 : 1;
+}
+
+// Pending branches during generation; branches beyond this are dropped
+static const int kMaxPendingBranches = 64;
+
+// Channels are generated in a unit frame one reference bolt high; lengths
+// below are in pixels of that reference bolt
+static const float kReferenceHeight = 500.0f;
+static const int kMaxDepth = 4;
+
+// Branch directions: fixed rotations in 0.1 rad steps over [-0.8, 0.8], so
+// generation needs no trigonometry per branch
+static const int kBranchAngleCount = 17;
+static const float kBranchAngleStep = 0.1f;
+
+// Return strokes: how many may follow the first, the dark gap between
+// them, and how bright the branches get when the channel relights
+static const int kMaxReturnStrokes = 3;
+static const float kReturnStrokeBranchLight = 0.3f;
+
+// Width of a channel drawn as a light source (pixels); the light buffer
+// is coarse, so this only needs to cover a texel
+static const float kLightWidth = 12.0f;
+
+// Small per-thread generator (rand() is shared with the main thread)
+static inline uint32_t nextRandom(uint32_t& state) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+static inline float randomRange(uint32_t& state, float min, float max) {
+    return min + (max - min) * static_cast<float>(nextRandom(state) >> 8) * (1.0f / 16777216.0f);
+}
+
+static inline int randomRangeInt(uint32_t& state, int min, int max) {
+    return min + static_cast<int>(nextRandom(state) % static_cast<uint32_t>(max - min + 1));
+}
+
+struct BranchAngles {
+    glm::vec2 rotation[kBranchAngleCount];  // (cos, sin)
+
+    BranchAngles() {
+        for (int i = 0; i < kBranchAngleCount; i++) {
+            float angle = (i - kBranchAngleCount / 2) * kBranchAngleStep;
+            rotation[i] = glm::vec2(std::cos(angle), std::sin(angle));
+        }
+    }
+};
+
+static const BranchAngles kBranchAngles;
+
+// Rotate by a random table angle within +-maxSteps steps
+static inline glm::vec2 rotateRandom(glm::vec2 direction, int maxSteps, uint32_t& state) {
+    int index = kBranchAngleCount / 2 + randomRangeInt(state, -maxSteps, maxSteps);
+    glm::vec2 r = kBranchAngles.rotation[index];
+    return glm::vec2(direction.x * r.x - direction.y * r.y, direction.x * r.y + direction.y * r.x);
+}
+
 LightningSystem::LightningSystem(int maxBolts)
-    : maxBolts(maxBolts), enabled(true), flashIntensity(0.0f) {
-    bolts.reserve(maxBolts);
+    : bolts(maxBolts), maxBolts(maxBolts), enabled(true), flashIntensity(0.0f),
+      librarySegments(static_cast<size_t>(kLibrarySize + kBreakdownSlots) * kSegmentBudget),
+      templates(kLibrarySize + kBreakdownSlots), readyTemplates(0), stopBuilding(false),
+      breakdownPool(breakdownThreadCount()), breakdown(kBreakdownGridSize), breakdownEnabled(false), breakdownTemplates(0), nextBreakdownSlot(0),
+      breakdownStaging(kSegmentBudget), breakdownStagingCount(0), stagingReady(false), breakdownMilliseconds(0.0f),
+      breakdownRequested(false) {
+    // The first channel is built here so strikes always have one; the rest
+    // are built in the background
+    uint32_t seed = static_cast<uint32_t>(rand()) * 2654435761u + 1u;
+    buildLibrary(0, 1, seed);
+    breakdown.setWorkerPool(&breakdownPool);
+    libraryBuilder = std::thread(&LightningSystem::buildLibrary, this, 1, kLibrarySize, seed ^ 0x5bd1e995u);
+}
+
+LightningSystem::~LightningSystem() {
+    {
+        std::lock_guard<std::mutex> lock(breakdownMutex);
+        stopBuilding.store(true);
+    }
+    breakdownWake.notify_all();
+    if (libraryBuilder.joinable()) {
+        libraryBuilder.join();
+    }
+    if (breakdownWorker.joinable()) {
+        breakdownWorker.join();
+    }
+}
+
+void LightningSystem::setBreakdownEnabled(bool enabled) {
+    breakdownEnabled = enabled;
+    {
+        std::lock_guard<std::mutex> lock(breakdownMutex);
+        breakdownRequested = enabled;
+    }
+    breakdownWake.notify_all();
+    
+    if (enabled && !breakdownWorker.joinable()) {
+        uint32_t seed = static_cast<uint32_t>(rand()) * 2246822519u + 1u;
+        breakdownWorker = std::thread(&LightningSystem::breakdownLoop, this, seed);
+    }
+}
+
+void LightningSystem::breakdownLoop(uint32_t seed) {
+    uint32_t state = seed ? seed : 1u;
+    std::unique_lock<std::mutex> lock(breakdownMutex);
+    while (true) {
+        breakdownWake.wait(lock, [this] {
+            return stopBuilding.load() || (breakdownRequested && !stagingReady.load(std::memory_order_acquire));
+        });
+        if (stopBuilding.load()) return;
+        
+        lock.unlock();
+        state = state * 1664525u + 1013904223u;
+        breakdownStagingCount = breakdown.generate(breakdownStaging.data(), kSegmentBudget, state);
+        breakdownMilliseconds.store(breakdown.getLastMilliseconds(), std::memory_order_relaxed);
+        stagingReady.store(true, std::memory_order_release);
+        lock.lock();
+    }
+}
+
+void LightningSystem::acceptBreakdownChannel() {
+    if (!stagingReady.load(std::memory_order_acquire)) return;
+    
+    // Fill the breakdown slots, then replace the oldest one not on screen
+    int slot = -1;
+    if (breakdownTemplates < kBreakdownSlots) {
+        slot = breakdownTemplates;
+    } else {
+        for (int tries = 0; tries < kBreakdownSlots && slot < 0; tries++) {
+            int candidate = nextBreakdownSlot;
+            nextBreakdownSlot = (nextBreakdownSlot + 1) % kBreakdownSlots;
+            uint32_t index = static_cast<uint32_t>(kLibrarySize + candidate);
+            bool inUse = std::any_of(bolts.begin(), bolts.end(), [index](const LightningBolt& bolt) {
+                return bolt.templateIndex == index;
+            });
+            if (!inUse) slot = candidate;
+        }
+        if (slot < 0) return;  // Try again next update
+    }
+    
+    BoltTemplate& channel = templates[kLibrarySize + slot];
+    channel.segmentStart = static_cast<uint32_t>(kLibrarySize + slot) * kSegmentBudget;
+    channel.segmentCount = breakdownStagingCount;
+    std::copy(breakdownStaging.begin(), breakdownStaging.begin() + breakdownStagingCount,
+              librarySegments.begin() + channel.segmentStart);
+    breakdownTemplates = std::max(breakdownTemplates, slot + 1);
+    
+    {
+        std::lock_guard<std::mutex> lock(breakdownMutex);
+        stagingReady.store(false, std::memory_order_release);
+    }
+    breakdownWake.notify_all();
+}
+
+void LightningSystem::buildLibrary(int first, int end, uint32_t seed) {
+    uint32_t state = seed ? seed : 1u;
+    for (int i = first; i < end && !stopBuilding.load(std::memory_order_relaxed); i++) {
+        BoltTemplate& bolt = templates[i];
+        bolt.segmentStart = static_cast<uint32_t>(i) * kSegmentBudget;
+        bolt.segmentCount = generateChannel(&librarySegments[bolt.segmentStart], kSegmentBudget, state);
+        readyTemplates.store(i + 1, std::memory_order_release);
+    }
+}
+
+uint32_t LightningSystem::generateChannel(LightningSegment* out, uint32_t budget, uint32_t& rngState) {
+    struct Branch {
+        glm::vec2 start;
+        glm::vec2 direction;  // Unit length
+        float length;
+        int depth;
+    };
+    Branch pending[kMaxPendingBranches];
+    int pendingCount = 0;
+    uint32_t count = 0;
+    const float pixel = 1.0f / kReferenceHeight;
+
+    // Main channel: from the cloud to a point one unit down, zigzagging less
+    // toward the ground; it always fits the budget
+    glm::vec2 end(randomRange(rngState, -200.0f, 200.0f) * pixel, 1.0f);
+    glm::vec2 direction = glm::normalize(end);
+    glm::vec2 perpendicular(-direction.y, direction.x);
+    int numSegments = randomRangeInt(rngState, 8, 15);
+    float segmentLength = glm::length(end) / numSegments;
+    glm::vec2 currentPos(0.0f);
+
+    for (int i = 0; i < numSegments; i++) {
+        float offset = randomRange(rngState, -20.0f, 20.0f) * pixel * (1.0f - static_cast<float>(i) / numSegments);
+        glm::vec2 nextPos = (i == numSegments - 1) ? end : currentPos + direction * segmentLength + perpendicular * offset;
+        out[count++] = LightningSegment{currentPos, nextPos, 1.0f, true};
+
+        if (pendingCount < kMaxPendingBranches && randomRange(rngState, 0.0f, 1.0f) < 0.4f) {
+            float length = randomRange(rngState, 50.0f, 150.0f) * pixel;
+            pending[pendingCount++] = Branch{currentPos, rotateRandom(direction, 8, rngState), length, 1};
+        }
+        currentPos = nextPos;
+    }
+
+    // Branches, depth first off the explicit stack, until the budget runs out
+    while (pendingCount > 0 && count < budget) {
+        Branch branch = pending[--pendingCount];
+        float falloff = 1.0f - static_cast<float>(branch.depth) / kMaxDepth;
+        glm::vec2 side(-branch.direction.y, branch.direction.x);
+        numSegments = randomRangeInt(rngState, 3, 6);
+        segmentLength = branch.length / numSegments;
+        currentPos = branch.start;
+
+        for (int i = 0; i < numSegments && count < budget; i++) {
+            float offset = randomRange(rngState, -10.0f, 10.0f) * pixel;
+            glm::vec2 nextPos = currentPos + branch.direction * segmentLength + side * offset;
+            out[count++] = LightningSegment{currentPos, nextPos, 0.6f * falloff, false};
+
+            // Smaller chance for sub-branches
+            if (branch.depth < kMaxDepth && pendingCount < kMaxPendingBranches &&
+                randomRange(rngState, 0.0f, 1.0f) < 0.2f) {
+                float length = randomRange(rngState, 30.0f, 80.0f) * pixel * falloff;
+                pending[pendingCount++] = Branch{currentPos, rotateRandom(branch.direction, 6, rngState), length,
+                                                 branch.depth + 1};
+            }
+            currentPos = nextPos;
+        }
+    }
+    return count;
 }
 
 void LightningSystem::update(float deltaTime) {
-    // Update active bolts
+    acceptBreakdownChannel();
+    
     for (auto& bolt : bolts) {
-        if (bolt.active) {
+        if (!bolt.active) continue;
+        
+        if (bolt.lifetime > 0.0f) {
             bolt.lifetime -= deltaTime;
-            if (bolt.lifetime <= 0.0f) {
-                bolt.active = false;
-            }
+            continue;
+        }
+        
+        // Between strokes the channel is dark; then it relights
+        if (bolt.strokesLeft == 0) {
+            bolt.active = false;
+            continue;
+        }
+        bolt.darkTime -= deltaTime;
+        if (bolt.darkTime <= 0.0f) {
+            bolt.strokesLeft--;
+            bolt.lifetime = 0.08f + random(0.0f, 0.06f);
+            bolt.maxLifetime = bolt.lifetime;
+            bolt.darkTime = 0.04f + random(0.0f, 0.06f);
+            bolt.branchLight = kReturnStrokeBranchLight;
         }
     }
     
-    // Calculate flash intensity based on active bolts
+    // Calculate flash intensity based on lit bolts
     flashIntensity = 0.0f;
     for (const auto& bolt : bolts) {
-        if (bolt.active) {
+        if (bolt.active && bolt.lifetime > 0.0f) {
             float ratio = bolt.lifetime / bolt.maxLifetime;
             flashIntensity = std::max(flashIntensity, ratio);
         }
     }
     
-    // Remove inactive bolts if we have too many
-    bolts.erase(
-        std::remove_if(bolts.begin(), bolts.end(),
-            [](const LightningBolt& b) { return !b.active; }),
-        bolts.end()
-    );
+    // Return finished bolts to the pool
+    size_t i = 0;
+    while (i < bolts.size()) {
+        if (!bolts[i].active) {
+            bolts.releaseAt(i);
+        } else {
+            i++;
+        }
+    }
 }
 
 void LightningSystem::render(Renderer& renderer) {
     if (!enabled) return;
     
     for (const auto& bolt : bolts) {
-        if (!bolt.active) continue;
+        if (!bolt.active || bolt.lifetime <= 0.0f) continue;
         
         float lifetimeRatio = bolt.lifetime / bolt.maxLifetime;
+        const BoltTemplate& channel = templates[bolt.templateIndex];
+        const LightningSegment* segment = &librarySegments[channel.segmentStart];
         
-        for (const auto& segment : bolt.segments) {
+        for (uint32_t s = 0; s < channel.segmentCount; s++, segment++) {
+            float light = segment->mainChannel ? 1.0f : bolt.branchLight;
+            float alpha = lifetimeRatio * segment->intensity * light;
+            if (alpha < 0.01f) continue;
+            
+            glm::vec2 start = bolt.origin + segment->start * bolt.scale;
+            glm::vec2 end = bolt.origin + segment->end * bolt.scale;
+            
             // Lightning color: bright white/cyan
-            float alpha = lifetimeRatio * segment.intensity;
             glm::vec4 color(0.9f, 0.95f, 1.0f, alpha);
             
             // Draw main bolt
-            renderer.drawLine(segment.start, segment.end, 2.5f, color);
+            renderer.drawLine(start, end, 2.5f, color);
             
             // Draw glow effect (wider, more transparent)
             glm::vec4 glowColor(0.6f, 0.8f, 1.0f, alpha * 0.3f);
-            renderer.drawLine(segment.start, segment.end, 6.0f, glowColor);
+            renderer.drawLine(start, end, 6.0f, glowColor);
             
             // Draw bright core
             glm::vec4 coreColor(1.0f, 1.0f, 1.0f, alpha);
-            renderer.drawLine(segment.start, segment.end, 1.0f, coreColor);
+            renderer.drawLine(start, end, 1.0f, coreColor);
         }
     }
 }
 
-void LightningSystem::triggerLightning(int screenWidth, int screenHeight) {
+void LightningSystem::renderLight(Renderer& renderer) const {
     if (!enabled) return;
-    if (bolts.size() >= static_cast<size_t>(maxBolts)) return;
-    
-    LightningBolt bolt;
-    bolt.active = true;
-    bolt.lifetime = 0.15f + random(0.0f, 0.1f);  // Very short duration
-    bolt.maxLifetime = bolt.lifetime;
-    
-    // Random starting position at top of screen
-    glm::vec2 start(random(screenWidth * 0.2f, screenWidth * 0.8f), 0.0f);
-    
-    // Random ending position in middle/lower screen
-    glm::vec2 end(
-        start.x + random(-200.0f, 200.0f),
-        random(screenHeight * 0.5f, screenHeight * 0.9f)
-    );
-    
-    // Generate the bolt with branches
-    generateBolt(bolt, start, end);
-    
-    bolts.push_back(bolt);
-}
-
-void LightningSystem::generateBolt(LightningBolt& bolt, glm::vec2 start, glm::vec2 end, int depth) {
-    const int maxDepth = 4;
-    const int minSegments = 8;
-    const int maxSegments = 15;
-    
-    glm::vec2 direction = end - start;
-    float totalLength = glm::length(direction);
-    direction = glm::normalize(direction);
     
-    int numSegments = randomInt(minSegments, maxSegments);
-    float segmentLength = totalLength / numSegments;
-    
-    glm::vec2 currentPos = start;
-    
-    for (int i = 0; i < numSegments; i++) {
-        // Add some perpendicular offset for zigzag effect
-        glm::vec2 perpendicular(-direction.y, direction.x);
-        float offset = random(-20.0f, 20.0f) * (1.0f - (float)i / numSegments);
-        
-        glm::vec2 nextPos = currentPos + direction * segmentLength + perpendicular * offset;
-        
-        // Ensure last segment reaches the end
-        if (i == numSegments - 1) {
-            nextPos = end;
-        }
-        
-        LightningSegment segment;
-        segment.start = currentPos;
-        segment.end = nextPos;
-        segment.intensity = 1.0f - (float)depth / maxDepth;
+    for (const auto& bolt : bolts) {
+        if (!bolt.active || bolt.lifetime <= 0.0f) continue;
         
-        bolt.segments.push_back(segment);
+        float lifetimeRatio = bolt.lifetime / bolt.maxLifetime;
+        const BoltTemplate& channel = templates[bolt.templateIndex];
+        const LightningSegment* segment = &librarySegments[channel.segmentStart];
         
-        // Randomly add branches
-        if (depth < maxDepth && random(0.0f, 1.0f) < 0.4f) {
-            // Create a branch
-            glm::vec2 branchDir = glm::normalize(nextPos - currentPos);
-            float angle = random(-0.8f, 0.8f);  // Branch angle
+        for (uint32_t s = 0; s < channel.segmentCount; s++, segment++) {
+            float light = segment->mainChannel ? 1.0f : bolt.branchLight;
+            float alpha = lifetimeRatio * segment->intensity * light;
+            if (alpha < 0.01f) continue;
             
-            // Rotate branch direction
-            glm::vec2 rotatedDir(
-                branchDir.x * cos(angle) - branchDir.y * sin(angle),
-                branchDir.x * sin(angle) + branchDir.y * cos(angle)
-            );
-            
-            float branchLength = random(50.0f, 150.0f) * (1.0f - (float)depth / maxDepth);
-            addBranch(bolt, currentPos, rotatedDir, branchLength, depth + 1);
+            glm::vec2 start = bolt.origin + segment->start * bolt.scale;
+            glm::vec2 end = bolt.origin + segment->end * bolt.scale;
+            renderer.drawLine(start, end, kLightWidth, glm::vec4(0.75f, 0.8f, 1.0f, alpha));
         }
-        
-        currentPos = nextPos;
     }
 }
 
-void LightningSystem::addBranch(LightningBolt& bolt, glm::vec2 branchStart, glm::vec2 direction, float length, int depth) {
-    const int maxDepth = 4;
-    int numSegments = randomInt(3, 6);
-    float segmentLength = length / numSegments;
+void LightningSystem::triggerLightning(int screenWidth, int screenHeight) {
+    if (!enabled) return;
     
-    glm::vec2 currentPos = branchStart;
+    LightningBolt* slot = bolts.acquire();
+    if (!slot) return;
+    LightningBolt& bolt = *slot;
     
-    for (int i = 0; i < numSegments; i++) {
-        glm::vec2 perpendicular(-direction.y, direction.x);
-        float offset = random(-10.0f, 10.0f);
-        
-        glm::vec2 nextPos = currentPos + direction * segmentLength + perpendicular * offset;
-        
-        LightningSegment segment;
-        segment.start = currentPos;
-        segment.end = nextPos;
-        segment.intensity = 0.6f * (1.0f - (float)depth / maxDepth);
-        
-        bolt.segments.push_back(segment);
-        
-        // Smaller chance for sub-branches
-        if (depth < maxDepth && random(0.0f, 1.0f) < 0.2f) {
-            glm::vec2 branchDir = glm::normalize(nextPos - currentPos);
-            float angle = random(-0.6f, 0.6f);
-            
-            glm::vec2 rotatedDir(
-                branchDir.x * cos(angle) - branchDir.y * sin(angle),
-                branchDir.x * sin(angle) + branchDir.y * cos(angle)
-            );
-            
-            float subBranchLength = random(30.0f, 80.0f) * (1.0f - (float)depth / maxDepth);
-            addBranch(bolt, currentPos, rotatedDir, subBranchLength, depth + 1);
-        }
-        
-        currentPos = nextPos;
+    // Any finished channel, placed with a random mirror and size
+    if (breakdownEnabled && breakdownTemplates > 0) {
+        bolt.templateIndex = static_cast<uint32_t>(kLibrarySize + rand() % breakdownTemplates);
+    } else {
+        bolt.templateIndex = static_cast<uint32_t>(rand() % getReadyTemplates());
     }
+    bolt.origin = glm::vec2(random(screenWidth * 0.2f, screenWidth * 0.8f), 0.0f);
+    float height = random(screenHeight * 0.5f, screenHeight * 0.9f);
+    bolt.scale = glm::vec2(rand() % 2 ? height : -height, height);
+    
+    bolt.active = true;
+    bolt.lifetime = 0.15f + random(0.0f, 0.1f);  // Very short duration
+    bolt.maxLifetime = bolt.lifetime;
+    bolt.strokesLeft = randomInt(0, kMaxReturnStrokes);
+    bolt.darkTime = 0.04f + random(0.0f, 0.06f);
+    bolt.branchLight = 1.0f;
 }
 
 float LightningSystem::getFlashIntensity() const {
@@ -0,0 +1,317 @@
+#include "MoistureGrid.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Smallest grid, and the granularity sizes are rounded up to (whole SSE
+// lanes per row)
+static const int kMinColumns = 16;
+static const int kMinRows = 8;
+static const int kSizeMultiple = 4;
+
+// Below this many rows per thread the step stays on the calling thread
+static const size_t kParallelRows = 8;
+
+// Longest step taken at once (seconds), and the seconds of cloud physics
+// that pass per second on screen (clouds would take minutes otherwise)
+static const float kMaxStep = 0.05f;
+static const float kTimeScale = 120.0f;
+
+// The grid spans kDepth kilometres from kBaseAltitude up; temperature falls
+// kLapseRate degrees per kilometre and pressure e-folds over kScaleHeight
+static const float kBaseAltitude = 1.0f;
+static const float kDepth = 5.0f;
+static const float kLapseRate = 6.5f;
+static const float kScaleHeight = 8.0f;
+static const float kSurfacePressure = 1013.25f;
+
+// Rising air holds up to kLift more vapour than the humidity alone (most
+// in the middle of the layer). The pattern has kLiftWaves crests across
+// the window and drifts as the clouds do: kCloudSpeed pixels per second
+// plus half the wind.
+static const float kLift = 0.6f;
+static const float kLiftWaves = 2.0f;
+static const float kCloudSpeed = 10.0f;
+
+// Vapour is restored, and cloud water mixed out, over these times (seconds)
+static const float kSupplyTime = 900.0f;
+static const float kMixTime = 900.0f;
+
+// Kessler rates, for mixing ratios in g/kg: autoconversion per second
+// above the threshold, accretion per second per (g/kg)^0.875 of rain, rain
+// evaporation per second per sqrt(g/kg) at full subsaturation
+static const float kAutoconversionRate = 0.001f;
+static const float kAutoconversionThreshold = 0.5f;
+static const float kAccretionRate = 0.0052f;
+static const float kEvaporationRate = 0.002f;
+
+// Below freezing, ice crystals grow at the droplets' expense and snow
+// forms from thinner cloud: the autoconversion threshold falls to nothing
+// by kIceTemperature (a stand-in for the ice processes Kessler lacks)
+static const float kIceTemperature = -15.0f;
+
+// Rain falls at this speed (m/s); a flux of 1 g/kg at 1 m/s is 3.6 mm/h
+static const float kFallSpeed = 5.0f;
+static const float kRainToMillimetres = 3.6f;
+
+// Cloud water path (g/m^2) covering a column to 1 - 1/e
+static const float kCoverPath = 50.0f;
+
+static const float kTwoPi = 6.28318531f;
+
+static float smoothstep(float edge0, float edge1, float x) {
+    float t = std::min(std::max((x - edge0) / (edge1 - edge0), 0.0f), 1.0f);
+    return t * t * (3.0f - 2.0f * t);
+}
+
+static int roundSize(int size, int minimum) {
+    size = std::max(size, minimum);
+    return (size + kSizeMultiple - 1) / kSizeMultiple * kSizeMultiple;
+}
+
+// Saturation mixing ratio (g/kg) at a temperature (Celsius) and pressure (hPa)
+static float saturationMixingRatio(float temperature, float pressure) {
+    float vaporPressure = 6.112f * std::exp(17.67f * temperature / (temperature + 243.5f));
+    return 622.0f * vaporPressure / std::max(pressure - vaporPressure, 1.0f);
+}
+
+MoistureGrid::MoistureGrid(int columns, int rows)
+    : columns(0), rows(0), workers(nullptr), stepMs(0.0f), started(false), liftPhase(0.0f), cloudFraction(0.0f),
+      rainRate(0.0f), supply(0.0f), fall(0.0f), keepCloud(1.0f), autoconversion(0.0f), accretion(0.0f),
+      evaporation(0.0f) {
+    setResolution(columns, rows);
+}
+
+void MoistureGrid::setResolution(int columns, int rows) {
+    columns = roundSize(columns, kMinColumns);
+    rows = roundSize(rows, kMinRows);
+    if (columns == this->columns && rows == this->rows) return;
+    this->columns = columns;
+    this->rows = rows;
+
+    size_t cells = static_cast<size_t>(columns) * rows;
+    vapor.assign(cells, 0.0f);
+    cloud.assign(cells, 0.0f);
+    rain.assign(cells, 0.0f);
+    rainNext.assign(cells, 0.0f);
+    rowSaturation.assign(rows, 0.0f);
+    rowTarget.assign(rows, 0.0f);
+    rowLift.assign(rows, 0.0f);
+    rowThreshold.assign(rows, 0.0f);
+    columnLift.assign(columns, 0.0f);
+    columnCover.assign(columns, 0.0f);
+    columnPath.assign(columns, 0.0f);
+    surfaceRain.assign(columns, 0.0f);
+    cloudFraction = 0.0f;
+    rainRate = 0.0f;
+    started = false;
+}
+
+float MoistureGrid::getCoverAt(float widthFraction) const {
+    int column = static_cast<int>(widthFraction * columns);
+    return columnCover[std::min(std::max(column, 0), columns - 1)];
+}
+
+void MoistureGrid::update(float deltaTime, const WeatherSystem& weather, int screenWidth) {
+    if (screenWidth <= 0) return;
+    auto start = std::chrono::steady_clock::now();
+
+    float step = std::min(deltaTime, kMaxStep);
+    float physics = step * kTimeScale;
+    float cellHeight = kDepth * 1000.0f / rows;
+
+    // Per row: saturation at the row's temperature and pressure, and the
+    // vapour the weather's humidity puts there
+    float surfaceTemperature = weather.getSurfaceTemperature();
+    float humidity = weather.getHumidity();
+    for (int row = 0; row < rows; row++) {
+        float height = 1.0f - (row + 0.5f) / rows;
+        float altitude = kBaseAltitude + kDepth * height;
+        float temperature = surfaceTemperature - kLapseRate * altitude;
+        float pressure = kSurfacePressure * std::exp(-altitude / kScaleHeight);
+        rowSaturation[row] = saturationMixingRatio(temperature, pressure);
+        rowTarget[row] = humidity * rowSaturation[row];
+        rowLift[row] = kLift * 4.0f * height * (1.0f - height);
+        rowThreshold[row] = kAutoconversionThreshold * smoothstep(kIceTemperature, 0.0f, temperature);
+    }
+
+    // Rising air over about the cloud cover's share of the window
+    float drift = kCloudSpeed + 0.5f * weather.getWindVector().x;
+    liftPhase = std::fmod(liftPhase + kTwoPi * kLiftWaves * drift * step / screenWidth, kTwoPi);
+    float shift = 1.0f - 2.0f * weather.getCloudCover();
+    for (int column = 0; column < columns; column++) {
+        float x = kTwoPi * kLiftWaves * (column + 0.5f) / columns;
+        float pattern = 0.6f * std::sin(x - liftPhase) + 0.4f * std::sin(2.3f * x - 1.7f * liftPhase + 1.3f);
+        columnLift[column] = smoothstep(-0.2f, 0.2f, pattern - shift);
+    }
+
+    if (!started) {
+        // Start from the humidity, without supersaturation
+        for (int row = 0; row < rows; row++) {
+            float initial = std::min(rowTarget[row], rowSaturation[row]);
+            std::fill(vapor.begin() + static_cast<size_t>(row) * columns,
+                      vapor.begin() + static_cast<size_t>(row + 1) * columns, initial);
+        }
+        std::fill(cloud.begin(), cloud.end(), 0.0f);
+        std::fill(rain.begin(), rain.end(), 0.0f);
+        started = true;
+    }
+
+    supply = std::min(physics / kSupplyTime, 1.0f);
+    keepCloud = std::max(1.0f - physics / kMixTime, 0.0f);
+    fall = std::min(kFallSpeed * physics / cellHeight, 1.0f);
+    autoconversion = kAutoconversionRate * physics;
+    accretion = kAccretionRate * physics;
+    evaporation = kEvaporationRate * physics;
+
+    if (workers) {
+        workers->parallelFor(static_cast<size_t>(rows), [this](size_t begin, size_t end) {
+            stepRows(static_cast<int>(begin), static_cast<int>(end));
+        }, kParallelRows);
+    } else {
+        stepRows(0, rows);
+    }
+    rain.swap(rainNext);
+
+    // Cloud water path per column (air taken at 1 kg/m^3), and the cover it gives
+    std::fill(columnPath.begin(), columnPath.end(), 0.0f);
+    for (int row = 0; row < rows; row++) {
+        const float* water = &cloud[static_cast<size_t>(row) * columns];
+        for (int column = 0; column < columns; column++) {
+            columnPath[column] += water[column] * cellHeight;
+        }
+    }
+    float coverSum = 0.0f;
+    float rainSum = 0.0f;
+    for (int column = 0; column < columns; column++) {
+        columnCover[column] = 1.0f - std::exp(-columnPath[column] / kCoverPath);
+        coverSum += columnCover[column];
+        rainSum += surfaceRain[column];
+    }
+    cloudFraction = coverSum / columns;
+    rainRate = rainSum / columns;
+
+    stepMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void MoistureGrid::stepRows(int begin, int end) {
+    for (int row = begin; row < end; row++) {
+        size_t offset = static_cast<size_t>(row) * columns;
+        float* qv = &vapor[offset];
+        float* qc = &cloud[offset];
+        const float* qrOld = &rain[offset];
+        float* qr = &rainNext[offset];
+
+        // Rain falling in from the row above (none into the top row)
+        const float* above = row > 0 ? qrOld - columns : qrOld;
+        float inflow = row > 0 ? fall : 0.0f;
+
+        float saturation = rowSaturation[row];
+        float inverseSaturation = 1.0f / saturation;
+        float target = rowTarget[row];
+        float lift = rowLift[row];
+        float threshold = rowThreshold[row];
+
+        int x = 0;
+#if defined(__SSE2__)
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 vSaturation = _mm_set1_ps(saturation);
+        const __m128 vInverse = _mm_set1_ps(inverseSaturation);
+        const __m128 vTarget = _mm_set1_ps(target);
+        const __m128 vLift = _mm_set1_ps(lift);
+        const __m128 vSupply = _mm_set1_ps(supply);
+        const __m128 vKeep = _mm_set1_ps(1.0f - fall);
+        const __m128 vInflow = _mm_set1_ps(inflow);
+        const __m128 vKeepCloud = _mm_set1_ps(keepCloud);
+        const __m128 vAuto = _mm_set1_ps(autoconversion);
+        const __m128 vThreshold = _mm_set1_ps(threshold);
+        const __m128 vAccretion = _mm_set1_ps(accretion);
+        const __m128 vEvaporation = _mm_set1_ps(evaporation);
+        for (; x + 4 <= columns; x += 4) {
+            __m128 vapour = _mm_loadu_ps(qv + x);
+            __m128 water = _mm_loadu_ps(qc + x);
+
+            // Vapour toward the humidity, more of it in rising air
+            __m128 goal = _mm_mul_ps(vTarget, _mm_add_ps(one, _mm_mul_ps(vLift, _mm_loadu_ps(&columnLift[x]))));
+            vapour = _mm_add_ps(vapour, _mm_mul_ps(_mm_sub_ps(goal, vapour), vSupply));
+
+            // Rain falls through
+            __m128 drops = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(qrOld + x), vKeep),
+                                      _mm_mul_ps(_mm_loadu_ps(above + x), vInflow));
+
+            // Condense the excess over saturation, or evaporate cloud water
+            // (at most all of it) into subsaturated air
+            __m128 condensed = _mm_max_ps(_mm_sub_ps(vapour, vSaturation), _mm_sub_ps(zero, water));
+            vapour = _mm_sub_ps(vapour, condensed);
+            water = _mm_mul_ps(_mm_add_ps(water, condensed), vKeepCloud);
+
+            // Autoconversion and accretion (drops^0.875 as drops^(1/2 + 1/4 + 1/8))
+            __m128 root2 = _mm_sqrt_ps(drops);
+            __m128 root4 = _mm_sqrt_ps(root2);
+            __m128 power = _mm_mul_ps(_mm_mul_ps(root2, root4), _mm_sqrt_ps(root4));
+            __m128 converted = _mm_add_ps(_mm_mul_ps(vAuto, _mm_max_ps(_mm_sub_ps(water, vThreshold), zero)),
+                                          _mm_mul_ps(_mm_mul_ps(vAccretion, water), power));
+            converted = _mm_min_ps(converted, water);
+            water = _mm_sub_ps(water, converted);
+            drops = _mm_add_ps(drops, converted);
+
+            // Rain evaporating into subsaturated air (no more than the air
+            // can take, nor than there is)
+            __m128 deficit = _mm_max_ps(_mm_sub_ps(vSaturation, vapour), zero);
+            __m128 evaporated = _mm_mul_ps(_mm_mul_ps(vEvaporation, _mm_mul_ps(deficit, vInverse)), root2);
+            evaporated = _mm_min_ps(evaporated, _mm_min_ps(drops, deficit));
+            drops = _mm_sub_ps(drops, evaporated);
+            vapour = _mm_add_ps(vapour, evaporated);
+
+            _mm_storeu_ps(qv + x, vapour);
+            _mm_storeu_ps(qc + x, water);
+            _mm_storeu_ps(qr + x, drops);
+        }
+#endif
+        for (; x < columns; x++) {
+            float vapour = qv[x];
+            float water = qc[x];
+
+            float goal = target * (1.0f + lift * columnLift[x]);
+            vapour += (goal - vapour) * supply;
+
+            float drops = qrOld[x] * (1.0f - fall) + above[x] * inflow;
+
+            float condensed = std::max(vapour - saturation, -water);
+            vapour -= condensed;
+            water = (water + condensed) * keepCloud;
+
+            float root2 = std::sqrt(drops);
+            float root4 = std::sqrt(root2);
+            float power = root2 * root4 * std::sqrt(root4);
+            float converted = autoconversion * std::max(water - threshold, 0.0f) +
+                              accretion * water * power;
+            converted = std::min(converted, water);
+            water -= converted;
+            drops += converted;
+
+            float deficit = std::max(saturation - vapour, 0.0f);
+            float evaporated = evaporation * deficit * inverseSaturation * root2;
+            evaporated = std::min(evaporated, std::min(drops, deficit));
+            drops -= evaporated;
+            vapour += evaporated;
+
+            qv[x] = vapour;
+            qc[x] = water;
+            qr[x] = drops;
+        }
+
+        // What leaves the bottom row reaches the ground
+        if (row == rows - 1) {
+            float flux = kRainToMillimetres * kFallSpeed;
+            for (int column = 0; column < columns; column++) {
+                surfaceRain[column] = flux * qrOld[column];
+            }
+        }
+    }
+}
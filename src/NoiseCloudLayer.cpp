@@ -0,0 +1,413 @@
+#include "NoiseCloudLayer.h"
+#include "Renderer.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// fBm octaves, and the largest deck height in cells
+static const int kOctaves = 5;
+static const float kFbmScale = 1.0f / 0.96875f;  // 1 / (1/2 + 1/4 + ... + 1/32)
+static const int kMaxRows = 256;
+
+// Below this many new columns the work stays on the calling thread
+static const size_t kParallelColumns = 16;
+
+// Coverage: thickness (pixels) that counts as one unit, as for puff radius
+static const float kCoverageReferenceThickness = 200.0f;
+
+// Deck drift: base speed plus a share of the wind (pixels per second)
+static const float kBaseDrift = 8.0f;
+static const float kWindDrift = 0.5f;
+
+static const char* deckVertexSource = R"(
+#version 330 core
+out vec2 screenPosition;
+out vec2 lightCoord;
+
+uniform mat4 projection;
+uniform float screenWidth;
+uniform float top;
+uniform float height;
+
+void main() {
+    vec2 corner = vec2(float(gl_VertexID & 1), float(gl_VertexID >> 1));
+    screenPosition = vec2(corner.x * screenWidth, top + corner.y * height);
+    gl_Position = projection * vec4(screenPosition, 0.0, 1.0);
+    lightCoord = gl_Position.xy * 0.5 + 0.5;
+}
+)";
+
+// Noise -> density: tapered toward the top and bottom of the deck, then
+// thresholded by cloud cover. Undersides are shaded darker; local light
+// (lightning, sun glow) is added on top.
+static const char* deckFragmentSource = R"(
+#version 330 core
+in vec2 screenPosition;
+in vec2 lightCoord;
+out vec4 FragColor;
+
+uniform sampler2D noiseField;
+uniform sampler2D lightBuffer;
+uniform float top;
+uniform float height;
+uniform float cellSize;
+uniform float columns;
+uniform float rows;
+uniform float offset;     // World column at the left edge, wrapped to the ring
+uniform float threshold;
+uniform vec4 color;
+
+void main() {
+    float v = (screenPosition.y - top) / height;
+    vec2 uv = vec2((offset + screenPosition.x / cellSize + 0.5) / columns,
+                   ((screenPosition.y - top) / cellSize + 0.5) / rows);
+
+    float profile = smoothstep(0.0, 0.25, v) * (1.0 - smoothstep(0.6, 1.0, v));
+    float density = smoothstep(threshold, threshold + 0.15, texture(noiseField, uv).r * profile);
+    if (density <= 0.0) discard;
+
+    vec3 shaded = color.rgb * mix(1.05, 0.65, v) + texture(lightBuffer, lightCoord).rgb;
+    FragColor = vec4(shaded, color.a * density);
+}
+)";
+
+// Same density as the shader, for the CPU coverage estimate
+static float deckDensity(float noise, float v, float threshold) {
+    auto smoothstep = [](float edge0, float edge1, float x) {
+        float t = std::min(std::max((x - edge0) / (edge1 - edge0), 0.0f), 1.0f);
+        return t * t * (3.0f - 2.0f * t);
+    };
+    float profile = smoothstep(0.0f, 0.25f, v) * (1.0f - smoothstep(0.6f, 1.0f, v));
+    return smoothstep(threshold, threshold + 0.15f, noise * profile);
+}
+
+// Coverage threshold: more cover lets weaker noise through
+static float coverThreshold(float cloudCover) {
+    return 0.62f - 0.42f * cloudCover;
+}
+
+// ---------------------------------------------------------------------------
+// Value-noise fBm. Lattice values come from an integer hash, so the SIMD and
+// scalar paths produce identical results.
+
+static inline uint32_t hashLattice(int32_t x, int32_t y, uint32_t seed) {
+    uint32_t h = static_cast<uint32_t>(x) * 374761393u + static_cast<uint32_t>(y) * 668265263u + seed;
+    h = (h ^ (h >> 13)) * 1274126177u;
+    return h ^ (h >> 16);
+}
+
+static inline float latticeValue(int32_t x, int32_t y, uint32_t seed) {
+    return static_cast<float>(hashLattice(x, y, seed) & 0xFFFFFF) * (1.0f / 16777216.0f);
+}
+
+static float valueNoise(float x, float y, uint32_t seed) {
+    float fx = std::floor(x);
+    float fy = std::floor(y);
+    int32_t ix = static_cast<int32_t>(fx);
+    int32_t iy = static_cast<int32_t>(fy);
+    float tx = x - fx;
+    float ty = y - fy;
+    float u = tx * tx * (3.0f - 2.0f * tx);
+    float v = ty * ty * (3.0f - 2.0f * ty);
+
+    float a = latticeValue(ix, iy, seed);
+    float b = latticeValue(ix + 1, iy, seed);
+    float c = latticeValue(ix, iy + 1, seed);
+    float d = latticeValue(ix + 1, iy + 1, seed);
+    float top = a + (b - a) * u;
+    float bottom = c + (d - c) * u;
+    return top + (bottom - top) * v;
+}
+
+static float fbm(float x, float y, uint32_t seed) {
+    float sum = 0.0f;
+    float amplitude = 0.5f;
+    for (int octave = 0; octave < kOctaves; octave++) {
+        sum += amplitude * valueNoise(x, y, seed + octave * 1013u);
+        x *= 2.0f;
+        y *= 2.0f;
+        amplitude *= 0.5f;
+    }
+    return sum * kFbmScale;
+}
+
+#if defined(__SSE2__)
+// 32-bit lane-wise multiply (SSE4.1 has _mm_mullo_epi32; SSE2 does not)
+static inline __m128i mullo32(__m128i a, __m128i b) {
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd = _mm_mul_epu32(_mm_srli_si128(a, 4), _mm_srli_si128(b, 4));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                              _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+static inline __m128 latticeValue4(__m128i x, __m128i y, __m128i seed) {
+    __m128i h = _mm_add_epi32(_mm_add_epi32(mullo32(x, _mm_set1_epi32(374761393)),
+                                            mullo32(y, _mm_set1_epi32(668265263))), seed);
+    h = mullo32(_mm_xor_si128(h, _mm_srli_epi32(h, 13)), _mm_set1_epi32(1274126177));
+    h = _mm_xor_si128(h, _mm_srli_epi32(h, 16));
+    __m128 value = _mm_cvtepi32_ps(_mm_and_si128(h, _mm_set1_epi32(0xFFFFFF)));
+    return _mm_mul_ps(value, _mm_set1_ps(1.0f / 16777216.0f));
+}
+
+static inline __m128 floor4(__m128 v) {
+    __m128 truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(v));
+    __m128 correction = _mm_and_ps(_mm_cmpgt_ps(truncated, v), _mm_set1_ps(1.0f));
+    return _mm_sub_ps(truncated, correction);
+}
+
+static inline __m128 fade4(__m128 t) {
+    return _mm_mul_ps(_mm_mul_ps(t, t), _mm_sub_ps(_mm_set1_ps(3.0f), _mm_add_ps(t, t)));
+}
+
+static inline __m128 valueNoise4(__m128 x, __m128 y, __m128i seed) {
+    __m128 fx = floor4(x);
+    __m128 fy = floor4(y);
+    __m128i ix = _mm_cvttps_epi32(fx);
+    __m128i iy = _mm_cvttps_epi32(fy);
+    __m128i one = _mm_set1_epi32(1);
+    __m128 u = fade4(_mm_sub_ps(x, fx));
+    __m128 v = fade4(_mm_sub_ps(y, fy));
+
+    __m128 a = latticeValue4(ix, iy, seed);
+    __m128 b = latticeValue4(_mm_add_epi32(ix, one), iy, seed);
+    __m128 c = latticeValue4(ix, _mm_add_epi32(iy, one), seed);
+    __m128 d = latticeValue4(_mm_add_epi32(ix, one), _mm_add_epi32(iy, one), seed);
+    __m128 top = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), u));
+    __m128 bottom = _mm_add_ps(c, _mm_mul_ps(_mm_sub_ps(d, c), u));
+    return _mm_add_ps(top, _mm_mul_ps(_mm_sub_ps(bottom, top), v));
+}
+
+static inline __m128 fbm4(__m128 x, __m128 y, uint32_t seed) {
+    __m128 sum = _mm_setzero_ps();
+    float amplitude = 0.5f;
+    for (int octave = 0; octave < kOctaves; octave++) {
+        __m128i octaveSeed = _mm_set1_epi32(static_cast<int>(seed + octave * 1013u));
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(amplitude), valueNoise4(x, y, octaveSeed)));
+        x = _mm_add_ps(x, x);
+        y = _mm_add_ps(y, y);
+        amplitude *= 0.5f;
+    }
+    return _mm_mul_ps(sum, _mm_set1_ps(kFbmScale));
+}
+#endif
+
+// Evaluate `rows` cells of one grid column (x fixed, y = row * frequency)
+static void evaluateColumn(float x, float frequency, int rows, uint32_t seed, float* out) {
+    int row = 0;
+#if defined(__SSE2__)
+    __m128 vx = _mm_set1_ps(x);
+    __m128 step = _mm_set1_ps(4.0f * frequency);
+    __m128 vy = _mm_mul_ps(_mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f), _mm_set1_ps(frequency));
+    for (; row + 4 <= rows; row += 4) {
+        _mm_storeu_ps(out + row, fbm4(vx, vy, seed));
+        vy = _mm_add_ps(vy, step);
+    }
+#endif
+    for (; row < rows; row++) {
+        out[row] = fbm(x, row * frequency, seed);
+    }
+}
+
+// ---------------------------------------------------------------------------
+
+NoiseCloudLayer::NoiseCloudLayer(float cellSize)
+    : cellSize(cellSize), settings{}, columns(0), rows(0), offset(0.0), firstColumn(0), lastUpdatedColumns(0),
+      texture(0), shaderProgram(0), VAO(0), uProjection(-1), uTop(-1), uHeight(-1), uCellSize(-1), uColumns(-1),
+      uRows(-1), uOffset(-1), uThreshold(-1), uColor(-1), uScreenWidth(-1), screenWidth(0) {
+}
+
+NoiseCloudLayer::~NoiseCloudLayer() {
+    shutdown();
+}
+
+void NoiseCloudLayer::init(const Settings& settings) {
+    this->settings = settings;
+    rows = std::min(static_cast<int>(std::ceil(settings.height / cellSize)), kMaxRows);
+
+    shaderProgram = Renderer::createShaderProgram(deckVertexSource, deckFragmentSource);
+    uProjection = glGetUniformLocation(shaderProgram, "projection");
+    uTop = glGetUniformLocation(shaderProgram, "top");
+    uHeight = glGetUniformLocation(shaderProgram, "height");
+    uCellSize = glGetUniformLocation(shaderProgram, "cellSize");
+    uColumns = glGetUniformLocation(shaderProgram, "columns");
+    uRows = glGetUniformLocation(shaderProgram, "rows");
+    uOffset = glGetUniformLocation(shaderProgram, "offset");
+    uThreshold = glGetUniformLocation(shaderProgram, "threshold");
+    uColor = glGetUniformLocation(shaderProgram, "color");
+    uScreenWidth = glGetUniformLocation(shaderProgram, "screenWidth");
+    Renderer::useLightBuffer(shaderProgram);
+
+    glGenVertexArrays(1, &VAO);
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);         // Ring in x
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void NoiseCloudLayer::shutdown() {
+    if (VAO) glDeleteVertexArrays(1, &VAO);
+    if (texture) glDeleteTextures(1, &texture);
+    if (shaderProgram) glDeleteProgram(shaderProgram);
+    VAO = 0;
+    texture = 0;
+    shaderProgram = 0;
+    screenWidth = 0;
+}
+
+void NoiseCloudLayer::update(float deltaTime, float windX, int screenWidth, WorkerPool* workers) {
+    if (!texture) return;
+    lastUpdatedColumns = 0;
+
+    if (screenWidth != this->screenWidth) {
+        resize(screenWidth, workers);
+        return;
+    }
+
+    // The deck drifts right with the wind, so the view moves left through it
+    float drift = (kBaseDrift + windX * kWindDrift) * settings.parallax;
+    offset -= drift * deltaTime / cellSize;
+
+    long long first = static_cast<long long>(std::floor(offset));
+    long long shift = first - firstColumn;
+    if (shift == 0) return;
+
+    // Only the columns scrolling in are new; the ring slots they reuse held
+    // the columns that scrolled out
+    long long begin, end;
+    if (std::llabs(shift) >= columns) {
+        begin = first;
+        end = first + columns;
+    } else if (shift > 0) {
+        begin = firstColumn + columns;
+        end = first + columns;
+    } else {
+        begin = first;
+        end = firstColumn;
+    }
+    firstColumn = first;
+
+    computeColumns(begin, end, workers);
+    uploadColumns(begin, end);
+}
+
+void NoiseCloudLayer::resize(int screenWidth, WorkerPool* workers) {
+    this->screenWidth = screenWidth;
+
+    // One spare column for the sub-cell scroll and one for filtering
+    columns = static_cast<int>(std::ceil(screenWidth / cellSize)) + 2;
+    field.assign(static_cast<size_t>(columns) * rows, 0);
+    firstColumn = static_cast<long long>(std::floor(offset));
+
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, columns, rows, 0, GL_RED, GL_UNSIGNED_BYTE, nullptr);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    computeColumns(firstColumn, firstColumn + columns, workers);
+    uploadColumns(firstColumn, firstColumn + columns);
+}
+
+int NoiseCloudLayer::slotOf(long long worldColumn) const {
+    long long slot = worldColumn % columns;
+    return static_cast<int>(slot < 0 ? slot + columns : slot);
+}
+
+void NoiseCloudLayer::computeColumns(long long begin, long long end, WorkerPool* workers) {
+    size_t count = static_cast<size_t>(end - begin);
+    lastUpdatedColumns += static_cast<int>(count);
+
+    auto work = [this, begin](size_t chunkBegin, size_t chunkEnd) {
+        float values[kMaxRows];
+        for (size_t i = chunkBegin; i < chunkEnd; i++) {
+            long long worldColumn = begin + static_cast<long long>(i);
+            evaluateColumn(static_cast<float>(worldColumn) * settings.frequency, settings.frequency, rows,
+                           settings.seed, values);
+
+            int slot = slotOf(worldColumn);
+            for (int row = 0; row < rows; row++) {
+                float value = std::min(std::max(values[row], 0.0f), 1.0f);
+                field[static_cast<size_t>(row) * columns + slot] = static_cast<uint8_t>(value * 255.0f + 0.5f);
+            }
+        }
+    };
+
+    if (workers && count >= kParallelColumns) {
+        workers->parallelFor(count, work, kParallelColumns / 2);
+    } else {
+        work(0, count);
+    }
+}
+
+void NoiseCloudLayer::uploadColumns(long long begin, long long end) {
+    // The slot range wraps at most once
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, columns);
+
+    long long remaining = end - begin;
+    long long worldColumn = begin;
+    while (remaining > 0) {
+        int slot = slotOf(worldColumn);
+        int width = static_cast<int>(std::min<long long>(remaining, columns - slot));
+        glPixelStorei(GL_UNPACK_SKIP_PIXELS, slot);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, slot, 0, width, rows, GL_RED, GL_UNSIGNED_BYTE, field.data());
+        worldColumn += width;
+        remaining -= width;
+    }
+
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void NoiseCloudLayer::render(const glm::mat4& projection, const glm::vec4& color, float cloudCover) {
+    if (!texture || columns == 0) return;
+
+    glm::vec4 deckColor(glm::vec3(color) * settings.brightness, color.a * settings.opacity);
+    float wrappedOffset = static_cast<float>(offset - std::floor(offset / columns) * columns);
+
+    glUseProgram(shaderProgram);
+    glUniformMatrix4fv(uProjection, 1, GL_FALSE, &projection[0][0]);
+    glUniform1f(uScreenWidth, static_cast<float>(screenWidth));
+    glUniform1f(uTop, settings.top);
+    glUniform1f(uHeight, rows * cellSize);
+    glUniform1f(uCellSize, cellSize);
+    glUniform1f(uColumns, static_cast<float>(columns));
+    glUniform1f(uRows, static_cast<float>(rows));
+    glUniform1f(uOffset, wrappedOffset);
+    glUniform1f(uThreshold, coverThreshold(cloudCover));
+    glUniform4f(uColor, deckColor.r, deckColor.g, deckColor.b, deckColor.a);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glBindVertexArray(VAO);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void NoiseCloudLayer::accumulateCoverage(std::vector<float>& coverage, float columnWidth, float cloudCover, float opacity) const {
+    if (columns == 0) return;
+
+    float threshold = coverThreshold(cloudCover);
+    float weight = opacity * settings.opacity * cellSize / kCoverageReferenceThickness;
+
+    for (size_t c = 0; c < coverage.size(); c++) {
+        // Nearest grid column under the coverage column's center
+        double worldColumn = offset + (c + 0.5) * columnWidth / cellSize;
+        int slot = slotOf(static_cast<long long>(std::floor(worldColumn)));
+
+        float thickness = 0.0f;
+        for (int row = 0; row < rows; row++) {
+            float noise = field[static_cast<size_t>(row) * columns + slot] * (1.0f / 255.0f);
+            thickness += deckDensity(noise, (row + 0.5f) / rows, threshold);
+        }
+        coverage[c] += thickness * weight;
+    }
+}
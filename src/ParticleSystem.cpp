@@ -2,48 +2,131 @@
 #include <cstdlib>
 #include <algorithm>
 
-ParticleSystem::ParticleSystem(int maxParticles)
-    : currentType(ParticleType::NONE), maxParticles(maxParticles), intensity(1.0f) {
-    particles.reserve(maxParticles);
+// Gravity for splash droplets and hail (pixels per second squared)
+static const float kSplashGravity = 900.0f;
+
+// Hail falls no faster than this, and stops bouncing below the second
+static const float kHailTerminalSpeed = 600.0f;
+static const float kHailMinBounceSpeed = 150.0f;
+
+// Typical fall speed of each kind, used to advect the precipitation field
+static const float kFallSpeeds[kParticleTypeCount] = { 400.0f, 55.0f, 250.0f, 475.0f, 0.0f };
+
+// Horizontal speed each kind picks up per unit of wind (matching the spawn
+// velocities), and the rate (per second) at which a falling particle takes
+// on the local wind as it crosses the wind field
+static const float kWindResponse[kParticleTypeCount] = { 3.0f, 5.0f, 3.5f, 1.5f, 0.0f };
+static const float kWindCoupling = 1.5f;
+
+// Grid rain rate (mm/h) per unit of emitter weight: rain, and snow (whose
+// flakes carry far less water each); hail takes a share of storm rain
+static const float kRainRatePerWeight = 10.0f;
+static const float kSnowRatePerWeight = 1.2f;
+static const float kStormHailShare = 0.4f;
+static const float kMaxGridWeight = 3.0f;
+
+// Particles this far past the window's sides return their mass to the field
+static const float kFieldSideMargin = 16.0f;
+
+// Inverse-CDF samples handed to the GPU backend
+static const int kSpawnTableSize = 256;
+
+ParticleSystem::ParticleSystem(int maxParticles, int gpuCapacity)
+    : particles(maxParticles), currentType(ParticleType::NONE), maxParticles(maxParticles), intensity(1.0f),
+      density(1.0f), backend(ParticleBackend::CPU), gpuCapacity(gpuCapacity), ground(nullptr),
+      moisture(nullptr), collisionGrid(32.0f), spawnColumnWidth(1.0f), coverageRateScaling(false),
+      coverageScale(1.0f), hasSpawnCoverage(false), fieldEnabled(true), screenWidth(1280), screenHeight(720) {
+    // Base spawn rates (particles per second at weight 1) and budgets.
+    // Splashes are not rate-driven; they are emitted by rain impacts.
+    const float rates[kParticleTypeCount] = { 600.0f, 600.0f, 500.0f, 150.0f, 0.0f };
+    const int budgets[kParticleTypeCount] = { maxParticles, maxParticles, maxParticles, 2000, maxParticles / 4 };
+    
+    for (int i = 0; i < kParticleTypeCount; i++) {
+        ParticleEmitter& emitter = emitters[i];
+        emitter.type = static_cast<ParticleType>(i);
+        emitter.spawnRate = rates[i];
+        emitter.weight = 0.0f;
+        emitter.targetWeight = 0.0f;
+        emitter.budget = budgets[i];
+        emitter.liveCount = 0;
+        emitter.evictDebt = 0;
+        emitter.fractional = 0.0f;
+        fieldTypeCdf[i] = 1.0f;  // All rain until weights exist
+    }
+    
+    impacts.reserve(4096);
+    snowImpactX.reserve(4096);
+    rainImpactX.reserve(4096);
+    renderOrder.resize(maxParticles);
+    spawnCdf.reserve(1024);
+    spawnCoverage.reserve(1024);
+    spawnTable.resize(kSpawnTableSize);
 }
 
 void ParticleSystem::update(float deltaTime, const WeatherSystem& weather, int screenWidth, int screenHeight) {
-    // Determine particle type based on weather
-    WeatherState state = weather.getState();
-    if (state == WeatherState::RAINING || state == WeatherState::THUNDERSTORM) {
-        currentType = ParticleType::RAIN;
-    } else if (state == WeatherState::SNOWING) {
-        currentType = ParticleType::SNOW;
-    } else {
-        currentType = ParticleType::NONE;
+    this->screenWidth = screenWidth;
+    this->screenHeight = screenHeight;
+    
+    // Crossfade emitters toward the current weather
+    updateEmitterWeights(deltaTime, weather);
+    
+    // GPU state is created lazily, once a GL context is guaranteed to exist
+    if (backend == ParticleBackend::GPU && !gpuBackend.isInitialized()) {
+        if (!gpuBackend.init(gpuCapacity)) {
+            backend = ParticleBackend::CPU;
+        }
     }
     
-    // Spawn new particles based on intensity and weather
-    if (currentType != ParticleType::NONE) {
-        // Base spawn rate per frame (scaled for 60 FPS)
-        float spawnRate = intensity * 600.0f * deltaTime;  // Particles per second
-        
-        if (state == WeatherState::THUNDERSTORM) {
-            spawnRate *= 2.5f;  // More intense rain
-        } else if (state == WeatherState::RAINING) {
-            spawnRate *= 1.5f;  // Heavy rain
-        } else if (state == WeatherState::SNOWING) {
-            spawnRate *= 1.0f;  // Moderate snow (same as base)
+    // Spawn counts per emitter for this frame
+    int spawnCounts[kParticleTypeCount] = {};
+    for (int i = 0; i < kParticleTypeCount; i++) {
+        ParticleEmitter& emitter = emitters[i];
+        if (emitter.weight <= 0.0f) {
+            emitter.fractional = 0.0f;
+            continue;
         }
         
-        int particlesToSpawn = static_cast<int>(spawnRate);
+        float spawnRate = intensity * density * coverageScale * emitter.spawnRate * emitter.weight * deltaTime;
+        int count = static_cast<int>(spawnRate);
         
         // Fractional particles (for smooth spawning at low rates)
-        static float fractionalParticles = 0.0f;
-        fractionalParticles += spawnRate - particlesToSpawn;
-        if (fractionalParticles >= 1.0f) {
-            particlesToSpawn += 1;
-            fractionalParticles -= 1.0f;
+        emitter.fractional += spawnRate - count;
+        if (emitter.fractional >= 1.0f) {
+            count += 1;
+            emitter.fractional -= 1.0f;
         }
-        
-        for (int i = 0; i < particlesToSpawn; i++) {
-            if (particles.size() < static_cast<size_t>(maxParticles)) {
-                spawnParticle(screenWidth, screenHeight, weather);
+        spawnCounts[i] = count;
+    }
+    
+    if (backend == ParticleBackend::GPU) {
+        // The GPU path draws two kinds: streaks (rain, sleet) and discs (snow, hail)
+        int streaks = spawnCounts[static_cast<int>(ParticleType::RAIN)] + spawnCounts[static_cast<int>(ParticleType::SLEET)];
+        int discs = spawnCounts[static_cast<int>(ParticleType::SNOW)] + spawnCounts[static_cast<int>(ParticleType::HAIL)];
+        float groundY = ground ? ground->getBaseY() : static_cast<float>(screenHeight);
+        if (hasSpawnCoverage) {
+            buildSpawnTable();
+            gpuBackend.setSpawnTable(spawnTable.data(), kSpawnTableSize);
+        }
+        gpuBackend.update(deltaTime, streaks, discs, weather.getWindVector(), screenWidth, groundY);
+        return;
+    }
+    
+    if (fieldEnabled) {
+        spawnFromField(deltaTime, weather);
+    } else {
+        // Interleave emitters so no kind starves the others when the arena is tight
+        bool spawned = true;
+        while (spawned) {
+            spawned = false;
+            for (int i = 0; i < kParticleTypeCount; i++) {
+                if (spawnCounts[i] > 0) {
+                    spawnCounts[i]--;
+                    // Across the top of the screen, under the clouds (with
+                    // some margin above)
+                    glm::vec2 position(sampleSpawnX(screenWidth), -20.0f - static_cast<float>(rand() % 50));
+                    spawnParticle(static_cast<ParticleType>(i), position, weather);
+                    spawned = true;
+                }
             }
         }
     }
@@ -53,67 +136,405 @@ void ParticleSystem::update(float deltaTime, const WeatherSystem& weather, int s
         updateParticle(particle, deltaTime, weather);
     }
     
+    // Rain splashes and snow settles where particles reach the ground
+    resolveGroundCollisions();
+    
     // Remove dead particles
     cleanupParticles();
 }
 
 void ParticleSystem::render(Renderer& renderer) {
-    for (const auto& particle : particles) {
-        if (currentType == ParticleType::RAIN) {
+    if (backend == ParticleBackend::GPU) {
+        // Draw whatever is batched behind the particles, then the GPU buffer
+        renderer.flush();
+        gpuBackend.render(renderer.getProjection());
+        return;
+    }
+    
+    // Group particles by kind with a counting sort so each kind is drawn as
+    // one contiguous run, whichever emitter produced it
+    size_t count = particles.size();
+    size_t kindStart[kParticleTypeCount + 1] = {};
+    for (size_t i = 0; i < count; i++) {
+        kindStart[static_cast<int>(particles[i].type) + 1]++;
+    }
+    for (int k = 1; k <= kParticleTypeCount; k++) {
+        kindStart[k] += kindStart[k - 1];
+    }
+    for (size_t i = 0; i < count; i++) {
+        renderOrder[kindStart[static_cast<int>(particles[i].type)]++] = static_cast<uint32_t>(i);
+    }
+    
+    for (size_t i = 0; i < count; i++) {
+        renderParticle(renderer, particles[renderOrder[i]]);
+    }
+}
+
+void ParticleSystem::renderParticle(Renderer& renderer, const Particle& particle) const {
+    switch (particle.type) {
+        case ParticleType::RAIN: {
             // Draw rain as a short line
             glm::vec2 end = particle.position + particle.velocity * 0.02f;
             renderer.drawLine(particle.position, end, particle.size, particle.color);
-        } else if (currentType == ParticleType::SNOW) {
-            // Draw snow as a circle
-            renderer.drawCircle(particle.position, particle.size, particle.color);
+            break;
         }
+        case ParticleType::SLEET: {
+            // Sleet is a shorter, thicker streak
+            glm::vec2 end = particle.position + particle.velocity * 0.01f;
+            renderer.drawLine(particle.position, end, particle.size, particle.color);
+            break;
+        }
+        case ParticleType::SNOW:
+        case ParticleType::HAIL:
+            // A few pixels wide, so few segments suffice
+            renderer.drawCircle(particle.position, particle.size, particle.color, 8);
+            break;
+        case ParticleType::SPLASH:
+            renderer.drawCircle(particle.position, particle.size, particle.color, 6);
+            break;
+        case ParticleType::NONE:
+            break;
     }
 }
 
-void ParticleSystem::setParticleType(ParticleType type) {
-    if (currentType != type) {
-        currentType = type;
-        particles.clear();  // Clear old particles when changing type
+void ParticleSystem::setBackend(ParticleBackend backend) {
+    if (this->backend == backend) return;
+    this->backend = backend;
+    
+    // Particles do not migrate between backends
+    if (backend == ParticleBackend::GPU) {
+        clearParticles();
+    } else {
+        gpuBackend.clear();
     }
 }
 
-void ParticleSystem::spawnParticle(int screenWidth, int screenHeight, const WeatherSystem& weather) {
-    Particle particle;
+void ParticleSystem::setSpawnCoverage(const std::vector<float>& coverage, float columnWidth) {
+    spawnColumnWidth = columnWidth;
+    hasSpawnCoverage = true;
+    spawnCoverage.assign(coverage.begin(), coverage.end());
     
-    // Random position across top of screen (with some margin above)
-    particle.position.x = static_cast<float>(rand() % screenWidth);
-    particle.position.y = -20.0f - static_cast<float>(rand() % 50);
+    spawnCdf.resize(coverage.size());
+    float total = 0.0f;
+    for (size_t i = 0; i < coverage.size(); i++) {
+        total += coverage[i];
+        spawnCdf[i] = total;
+    }
+    
+    // Where it falls is decided per particle by sampleSpawnX; optionally the
+    // overall rate also follows how much dark cloud there is
+    float mean = coverage.empty() ? 0.0f : total / coverage.size();
+    coverageScale = coverageRateScaling ? std::min(mean / PrecipitationField::kFullCoverage, PrecipitationField::kMaxCoverageScale) : 1.0f;
+}
+
+void ParticleSystem::setCoverageRateScaling(bool enabled) {
+    coverageRateScaling = enabled;
+    if (!enabled) {
+        coverageScale = 1.0f;
+    }
+}
+
+float ParticleSystem::sampleSpawnX(int screenWidth) const {
+    if (!hasSpawnCoverage || spawnCdf.empty() || spawnCdf.back() <= 0.0f) {
+        return static_cast<float>(rand() % screenWidth);
+    }
+    
+    // First column whose cumulative weight exceeds the target
+    float target = static_cast<float>(rand()) / (RAND_MAX + 1.0f) * spawnCdf.back();
+    size_t column = std::upper_bound(spawnCdf.begin(), spawnCdf.end(), target) - spawnCdf.begin();
+    column = std::min(column, spawnCdf.size() - 1);
+    
+    float offset = static_cast<float>(rand()) / (RAND_MAX + 1.0f);
+    return (column + offset) * spawnColumnWidth;
+}
+
+void ParticleSystem::buildSpawnTable() {
+    float total = spawnCdf.empty() ? 0.0f : spawnCdf.back();
+    if (total <= 0.0f) {
+        // Nothing to sample from: uniform
+        for (int k = 0; k < kSpawnTableSize; k++) {
+            spawnTable[k] = static_cast<float>(screenWidth) * k / (kSpawnTableSize - 1);
+        }
+        return;
+    }
+    
+    // spawnTable[k] = x below which a fraction k / (size - 1) of the
+    // coverage lies, interpolated within the column
+    for (int k = 0; k < kSpawnTableSize; k++) {
+        float target = total * k / (kSpawnTableSize - 1);
+        size_t column = std::lower_bound(spawnCdf.begin(), spawnCdf.end(), target) - spawnCdf.begin();
+        column = std::min(column, spawnCdf.size() - 1);
+        
+        float before = column > 0 ? spawnCdf[column - 1] : 0.0f;
+        float weight = spawnCdf[column] - before;
+        float fraction = weight > 0.0f ? (target - before) / weight : 0.0f;
+        spawnTable[k] = (column + fraction) * spawnColumnWidth;
+    }
+}
+
+void ParticleSystem::setFieldEnabled(bool enabled) {
+    if (fieldEnabled == enabled) return;
+    fieldEnabled = enabled;
+    field.clear();
+}
+
+void ParticleSystem::spawnFromField(float deltaTime, const WeatherSystem& weather) {
+    // Total source rate, and the split between kinds and mean fall speed
+    // implied by the emitter weights (splashes are not precipitation)
+    float rates[kParticleTypeCount] = {};
+    float totalRate = 0.0f;
+    float fallSpeed = 0.0f;
+    for (int i = 0; i < kParticleTypeCount; i++) {
+        if (static_cast<ParticleType>(i) == ParticleType::SPLASH) continue;
+        rates[i] = intensity * density * emitters[i].spawnRate * emitters[i].weight;
+        totalRate += rates[i];
+        fallSpeed += rates[i] * kFallSpeeds[i];
+    }
+    
+    // Keep the previous split when the sky stops feeding the field, so the
+    // remaining mass still falls as what it was
+    if (totalRate > 0.0f) {
+        float cumulative = 0.0f;
+        int last = 0;
+        for (int i = 0; i < kParticleTypeCount; i++) {
+            cumulative += rates[i] / totalRate;
+            fieldTypeCdf[i] = cumulative;
+            if (rates[i] > 0.0f) last = i;
+        }
+        // Round-off can leave the total just under 1; pin it at the last
+        // kind with a rate so a pick never runs on into SPLASH
+        for (int i = last; i < kParticleTypeCount; i++) {
+            fieldTypeCdf[i] = 1.0f;
+        }
+        fallSpeed /= totalRate;
+    } else {
+        fallSpeed = kFallSpeeds[static_cast<int>(ParticleType::RAIN)];
+    }
     
     glm::vec2 wind = weather.getWindVector();
+    field.resize(screenWidth, screenHeight);
+    field.addSources(deltaTime, totalRate, weather, spawnCoverage, spawnColumnWidth);
+    field.advect(deltaTime, glm::vec2(wind.x * 3.0f, fallSpeed));
     
-    if (currentType == ParticleType::RAIN) {
+    field.extractVisible([this, &weather](glm::vec2 cellMin, float cellSize, int count) {
+        for (int k = 0; k < count; k++) {
+            float pick = static_cast<float>(rand()) / (RAND_MAX + 1.0f);
+            int type = 0;
+            while (type < kParticleTypeCount - 1 && pick >= fieldTypeCdf[type]) type++;
+            
+            glm::vec2 position = cellMin + cellSize * glm::vec2(static_cast<float>(rand()) / RAND_MAX,
+                                                               static_cast<float>(rand()) / RAND_MAX);
+            if (!spawnParticle(static_cast<ParticleType>(type), position, weather)) {
+                return k;  // Arena refused; the rest stays in the field
+            }
+        }
+        return count;
+    });
+}
+
+size_t ParticleSystem::getParticleCount() const {
+    if (backend == ParticleBackend::GPU) {
+        return static_cast<size_t>(gpuBackend.getActiveExtent());
+    }
+    return particles.size();
+}
+
+void ParticleSystem::updateEmitterWeights(float deltaTime, const WeatherSystem& weather) {
+    const float crossfadeSpeed = 0.5f;  // Full transition in two seconds
+    
+    float targets[kParticleTypeCount] = {};
+    WeatherState state = weather.getState();
+    float temperature = weather.getSurfaceTemperature();
+    
+    if (moisture) {
+        // The grid's rain rate sets the amount; the temperature decides
+        // whether it comes down as rain or snow
+        float rate = moisture->getRainRate();
+        if (temperature > 0.0f) {
+            targets[static_cast<int>(ParticleType::RAIN)] = std::min(rate / kRainRatePerWeight, kMaxGridWeight);
+            if (state == WeatherState::THUNDERSTORM) {
+                targets[static_cast<int>(ParticleType::HAIL)] = kStormHailShare * targets[static_cast<int>(ParticleType::RAIN)];
+            }
+        } else {
+            targets[static_cast<int>(ParticleType::SNOW)] = std::min(rate / kSnowRatePerWeight, kMaxGridWeight);
+        }
+    } else if (state == WeatherState::RAINING) {
+        targets[static_cast<int>(ParticleType::RAIN)] = 1.5f;  // Heavy rain
+    } else if (state == WeatherState::THUNDERSTORM) {
+        targets[static_cast<int>(ParticleType::RAIN)] = 2.5f;  // More intense rain
+        targets[static_cast<int>(ParticleType::HAIL)] = 1.0f;
+    } else if (state == WeatherState::SNOWING) {
+        targets[static_cast<int>(ParticleType::SNOW)] = 1.0f;  // Moderate snow
+    }
+    
+    // Near freezing, part of the precipitation comes down as sleet
+    bool precipitating = targets[static_cast<int>(ParticleType::RAIN)] > 0.0f ||
+                         targets[static_cast<int>(ParticleType::SNOW)] > 0.0f;
+    if (precipitating && temperature > -1.0f && temperature < 3.0f) {
+        targets[static_cast<int>(ParticleType::SLEET)] = 0.6f;
+        targets[static_cast<int>(ParticleType::RAIN)] *= 0.5f;
+        targets[static_cast<int>(ParticleType::SNOW)] *= 0.5f;
+    }
+    
+    float strongest = 0.0f;
+    currentType = ParticleType::NONE;
+    for (int i = 0; i < kParticleTypeCount; i++) {
+        ParticleEmitter& emitter = emitters[i];
+        emitter.targetWeight = targets[i];
+        
+        float step = crossfadeSpeed * deltaTime * std::max(1.0f, emitter.targetWeight);
+        if (emitter.weight < emitter.targetWeight) {
+            emitter.weight = std::min(emitter.weight + step, emitter.targetWeight);
+        } else if (emitter.weight > emitter.targetWeight) {
+            emitter.weight = std::max(emitter.weight - step, emitter.targetWeight);
+        }
+        
+        if (emitter.targetWeight > strongest) {
+            strongest = emitter.targetWeight;
+            currentType = emitter.type;
+        }
+    }
+}
+
+Particle* ParticleSystem::acquireParticle(ParticleType type) {
+    ParticleEmitter& emitter = getEmitter(type);
+    if (emitter.liveCount >= emitter.budget) return nullptr;
+    
+    if (particles.full()) {
+        evictForFairShare(type);
+        return nullptr;
+    }
+    
+    Particle* particle = particles.acquire();
+    if (particle) {
+        emitter.liveCount++;
+    }
+    return particle;
+}
+
+void ParticleSystem::evictForFairShare(ParticleType type) {
+    // Fair share: the arena split evenly between emitters that are active
+    // (spawning or still owning particles)
+    int active = 0;
+    for (const auto& emitter : emitters) {
+        if (emitter.liveCount > 0 || emitter.targetWeight > 0.0f) active++;
+    }
+    int fairShare = static_cast<int>(particles.capacity()) / std::max(active, 1);
+    
+    // An emitter at or above its share has to wait for its own particles to die
+    if (getEmitter(type).liveCount >= fairShare) return;
+    
+    // Take from whichever emitter is furthest over its share, counting what
+    // it already owes. The particle goes in the next cleanup sweep, so the
+    // refused spawn waits a tick instead of searching the arena for one.
+    int victim = -1;
+    int worstExcess = 0;
+    for (int i = 0; i < kParticleTypeCount; i++) {
+        int excess = emitters[i].liveCount - emitters[i].evictDebt - fairShare;
+        if (excess > worstExcess) {
+            worstExcess = excess;
+            victim = i;
+        }
+    }
+    if (victim >= 0) {
+        emitters[victim].evictDebt++;
+    }
+}
+
+void ParticleSystem::clearParticles() {
+    particles.clear();
+    field.clear();
+    for (auto& emitter : emitters) {
+        emitter.liveCount = 0;
+        emitter.evictDebt = 0;
+    }
+}
+
+bool ParticleSystem::spawnParticle(ParticleType type, glm::vec2 position, const WeatherSystem& weather) {
+    Particle* slot = acquireParticle(type);
+    if (!slot) return false;
+    Particle& particle = *slot;
+    
+    particle.position = position;
+    
+    glm::vec2 wind = weather.getWindAt(position);
+    
+    if (type == ParticleType::RAIN) {
         // Rain falls faster and is affected more by wind
         particle.velocity.x = wind.x * 3.0f + (rand() % 20 - 10);
         particle.velocity.y = 300.0f + (rand() % 200);  // Fast downward
         particle.size = 1.5f + static_cast<float>(rand() % 10) / 10.0f;
         particle.color = glm::vec4(0.6f, 0.6f, 0.8f, 0.6f);  // Light blue, semi-transparent
         particle.maxLifetime = 5.0f;
-    } else if (currentType == ParticleType::SNOW) {
+    } else if (type == ParticleType::SNOW) {
         // Snow falls slower and drifts more
         particle.velocity.x = wind.x * 5.0f + (rand() % 40 - 20);
         particle.velocity.y = 30.0f + (rand() % 50);  // Slow downward
         particle.size = 2.0f + static_cast<float>(rand() % 20) / 10.0f;
         particle.color = glm::vec4(1.0f, 1.0f, 1.0f, 0.8f);  // White, semi-transparent
         particle.maxLifetime = 10.0f;
+    } else if (type == ParticleType::SLEET) {
+        // Between rain and snow: fairly fast, small icy pellets
+        particle.velocity.x = wind.x * 3.5f + (rand() % 24 - 12);
+        particle.velocity.y = 200.0f + (rand() % 100);
+        particle.size = 1.8f + static_cast<float>(rand() % 6) / 10.0f;
+        particle.color = glm::vec4(0.8f, 0.85f, 0.95f, 0.8f);  // Pale icy blue
+        particle.maxLifetime = 5.0f;
+    } else if (type == ParticleType::HAIL) {
+        // Heavy stones, barely pushed by wind
+        particle.velocity.x = wind.x * 1.5f + (rand() % 10 - 5);
+        particle.velocity.y = 400.0f + (rand() % 150);
+        particle.size = 2.5f + static_cast<float>(rand() % 15) / 10.0f;
+        particle.color = glm::vec4(0.9f, 0.93f, 1.0f, 0.9f);
+        particle.maxLifetime = 4.0f;
     }
     
     particle.lifetime = particle.maxLifetime;
+    particle.type = type;
+    particle.grounded = false;
+    return true;
+}
+
+void ParticleSystem::spawnSplash(glm::vec2 impact, glm::vec2 impactVelocity) {
+    int droplets = 2 + rand() % 2;
     
-    particles.push_back(particle);
+    for (int i = 0; i < droplets; i++) {
+        Particle* slot = acquireParticle(ParticleType::SPLASH);
+        if (!slot) return;
+        Particle& particle = *slot;
+        
+        // Thrown up and sideways, carrying a little of the drop's drift
+        particle.position = glm::vec2(impact.x, impact.y - 1.0f);
+        particle.velocity.x = impactVelocity.x * 0.2f + (rand() % 120 - 60);
+        particle.velocity.y = -(60.0f + rand() % 80);
+        particle.size = 1.0f + static_cast<float>(rand() % 5) / 10.0f;
+        particle.color = glm::vec4(0.7f, 0.7f, 0.9f, 0.8f);
+        particle.maxLifetime = 0.25f + static_cast<float>(rand() % 15) / 100.0f;
+        particle.lifetime = particle.maxLifetime;
+        particle.type = ParticleType::SPLASH;
+        particle.grounded = false;
+    }
 }
 
 void ParticleSystem::updateParticle(Particle& particle, float deltaTime, const WeatherSystem& weather) {
     // Update position
     particle.position += particle.velocity * deltaTime;
     
+    // Take on the local wind (gusts and thermals vary across the window)
+    if (particle.type != ParticleType::SPLASH) {
+        float response = kWindResponse[static_cast<int>(particle.type)];
+        float windX = weather.getWindAt(particle.position).x * response;
+        particle.velocity.x += (windX - particle.velocity.x) * std::min(kWindCoupling * deltaTime, 1.0f);
+    }
+    
     // Add some randomness to snow movement (swaying)
-    if (currentType == ParticleType::SNOW) {
+    if (particle.type == ParticleType::SNOW) {
         particle.velocity.x += (rand() % 20 - 10) * deltaTime;
+    } else if (particle.type == ParticleType::SPLASH || particle.type == ParticleType::HAIL) {
+        particle.velocity.y += kSplashGravity * deltaTime;
+        if (particle.type == ParticleType::HAIL) {
+            particle.velocity.y = std::min(particle.velocity.y, kHailTerminalSpeed);
+        }
     }
     
     // Update lifetime
@@ -124,15 +545,98 @@ void ParticleSystem::updateParticle(Particle& particle, float deltaTime, const W
     particle.color.a = lifetimeRatio * 0.8f;
 }
 
+void ParticleSystem::resolveGroundCollisions() {
+    impacts.clear();
+    snowImpactX.clear();
+    rainImpactX.clear();
+    if (!ground || particles.empty()) return;
+    
+    // Rebuild the broad phase over everything that is alive this tick
+    collisionGrid.setBounds(glm::vec2(-100.0f, -100.0f),
+                            glm::vec2(screenWidth + 100.0f, screenHeight + 100.0f));
+    collisionGrid.build(particles.size(), [this](size_t i) { return particles[i].position; });
+    
+    // Cell rows entirely above the highest ground point cannot collide, so
+    // only the rows from there down are visited
+    const std::vector<uint32_t>& items = collisionGrid.getSortedItems();
+    int firstRow = collisionGrid.rowAt(ground->getTopY());
+    
+    for (int cy = firstRow; cy < collisionGrid.getRows(); cy++) {
+        for (int cx = 0; cx < collisionGrid.getColumns(); cx++) {
+            uint32_t end = collisionGrid.cellEnd(cx, cy);
+            for (uint32_t k = collisionGrid.cellBegin(cx, cy); k < end; k++) {
+                Particle& p = particles[items[k]];
+                if (p.grounded || p.lifetime <= 0.0f) continue;
+                
+                float groundY = ground->getSurfaceY(p.position.x);
+                if (p.position.y < groundY) continue;
+                
+                if (p.type == ParticleType::HAIL && p.velocity.y > kHailMinBounceSpeed) {
+                    // Bounce, losing most of the energy; the hailstone is
+                    // counted once, where it comes to rest
+                    p.position.y = groundY - 0.5f;
+                    p.velocity.y = -p.velocity.y * 0.35f;
+                    p.velocity.x *= 0.6f;
+                    continue;
+                }
+                
+                // Spent on the ground, counted once into the ground cover
+                // (snow settles there as depth, not as lingering particles;
+                // grounded: its mass is not returned to the field)
+                impacts.push_back({glm::vec2(p.position.x, groundY), p.velocity, p.type});
+                p.grounded = true;
+                p.lifetime = 0.0f;
+            }
+        }
+    }
+    
+    // Splashes are spawned after the sweep: arena eviction may swap-remove
+    // particles, which would invalidate the grid's indices mid-sweep
+    for (const auto& impact : impacts) {
+        if (impact.type == ParticleType::RAIN) {
+            spawnSplash(impact.position, impact.velocity);
+            rainImpactX.push_back(impact.position.x);
+        } else if (impact.type != ParticleType::SPLASH) {
+            snowImpactX.push_back(impact.position.x);
+        }
+    }
+}
+
 void ParticleSystem::cleanupParticles() {
-    // Remove particles that have expired or fallen off screen
-    particles.erase(
-        std::remove_if(particles.begin(), particles.end(),
-            [](const Particle& p) {
-                return p.lifetime <= 0.0f || p.position.y > 1000.0f;
-            }),
-        particles.end()
-    );
+    // Remove particles that have expired or fallen off screen.
+    // Swap-remove: the last live particle takes the dead one's place, so
+    // only advance when the current particle survives.
+    float bottom = screenHeight + 100.0f;
+    float left = -kFieldSideMargin;
+    float right = screenWidth + kFieldSideMargin;
+    size_t i = 0;
+    while (i < particles.size()) {
+        const Particle& p = particles[i];
+        ParticleEmitter& emitter = getEmitter(p.type);
+        bool offSide = fieldEnabled && (p.position.x < left || p.position.x > right);
+        if (p.lifetime <= 0.0f || p.position.y > bottom || offSide) {
+            // Drops that leave the window through the sides go back into the
+            // field (splashes never came from it); those that run out of
+            // lifetime in the air have evaporated
+            if (offSide && !p.grounded && p.type != ParticleType::SPLASH && p.position.y <= bottom) {
+                field.deposit(p.position, 1.0f);
+            }
+            emitter.liveCount--;
+            particles.releaseAt(i);
+        } else if (emitter.evictDebt > 0) {
+            // Evicted to make room for an emitter below its fair share
+            emitter.evictDebt--;
+            emitter.liveCount--;
+            particles.releaseAt(i);
+        } else {
+            i++;
+        }
+    }
+    
+    // Debt the sweep could not pay (the particles died on their own)
+    for (auto& emitter : emitters) {
+        emitter.evictDebt = 0;
+    }
 }
 
 // Tweak note: particle params
@@ -0,0 +1,129 @@
+#include "PrecipitationField.h"
+#include <algorithm>
+#include <cmath>
+
+// Rows above the screen that clouds feed (spawned drops start up there)
+static const int kSourceRows = 2;
+
+// Largest fraction of a cell's mass that may leave it in one advection step
+static const float kMaxCourant = 0.9f;
+
+PrecipitationField::PrecipitationField(float cellSize, int worldScreens)
+    : cellSize(cellSize), worldScreens(worldScreens), viewWidth(0), viewHeight(0), viewOffset(0.0f),
+      originY(-kSourceRows * cellSize), columns(0), rows(0), firstVisibleColumn(0), endVisibleColumn(0),
+      sourcePhase(0.0f) {
+}
+
+void PrecipitationField::resize(int viewWidth, int viewHeight) {
+    if (viewWidth == this->viewWidth && viewHeight == this->viewHeight) return;
+    this->viewWidth = viewWidth;
+    this->viewHeight = viewHeight;
+    
+    // Window in the middle of the world, aligned to whole cells
+    int viewColumns = static_cast<int>(std::ceil(viewWidth / cellSize));
+    int sideColumns = viewColumns * (worldScreens - 1) / 2;
+    columns = viewColumns + 2 * sideColumns;
+    rows = kSourceRows + static_cast<int>(std::ceil(viewHeight / cellSize));
+    firstVisibleColumn = sideColumns;
+    endVisibleColumn = sideColumns + viewColumns;
+    viewOffset = sideColumns * cellSize;
+    
+    cells.assign(static_cast<size_t>(columns) * rows, 0.0f);
+    scratch.assign(cells.size(), 0.0f);
+}
+
+void PrecipitationField::addSources(float deltaTime, float rate, const WeatherSystem& weather,
+                                    const std::vector<float>& coverage, float coverageColumnWidth) {
+    if (rate <= 0.0f || columns == 0) return;
+    
+    // Mass per column at full cover, split evenly over the source rows
+    float perColumn = rate * deltaTime * cellSize / viewWidth / kSourceRows;
+    
+    // Off-screen clouds: a slowly drifting pattern scaled by how moist and
+    // overcast the weather is
+    float offscreenCover = weather.getHumidity() * weather.getCloudCover();
+    sourcePhase += weather.getWindVector().x * 0.002f * deltaTime;
+    
+    for (int column = 0; column < columns; column++) {
+        float weight;
+        if (column >= firstVisibleColumn && column < endVisibleColumn && !coverage.empty()) {
+            // Average the coverage histogram over this cell's pixels
+            float left = column * cellSize - viewOffset;
+            size_t first = static_cast<size_t>(std::max(left / coverageColumnWidth, 0.0f));
+            size_t last = static_cast<size_t>((left + cellSize) / coverageColumnWidth);
+            last = std::min(last, coverage.size());
+            float sum = 0.0f;
+            for (size_t c = first; c < last; c++) {
+                sum += coverage[c];
+            }
+            float mean = last > first ? sum / (last - first) : 0.0f;
+            weight = std::min(mean / kFullCoverage, kMaxCoverageScale);
+        } else if (column >= firstVisibleColumn && column < endVisibleColumn) {
+            weight = 1.0f;
+        } else {
+            float x = column * cellSize;
+            weight = offscreenCover * (0.6f + 0.4f * std::sin(x * 0.004f - sourcePhase));
+        }
+        
+        for (int row = 0; row < kSourceRows; row++) {
+            cells[row * columns + column] += perColumn * weight;
+        }
+    }
+}
+
+void PrecipitationField::advect(float deltaTime, glm::vec2 velocity) {
+    if (columns == 0) return;
+    
+    // Fraction of each cell's mass that moves across one face per step;
+    // substep so the scheme stays stable at high wind
+    float courantX = std::fabs(velocity.x) * deltaTime / cellSize;
+    float courantY = std::max(velocity.y, 0.0f) * deltaTime / cellSize;
+    int steps = std::max(1, static_cast<int>(std::ceil((courantX + courantY) / kMaxCourant)));
+    courantX /= steps;
+    courantY /= steps;
+    
+    // Horizontal inflow comes from the upwind neighbour; the world wraps
+    int upwind = velocity.x >= 0.0f ? -1 : 1;
+    
+    for (int step = 0; step < steps; step++) {
+        for (int row = 0; row < rows; row++) {
+            const float* above = row > 0 ? &cells[(row - 1) * columns] : nullptr;
+            const float* current = &cells[row * columns];
+            float* target = &scratch[row * columns];
+            
+            for (int column = 0; column < columns; column++) {
+                int source = column + upwind;
+                if (source < 0) source += columns;
+                if (source >= columns) source -= columns;
+                
+                float mass = current[column] * (1.0f - courantX - courantY) + current[source] * courantX;
+                if (above) mass += above[column] * courantY;
+                target[column] = mass;
+            }
+        }
+        // Mass leaving the bottom row has rained out
+        cells.swap(scratch);
+    }
+}
+
+void PrecipitationField::deposit(glm::vec2 screenPosition, float mass) {
+    if (columns == 0) return;
+    
+    int column = static_cast<int>(std::floor((screenPosition.x + viewOffset) / cellSize));
+    int row = static_cast<int>(std::floor((screenPosition.y - originY) / cellSize));
+    column = std::min(std::max(column, 0), columns - 1);
+    row = std::min(std::max(row, 0), rows - 1);
+    cells[row * columns + column] += mass;
+}
+
+void PrecipitationField::clear() {
+    std::fill(cells.begin(), cells.end(), 0.0f);
+}
+
+float PrecipitationField::getTotalMass() const {
+    float total = 0.0f;
+    for (float mass : cells) {
+        total += mass;
+    }
+    return total;
+}
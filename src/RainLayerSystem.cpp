@@ -0,0 +1,178 @@
+#include "RainLayerSystem.h"
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+// Size of the tiling streak texture (square)
+static const int kStreakTextureSize = 256;
+static const int kStreakCount = 400;
+
+// Rain emitter weight x intensity x coverage at which the layers are at full strength
+static const float kFullStrengthRain = 3.0f;
+
+// Full-screen quad from gl_VertexID (triangle strip), in screen pixels
+static const char* layerVertexSource = R"(
+#version 330 core
+out vec2 screenPosition;
+out vec2 lightCoord;
+
+uniform vec2 screenSize;
+
+void main() {
+    vec2 corner = vec2(float(gl_VertexID & 1), float(gl_VertexID >> 1));
+    screenPosition = vec2(corner.x, 1.0 - corner.y) * screenSize;  // y down, like the renderer
+    lightCoord = corner;
+    gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+}
+)";
+
+// Streaks are vertical in texture space. Offsetting u by the fall distance
+// tilts them along the wind, and scrolling v moves them along that tilt.
+static const char* layerFragmentSource = R"(
+#version 330 core
+in vec2 screenPosition;
+in vec2 lightCoord;
+out vec4 FragColor;
+
+uniform sampler2D streaks;
+uniform sampler2D lightBuffer;
+uniform vec2 screenSize;
+uniform float tileSize;
+uniform float scroll;
+uniform float shear;
+uniform float density;
+uniform vec4 color;
+
+void main() {
+    vec2 uv = vec2(screenPosition.x + screenPosition.y * shear, screenPosition.y) / tileSize;
+    uv.y -= scroll;
+
+    vec2 streak = texture(streaks, uv).rg;
+    float alpha = streak.r * step(streak.g, density);
+
+    // Fade in below the cloud band at the top of the sky
+    alpha *= smoothstep(0.1, 0.35, screenPosition.y / screenSize.y);
+    FragColor = vec4(color.rgb + texture(lightBuffer, lightCoord).rgb, color.a * alpha);
+}
+)";
+
+RainLayerSystem::RainLayerSystem()
+    : enabled(true), strength(0.0f), streakTexture(0), shaderProgram(0), VAO(0),
+      uScreenSize(-1), uTileSize(-1), uScroll(-1), uShear(-1), uDensity(-1), uColor(-1) {
+    // Far layer: small, slow, hazy streaks
+    layers[0] = Layer{ 160.0f, 350.0f, 1.5f, 0.30f, 0.7f, 0.0f, 0.0f };
+    // Middle layer: between the far layer and the simulated particles
+    layers[1] = Layer{ 320.0f, 650.0f, 2.5f, 0.35f, 0.4f, 0.0f, 0.0f };
+}
+
+RainLayerSystem::~RainLayerSystem() {
+    shutdown();
+}
+
+void RainLayerSystem::init() {
+    shaderProgram = Renderer::createShaderProgram(layerVertexSource, layerFragmentSource);
+    uScreenSize = glGetUniformLocation(shaderProgram, "screenSize");
+    uTileSize = glGetUniformLocation(shaderProgram, "tileSize");
+    uScroll = glGetUniformLocation(shaderProgram, "scroll");
+    uShear = glGetUniformLocation(shaderProgram, "shear");
+    uDensity = glGetUniformLocation(shaderProgram, "density");
+    uColor = glGetUniformLocation(shaderProgram, "color");
+    Renderer::useLightBuffer(shaderProgram);
+
+    glGenVertexArrays(1, &VAO);
+    createStreakTexture();
+
+    std::cout << "Rain layers initialized" << std::endl;
+}
+
+void RainLayerSystem::shutdown() {
+    if (VAO) glDeleteVertexArrays(1, &VAO);
+    if (streakTexture) glDeleteTextures(1, &streakTexture);
+    if (shaderProgram) glDeleteProgram(shaderProgram);
+    VAO = 0;
+    streakTexture = 0;
+    shaderProgram = 0;
+}
+
+void RainLayerSystem::update(float deltaTime, const WeatherSystem& weather, const ParticleSystem& particles) {
+    // Follow the rain emitters, so the layers crossfade with the particles
+    float rain = particles.getEmitter(ParticleType::RAIN).weight + particles.getEmitter(ParticleType::SLEET).weight;
+    float amount = rain * particles.getIntensity() * particles.getCoverageScale();
+    strength = std::min(amount / kFullStrengthRain, 1.0f);
+
+    glm::vec2 wind = weather.getWindVector();
+    for (auto& layer : layers) {
+        float fallSpeed = layer.fallSpeed * (0.7f + 0.3f * strength);
+        layer.shear = -(wind.x * layer.windScale) / fallSpeed;
+
+        // Keep the offset small so float precision holds over long sessions
+        layer.scroll += fallSpeed * deltaTime / layer.tileSize;
+        layer.scroll -= static_cast<int>(layer.scroll);
+    }
+}
+
+void RainLayerSystem::render(Renderer& renderer, const WeatherSystem& weather, int screenWidth, int screenHeight) {
+    if (!enabled || !shaderProgram || strength < 0.01f) return;
+
+    // Keep back-to-front order with the batched geometry
+    renderer.flush();
+
+    glm::vec3 sky = weather.getSkyColor();
+    glm::vec3 rainColor(0.6f, 0.6f, 0.8f);
+
+    glUseProgram(shaderProgram);
+    glUniform2f(uScreenSize, static_cast<float>(screenWidth), static_cast<float>(screenHeight));
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, streakTexture);
+    glBindVertexArray(VAO);
+
+    for (const auto& layer : layers) {
+        glm::vec3 color = glm::mix(rainColor, sky, layer.haze);
+        glUniform1f(uTileSize, layer.tileSize);
+        glUniform1f(uScroll, layer.scroll);
+        glUniform1f(uShear, layer.shear);
+        glUniform1f(uDensity, strength);
+        glUniform4f(uColor, color.r, color.g, color.b, layer.opacity * strength);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    }
+
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void RainLayerSystem::createStreakTexture() {
+    const int size = kStreakTextureSize;
+    std::vector<unsigned char> texels(size * size * 2, 0);
+
+    for (int i = 0; i < kStreakCount; i++) {
+        int x = rand() % size;
+        int y = rand() % size;
+        int length = 12 + rand() % 40;
+        float brightness = 0.4f + static_cast<float>(rand() % 60) / 100.0f;
+
+        // Streaks with a low threshold appear first as the density rises
+        unsigned char threshold = static_cast<unsigned char>(rand() % 256);
+
+        for (int j = 0; j < length; j++) {
+            // Fade in from the tail to the head of the drop (wraps vertically)
+            float fade = static_cast<float>(j + 1) / length;
+            int row = (y + j) % size;
+            unsigned char* texel = &texels[(row * size + x) * 2];
+            unsigned char value = static_cast<unsigned char>(255.0f * brightness * fade);
+            if (value > texel[0]) {
+                texel[0] = value;
+                texel[1] = threshold;
+            }
+        }
+    }
+
+    glGenTextures(1, &streakTexture);
+    glBindTexture(GL_TEXTURE_2D, streakTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RG8, size, size, 0, GL_RG, GL_UNSIGNED_BYTE, texels.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
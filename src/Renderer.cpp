@@ -10,12 +10,14 @@ layout (location = 0) in vec2 aPos;
 layout (location = 1) in vec4 aColor;
 
 out vec4 vertexColor;
+out vec2 lightCoord;
 
 uniform mat4 projection;
 
 void main() {
     gl_Position = projection * vec4(aPos, 0.0, 1.0);
     vertexColor = aColor;
+    lightCoord = gl_Position.xy * 0.5 + 0.5;
 }
 )";
 
@@ -23,14 +25,19 @@ void main() {
 const char* fragmentShaderSource = R"(
 #version 330 core
 in vec4 vertexColor;
+in vec2 lightCoord;
 out vec4 FragColor;
 
+uniform sampler2D lightBuffer;
+uniform float lighting;
+
 void main() {
-    FragColor = vertexColor;
+    vec3 light = texture(lightBuffer, lightCoord).rgb * lighting;
+    FragColor = vec4(vertexColor.rgb + light, vertexColor.a);
 }
 )";
 
-Renderer::Renderer() : shaderProgram(0), VAO(0), VBO(0) {
+Renderer::Renderer() : shaderProgram(0), VAO(0), VBO(0), uLighting(-1), lighting(0.0f), projection(1.0f) {
 }
 
 Renderer::~Renderer() {
@@ -40,6 +47,9 @@ Renderer::~Renderer() {
 void Renderer::init() {
     // Create shader program
     shaderProgram = createShaderProgram(vertexShaderSource, fragmentShaderSource);
+    uLighting = glGetUniformLocation(shaderProgram, "lighting");
+    useLightBuffer(shaderProgram);
+    glUniform1f(uLighting, lighting);
     
     // Generate VAO and VBO
     glGenVertexArrays(1, &VAO);
@@ -69,18 +79,35 @@ void Renderer::shutdown() {
 
 void Renderer::setProjection(int width, int height) {
     // Orthographic projection (0,0) at top-left
-    glm::mat4 projection = glm::ortho(0.0f, (float)width, (float)height, 0.0f, -1.0f, 1.0f);
+    projection = glm::ortho(0.0f, (float)width, (float)height, 0.0f, -1.0f, 1.0f);
     
     glUseProgram(shaderProgram);
     GLint projLoc = glGetUniformLocation(shaderProgram, "projection");
     glUniformMatrix4fv(projLoc, 1, GL_FALSE, &projection[0][0]);
 }
 
+void Renderer::setLighting(float amount) {
+    if (amount == lighting) return;
+    flush();
+    lighting = amount;
+    glUseProgram(shaderProgram);
+    glUniform1f(uLighting, lighting);
+}
+
+void Renderer::useLightBuffer(GLuint program) {
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "lightBuffer"), kLightTextureUnit);
+}
+
 void Renderer::begin() {
     vertices.clear();
 }
 
 void Renderer::end() {
+    flush();
+}
+
+void Renderer::flush() {
     if (vertices.empty()) return;
     
     glUseProgram(shaderProgram);
@@ -94,10 +121,11 @@ void Renderer::end() {
     glDrawArrays(GL_TRIANGLES, 0, vertices.size());
     
     glBindVertexArray(0);
+    vertices.clear();
 }
 
-void Renderer::drawCircle(const glm::vec2& center, float radius, const glm::vec4& color) {
-    generateCircleVertices(center, radius, color);
+void Renderer::drawCircle(const glm::vec2& center, float radius, const glm::vec4& color, int segments) {
+    generateCircleVertices(center, radius, color, segments);
 }
 
 void Renderer::drawRectangle(const glm::vec2& position, const glm::vec2& size, const glm::vec4& color) {
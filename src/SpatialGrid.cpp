@@ -0,0 +1,20 @@
+#include "SpatialGrid.h"
+#include <algorithm>
+#include <cmath>
+
+SpatialGrid::SpatialGrid(float cellSize)
+    : cellSize(cellSize), inverseCellSize(1.0f / cellSize), origin(0.0f), columns(1), rows(1) {
+    cellStart.assign(2, 0);
+}
+
+void SpatialGrid::setBounds(glm::vec2 minCorner, glm::vec2 maxCorner) {
+    origin = minCorner;
+    int newColumns = std::max(1, static_cast<int>(std::ceil((maxCorner.x - minCorner.x) / cellSize)));
+    int newRows = std::max(1, static_cast<int>(std::ceil((maxCorner.y - minCorner.y) / cellSize)));
+
+    if (newColumns != columns || newRows != rows) {
+        columns = newColumns;
+        rows = newRows;
+        cellStart.assign(static_cast<size_t>(columns) * rows + 1, 0);
+    }
+}
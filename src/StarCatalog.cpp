@@ -0,0 +1,182 @@
+#include "StarCatalog.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const uint32_t kCatalogVersion = 1;
+
+// Width of a magnitude bucket
+static const float kBucketWidth = 1.0f;
+
+struct CatalogHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t starCount;
+    uint32_t bucketCount;
+};
+
+StarCatalog::StarCatalog()
+    : mapping(nullptr), mappingSize(0),
+#if defined(_WIN32)
+      fileHandle(nullptr), mappingHandle(nullptr),
+#endif
+      stars(nullptr), starCount(0), buckets(nullptr), bucketCount(0) {
+}
+
+StarCatalog::~StarCatalog() {
+    close();
+}
+
+bool StarCatalog::open(const std::string& path) {
+    close();
+
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart < static_cast<LONGLONG>(sizeof(CatalogHeader))) {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE view = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!view) {
+        CloseHandle(file);
+        return false;
+    }
+    void* data = MapViewOfFile(view, FILE_MAP_READ, 0, 0, 0);
+    if (!data) {
+        CloseHandle(view);
+        CloseHandle(file);
+        return false;
+    }
+    fileHandle = file;
+    mappingHandle = view;
+    mappingSize = static_cast<size_t>(fileSize.QuadPart);
+#else
+    int file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0) return false;
+    struct stat info;
+    if (fstat(file, &info) != 0 || info.st_size < static_cast<off_t>(sizeof(CatalogHeader))) {
+        ::close(file);
+        return false;
+    }
+    void* data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+    // The mapping keeps the file alive
+    ::close(file);
+    if (data == MAP_FAILED) return false;
+    mappingSize = static_cast<size_t>(info.st_size);
+#endif
+    mapping = static_cast<const unsigned char*>(data);
+
+    // Validate the header and the table sizes against the file; the star
+    // records themselves are not touched
+    CatalogHeader header;
+    std::memcpy(&header, mapping, sizeof(header));
+    size_t bucketBytes = static_cast<size_t>(header.bucketCount) * sizeof(StarBucket);
+    size_t starBytes = static_cast<size_t>(header.starCount) * sizeof(CatalogStar);
+    if (std::memcmp(header.magic, "STAR", 4) != 0 || header.version != kCatalogVersion ||
+        sizeof(header) + bucketBytes + starBytes != mappingSize) {
+        std::cerr << "Invalid star catalog: " << path << std::endl;
+        close();
+        return false;
+    }
+
+    buckets = reinterpret_cast<const StarBucket*>(mapping + sizeof(header));
+    bucketCount = static_cast<int>(header.bucketCount);
+    stars = reinterpret_cast<const CatalogStar*>(mapping + sizeof(header) + bucketBytes);
+    starCount = header.starCount;
+
+    // Buckets must tile the star array in order
+    uint32_t expected = 0;
+    for (int i = 0; i < bucketCount; i++) {
+        if (buckets[i].first != expected || buckets[i].count > starCount - expected) {
+            std::cerr << "Invalid star catalog buckets: " << path << std::endl;
+            close();
+            return false;
+        }
+        expected += buckets[i].count;
+    }
+    if (expected != starCount) {
+        std::cerr << "Invalid star catalog buckets: " << path << std::endl;
+        close();
+        return false;
+    }
+    return true;
+}
+
+void StarCatalog::close() {
+    if (mapping) {
+#if defined(_WIN32)
+        UnmapViewOfFile(mapping);
+        CloseHandle(static_cast<HANDLE>(mappingHandle));
+        CloseHandle(static_cast<HANDLE>(fileHandle));
+        mappingHandle = fileHandle = nullptr;
+#else
+        munmap(const_cast<unsigned char*>(mapping), mappingSize);
+#endif
+        mapping = nullptr;
+        mappingSize = 0;
+    }
+    ownedStars.clear();
+    ownedBuckets.clear();
+    stars = nullptr;
+    starCount = 0;
+    buckets = nullptr;
+    bucketCount = 0;
+}
+
+void StarCatalog::setStars(std::vector<CatalogStar> entries) {
+    close();
+    sortAndBucket(entries, ownedBuckets);
+    ownedStars.swap(entries);
+
+    stars = ownedStars.data();
+    starCount = ownedStars.size();
+    buckets = ownedBuckets.data();
+    bucketCount = static_cast<int>(ownedBuckets.size());
+}
+
+int StarCatalog::bucketsBrighterThan(float limitingMagnitude) const {
+    int count = 0;
+    while (count < bucketCount && buckets[count].minMagnitude <= limitingMagnitude) {
+        count++;
+    }
+    return count;
+}
+
+void StarCatalog::sortAndBucket(std::vector<CatalogStar>& entries, std::vector<StarBucket>& bucketTable) {
+    std::sort(entries.begin(), entries.end(),
+              [](const CatalogStar& a, const CatalogStar& b) { return a.magnitude < b.magnitude; });
+
+    bucketTable.clear();
+    size_t i = 0;
+    while (i < entries.size()) {
+        float band = std::floor(entries[i].magnitude / kBucketWidth);
+        StarBucket bucket;
+        bucket.first = static_cast<uint32_t>(i);
+        bucket.minMagnitude = entries[i].magnitude;
+        while (i < entries.size() && std::floor(entries[i].magnitude / kBucketWidth) == band) {
+            i++;
+        }
+        bucket.count = static_cast<uint32_t>(i) - bucket.first;
+        bucket.maxMagnitude = entries[i - 1].magnitude;
+        bucketTable.push_back(bucket);
+    }
+}
@@ -0,0 +1,173 @@
+#include "TrailBuffer.h"
+#include "Renderer.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+// Full-screen triangle from gl_VertexID, shared by both passes
+static const char* fullscreenVertexSource = R"(
+#version 330 core
+out vec2 uv;
+
+void main() {
+    vec2 corner = vec2(float((gl_VertexID << 1) & 2), float(gl_VertexID & 2));
+    uv = corner;
+    gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+}
+)";
+
+// Copy the previous history, scaled down (premultiplied, so all channels fade)
+static const char* fadeFragmentSource = R"(
+#version 330 core
+in vec2 uv;
+out vec4 FragColor;
+
+uniform sampler2D history;
+uniform float fade;
+
+void main() {
+    FragColor = texture(history, uv) * fade;
+}
+)";
+
+static const char* compositeFragmentSource = R"(
+#version 330 core
+in vec2 uv;
+out vec4 FragColor;
+
+uniform sampler2D history;
+
+void main() {
+    FragColor = texture(history, uv);
+}
+)";
+
+TrailBuffer::TrailBuffer()
+    : framebuffers{0, 0}, textures{0, 0}, current(0), bufferWidth(0), bufferHeight(0),
+      screenWidth(0), screenHeight(0), decayTime(0.08f), resolutionScale(0.5f), needsClear(true),
+      fadeProgram(0), compositeProgram(0), VAO(0), uFadeHistory(-1), uFadeFactor(-1), uCompositeHistory(-1) {
+}
+
+TrailBuffer::~TrailBuffer() {
+    shutdown();
+}
+
+void TrailBuffer::init() {
+    fadeProgram = Renderer::createShaderProgram(fullscreenVertexSource, fadeFragmentSource);
+    compositeProgram = Renderer::createShaderProgram(fullscreenVertexSource, compositeFragmentSource);
+    uFadeHistory = glGetUniformLocation(fadeProgram, "history");
+    uFadeFactor = glGetUniformLocation(fadeProgram, "fade");
+    uCompositeHistory = glGetUniformLocation(compositeProgram, "history");
+    glGenVertexArrays(1, &VAO);
+}
+
+void TrailBuffer::shutdown() {
+    destroyTargets();
+    if (VAO) glDeleteVertexArrays(1, &VAO);
+    if (fadeProgram) glDeleteProgram(fadeProgram);
+    if (compositeProgram) glDeleteProgram(compositeProgram);
+    VAO = 0;
+    fadeProgram = compositeProgram = 0;
+}
+
+void TrailBuffer::beginCapture(float deltaTime, int screenWidth, int screenHeight) {
+    this->screenWidth = screenWidth;
+    this->screenHeight = screenHeight;
+
+    float scale = std::min(std::max(resolutionScale, 0.25f), 1.0f);
+    int width = std::max(1, static_cast<int>(screenWidth * scale));
+    int height = std::max(1, static_cast<int>(screenHeight * scale));
+    if (width != bufferWidth || height != bufferHeight) {
+        createTargets(width, height);
+    }
+
+    int previous = current;
+    current = 1 - current;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[current]);
+    glViewport(0, 0, bufferWidth, bufferHeight);
+
+    if (needsClear) {
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        needsClear = false;
+    } else {
+        // Fade the old history into the new target (overwrite, no blending)
+        float fade = std::exp(-deltaTime / std::max(decayTime, 0.001f));
+        glDisable(GL_BLEND);
+        glUseProgram(fadeProgram);
+        glUniform1i(uFadeHistory, 0);
+        glUniform1f(uFadeFactor, fade);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, textures[previous]);
+        glBindVertexArray(VAO);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glBindVertexArray(0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glEnable(GL_BLEND);
+    }
+
+    // Accumulate premultiplied color so the composite can blend correctly
+    glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+void TrailBuffer::endCapture() {
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, screenWidth, screenHeight);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+void TrailBuffer::composite() {
+    if (!textures[current]) return;
+
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    glUseProgram(compositeProgram);
+    glUniform1i(uCompositeHistory, 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, textures[current]);
+    glBindVertexArray(VAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+void TrailBuffer::clear() {
+    needsClear = true;
+}
+
+void TrailBuffer::createTargets(int width, int height) {
+    destroyTargets();
+    bufferWidth = width;
+    bufferHeight = height;
+
+    glGenFramebuffers(2, framebuffers);
+    glGenTextures(2, textures);
+    for (int i = 0; i < 2; i++) {
+        // Half float: in 8 bits the fade rounds back up to the same level
+        // once it drops below half a step, leaving permanent smears
+        glBindTexture(GL_TEXTURE_2D, textures[i]);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_HALF_FLOAT, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[i]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textures[i], 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::cerr << "Trail buffer framebuffer incomplete" << std::endl;
+        }
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    needsClear = true;
+}
+
+void TrailBuffer::destroyTargets() {
+    if (framebuffers[0]) glDeleteFramebuffers(2, framebuffers);
+    if (textures[0]) glDeleteTextures(2, textures);
+    framebuffers[0] = framebuffers[1] = 0;
+    textures[0] = textures[1] = 0;
+    bufferWidth = bufferHeight = 0;
+}
@@ -1,4 +1,6 @@
 #include "WeatherSystem.h"
+#include "ColumnTemperature.h"
+#include "WindField.h"
 #include <cstdlib>
 #include <ctime>
 #include <cmath>
@@ -12,12 +14,15 @@ WeatherSystem::WeatherSystem()
       timeOfDay(0.5f),  // Start at noon
       timeScale(0.01f),  // Slow time progression
       currentState(WeatherState::CLEAR),
+      windField(nullptr),
+      columnTemperature(nullptr),
       stateTransitionTimer(0.0f),
       lightningFlash(0.0f),
       lightningDecay(5.0f) {
     
     // Seed random number generator
     std::srand(static_cast<unsigned int>(std::time(nullptr)));
+    sky = ephemeris.sample(timeOfDay);
 }
 
 void WeatherSystem::update(float deltaTime) {
@@ -25,7 +30,9 @@ void WeatherSystem::update(float deltaTime) {
     timeOfDay += deltaTime * timeScale;
     if (timeOfDay > 1.0f) {
         timeOfDay -= 1.0f;
+        ephemeris.advanceDay();
     }
+    sky = ephemeris.sample(timeOfDay);
 
     // Update state transitions
     updateStateTransitions(deltaTime);
@@ -39,6 +46,48 @@ void WeatherSystem::update(float deltaTime) {
     }
 }
 
+void WeatherSystem::setTimeOfDay(float time) {
+    timeOfDay = time;
+    sky = ephemeris.sample(timeOfDay);
+}
+
+void WeatherSystem::setDate(int year, int month, int day) {
+    ephemeris.setDate(year, month, day);
+    sky = ephemeris.sample(timeOfDay);
+}
+
+void WeatherSystem::setSite(float latitude, float longitude, float utcOffsetHours) {
+    ephemeris.setSite(latitude, longitude, utcOffsetHours);
+    sky = ephemeris.sample(timeOfDay);
+}
+
+glm::vec2 WeatherSystem::getWindAt(glm::vec2 screenPosition) const {
+    return windField ? windField->sample(screenPosition) : windVector;
+}
+
+float WeatherSystem::getSurfaceTemperature() const {
+    if (columnTemperature && columnTemperature->getColumns() > 0) {
+        return columnTemperature->getSurfaceTemperature();
+    }
+    return temperature;
+}
+
+float WeatherSystem::getDayPhase() const {
+    float sunrise = ephemeris.getSunrise();
+    float sunset = ephemeris.getSunset();
+    if (sunrise < 0.0f || sunset < sunrise) {
+        // Polar day or night, or a sunset past midnight: go by the sun alone
+        return sky.sunAltitude > 0.0f ? 0.5f : 0.0f;
+    }
+    if (timeOfDay < sunrise) {
+        return 0.25f * timeOfDay / sunrise;
+    }
+    if (timeOfDay < sunset) {
+        return 0.25f + 0.5f * (timeOfDay - sunrise) / (sunset - sunrise);
+    }
+    return 0.75f + 0.25f * (timeOfDay - sunset) / (1.0f - sunset);
+}
+
 void WeatherSystem::setState(WeatherState newState) {
     if (newState == currentState) return;
     
@@ -48,9 +97,11 @@ void WeatherSystem::setState(WeatherState newState) {
     switch (currentState) {
         case WeatherState::CLEAR:
             cloudCover = 0.1f;
+            humidity = 0.4f;
             break;
         case WeatherState::CLOUDY:
             cloudCover = 0.6f;
+            humidity = 0.7f;
             break;
         case WeatherState::RAINING:
             cloudCover = 0.8f;
@@ -63,6 +114,7 @@ void WeatherSystem::setState(WeatherState newState) {
             break;
         case WeatherState::SNOWING:
             cloudCover = 0.7f;
+            humidity = 0.9f;
             temperature = random(-10.0f, 0.0f);
             break;
     }
@@ -87,7 +139,8 @@ void WeatherSystem::updateStateTransitions(float deltaTime) {
     
     stateTransitionTimer = 0.0f;
     
-    // Calculate probability of state change based on pressure and temperature
+    // Calculate probability of state change based on pressure; the
+    // temperature at the ground decides between rain and snow
     float chanceOfRain = 1.0f - normalize(pressure, 980.0f, 1050.0f);
     float randomRoll = random(0.0f, 1.0f);
     
@@ -101,7 +154,7 @@ void WeatherSystem::updateStateTransitions(float deltaTime) {
             
         case WeatherState::CLOUDY:
             if (randomRoll < chanceOfRain * 0.5f) {
-                if (temperature <= 0.0f) {
+                if (getSurfaceTemperature() <= 0.0f) {
                     setState(WeatherState::SNOWING);
                 } else {
                     setState(WeatherState::RAINING);
@@ -130,7 +183,7 @@ void WeatherSystem::updateStateTransitions(float deltaTime) {
             break;
             
         case WeatherState::SNOWING:
-            if (temperature > 2.0f) {
+            if (getSurfaceTemperature() > 2.0f) {
                 setState(WeatherState::RAINING);
             } else if (randomRoll > 0.7f) {
                 setState(WeatherState::CLOUDY);
@@ -153,28 +206,30 @@ glm::vec3 WeatherSystem::getSkyColor() const {
     
     glm::vec3 baseColor;
     
-    // Interpolate based on time of day
-    if (timeOfDay < 0.25f) {
+    // Interpolate based on time of day, with dawn and dusk at the site's
+    // real sunrise and sunset
+    float dayPhase = getDayPhase();
+    if (dayPhase < 0.25f) {
         // Night (0.0 - 0.25)
         baseColor = nightColor;
-    } else if (timeOfDay < 0.35f) {
+    } else if (dayPhase < 0.35f) {
         // Dawn (0.25 - 0.35)
-        float t = (timeOfDay - 0.25f) / 0.1f;
+        float t = (dayPhase - 0.25f) / 0.1f;
         baseColor = glm::mix(nightColor, dawnColor, t);
-    } else if (timeOfDay < 0.4f) {
+    } else if (dayPhase < 0.4f) {
         // Morning (0.35 - 0.4)
-        float t = (timeOfDay - 0.35f) / 0.05f;
+        float t = (dayPhase - 0.35f) / 0.05f;
         baseColor = glm::mix(dawnColor, dayColor, t);
-    } else if (timeOfDay < 0.6f) {
+    } else if (dayPhase < 0.6f) {
         // Day (0.4 - 0.6)
         baseColor = dayColor;
-    } else if (timeOfDay < 0.65f) {
+    } else if (dayPhase < 0.65f) {
         // Evening (0.6 - 0.65)
-        float t = (timeOfDay - 0.6f) / 0.05f;
+        float t = (dayPhase - 0.6f) / 0.05f;
         baseColor = glm::mix(dayColor, duskColor, t);
-    } else if (timeOfDay < 0.75f) {
+    } else if (dayPhase < 0.75f) {
         // Dusk (0.65 - 0.75)
-        float t = (timeOfDay - 0.65f) / 0.1f;
+        float t = (dayPhase - 0.65f) / 0.1f;
         baseColor = glm::mix(duskColor, nightColor, t);
     } else {
         // Night (0.75 - 1.0)
@@ -0,0 +1,591 @@
+#include "WindField.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Smallest grid, and the granularity sizes are rounded up to (so the
+// hierarchy can halve it a few times)
+static const int kMinColumns = 16;
+static const int kMinRows = 8;
+static const int kSizeMultiple = 8;
+
+// Below this many rows per thread a pass stays on the calling thread
+static const size_t kParallelRows = 16;
+
+// Longest step taken at once (seconds)
+static const float kMaxStep = 0.05f;
+
+// Air moves this many pixels per second per unit of wind, as the
+// precipitation and fog do
+static const float kPixelsPerWindUnit = 3.0f;
+
+// The air relaxes toward the prevailing wind at this rate (per second);
+// at the ground the prevailing wind is reduced to kGroundWind of itself
+static const float kRelaxRate = 0.4f;
+static const float kGroundWind = 0.3f;
+
+// Ground heating: degrees per second at full sun, put into the lowest
+// kHeatDepth of the window in kThermals warm patches across it.
+// Thunderstorms add convective heating whatever the sun.
+static const float kSunHeating = 4.0f;
+static const float kStormHeating = 3.0f;
+static const float kHeatDepth = 0.08f;
+static const float kThermals = 3.0f;
+static const float kHeatDrift = 0.03f;  // Patches along the ground (radians per second)
+
+// Warm air loses its excess at this rate (per second), and rises with this
+// acceleration per degree (wind units per second)
+static const float kCooling = 0.5f;
+static const float kBuoyancy = 3.0f;
+
+// Pressure solve: V-cycles per step, Jacobi sweeps before and after each
+// coarse correction, sweeps on the coarsest grid, and Jacobi weight
+static const int kCycles = 2;
+static const int kSweeps = 2;
+static const int kCoarsestSweeps = 40;
+static const float kJacobiWeight = 0.8f;
+
+static const float kTwoPi = 6.28318531f;
+
+static float smoothstep(float edge0, float edge1, float x) {
+    float t = std::min(std::max((x - edge0) / (edge1 - edge0), 0.0f), 1.0f);
+    return t * t * (3.0f - 2.0f * t);
+}
+
+static int roundSize(int size, int minimum) {
+    size = std::max(size, minimum);
+    return (size + kSizeMultiple - 1) / kSizeMultiple * kSizeMultiple;
+}
+
+// Bilinear sample of a width x height lattice at lattice coordinates:
+// wrapped in x (any number of laps off), clamped in y
+static inline float sampleLattice(const float* grid, int width, int height, float x, float y) {
+    x -= width * std::floor(x / width);
+    y = std::min(std::max(y, 0.0f), static_cast<float>(height - 1));
+    int x0 = std::min(static_cast<int>(x), width - 1);
+    int x1 = x0 + 1 < width ? x0 + 1 : 0;
+    int y0 = std::min(static_cast<int>(y), height - 2);
+    float fx = x - x0;
+    float fy = y - y0;
+    const float* a = grid + static_cast<size_t>(y0) * width;
+    const float* b = a + width;
+    float top = a[x0] + (a[x1] - a[x0]) * fx;
+    float bottom = b[x0] + (b[x1] - b[x0]) * fx;
+    return top + (bottom - top) * fy;
+}
+
+// a * (sum of the four neighbours) + b * centre + c * rhs along one row,
+// wrapping around the sides. Covers both the weighted Jacobi sweep and the
+// residual.
+static void stencilRow(const float* center, const float* above, const float* below, const float* rhs,
+                       float* out, int count, float a, float b, float c) {
+    int last = count - 1;
+    out[0] = a * (center[last] + center[1] + above[0] + below[0]) + b * center[0] + c * rhs[0];
+
+    int x = 1;
+#if defined(__SSE2__)
+    __m128 va = _mm_set1_ps(a);
+    __m128 vb = _mm_set1_ps(b);
+    __m128 vc = _mm_set1_ps(c);
+    for (; x + 4 <= last; x += 4) {
+        __m128 middle = _mm_loadu_ps(center + x);
+        __m128 sum = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(center + x - 1), _mm_loadu_ps(center + x + 1)),
+                                _mm_add_ps(_mm_loadu_ps(above + x), _mm_loadu_ps(below + x)));
+        __m128 value = _mm_add_ps(_mm_mul_ps(va, sum), _mm_mul_ps(vb, middle));
+        _mm_storeu_ps(out + x, _mm_add_ps(value, _mm_mul_ps(vc, _mm_loadu_ps(rhs + x))));
+    }
+#endif
+    for (; x < last; x++) {
+        out[x] = a * (center[x - 1] + center[x + 1] + above[x] + below[x]) + b * center[x] + c * rhs[x];
+    }
+
+    out[last] = a * (center[last - 1] + center[0] + above[last] + below[last]) + b * center[last] + c * rhs[last];
+}
+
+WindField::WindField(int columns, int rows)
+    : columns(0), rows(0), workers(nullptr), stepMs(0.0f), maxSpeed(0.0f), started(false), screenWidth(0.0f),
+      screenHeight(0.0f), heatPhase(0.0f), prevailing(0.0f), stepTime(0.0f), cellStepX(0.0f), cellStepY(0.0f),
+      activeLevel(0), activePass(nullptr) {
+    setResolution(columns, rows);
+}
+
+void WindField::setResolution(int columns, int rows) {
+    columns = roundSize(columns, kMinColumns);
+    rows = roundSize(rows, kMinRows);
+    if (columns == this->columns && rows == this->rows) return;
+    this->columns = columns;
+    this->rows = rows;
+
+    size_t cells = static_cast<size_t>(columns) * rows;
+    size_t vFaces = static_cast<size_t>(columns) * (rows + 1);
+    u.assign(cells, 0.0f);
+    u0.assign(cells, 0.0f);
+    v.assign(vFaces, 0.0f);
+    v0.assign(vFaces, 0.0f);
+    heat.assign(cells, 0.0f);
+    heat0.assign(cells, 0.0f);
+    rowWind.assign(rows, 0.0f);
+    rowHeating.assign(rows, 0.0f);
+    columnHeating.assign(columns, 0.0f);
+    rowMaxSpeed.assign(rows, 0.0f);
+
+    // Ground profile: slower and warmer near the bottom
+    for (int row = 0; row < rows; row++) {
+        float height = 1.0f - (row + 0.5f) / rows;
+        rowWind[row] = kGroundWind + (1.0f - kGroundWind) * std::sqrt(height);
+        rowHeating[row] = std::exp(-height / kHeatDepth);
+    }
+
+    // Halve the grid while both sides stay even and the coarse grid keeps
+    // a few rows
+    levels.clear();
+    int levelColumns = columns;
+    int levelRows = rows;
+    float spacing2 = 1.0f;
+    while (true) {
+        Level level;
+        level.columns = levelColumns;
+        level.rows = levelRows;
+        level.spacing2 = spacing2;
+        size_t levelCells = static_cast<size_t>(levelColumns) * levelRows;
+        level.value.assign(levelCells, 0.0f);
+        level.next.assign(levelCells, 0.0f);
+        level.rhs.assign(levelCells, 0.0f);
+        levels.push_back(std::move(level));
+        if (levelColumns % 2 != 0 || levelRows % 2 != 0 || levelRows < 8) break;
+        levelColumns /= 2;
+        levelRows /= 2;
+        spacing2 *= 4.0f;
+    }
+
+    started = false;
+}
+
+void WindField::update(float deltaTime, const WeatherSystem& weather, int screenWidth, int screenHeight) {
+    if (screenWidth <= 0 || screenHeight <= 0) return;
+    auto start = std::chrono::steady_clock::now();
+
+    this->screenWidth = static_cast<float>(screenWidth);
+    this->screenHeight = static_cast<float>(screenHeight);
+    prevailing = weather.getWindVector();
+
+    if (!started) {
+        for (int row = 0; row < rows; row++) {
+            std::fill(u.begin() + static_cast<size_t>(row) * columns,
+                      u.begin() + static_cast<size_t>(row + 1) * columns, prevailing.x * rowWind[row]);
+        }
+        std::fill(v.begin(), v.end(), 0.0f);
+        std::fill(heat.begin(), heat.end(), 0.0f);
+        std::fill(levels[0].value.begin(), levels[0].value.end(), 0.0f);
+        started = true;
+    }
+
+    stepTime = std::min(deltaTime, kMaxStep);
+    cellStepX = kPixelsPerWindUnit * stepTime * columns / screenWidth;
+    cellStepY = kPixelsPerWindUnit * stepTime * rows / screenHeight;
+
+    // Sun on the ground, less of it through cloud; storms heat by
+    // convection whatever the sun
+    const EphemerisSample& sky = weather.getSky();
+    float sun = smoothstep(0.0f, 30.0f, sky.sunAltitude) * (1.0f - 0.7f * weather.getCloudCover());
+    float heating = kSunHeating * sun;
+    if (weather.getState() == WeatherState::THUNDERSTORM) heating += kStormHeating;
+    heatPhase += kHeatDrift * stepTime;
+    for (int column = 0; column < columns; column++) {
+        float s = std::max(std::sin(kTwoPi * kThermals * (column + 0.5f) / columns + heatPhase), 0.0f);
+        columnHeating[column] = heating * (0.2f + 0.8f * s * s);
+    }
+
+    // There is one more row of v faces than of cells
+    runRows(rows + 1, &WindField::forceRows);
+    runRows(rows + 1, &WindField::advectRows);
+    u.swap(u0);
+    v.swap(v0);
+    heat.swap(heat0);
+
+    // Make the velocity divergence-free: solve for the pressure (warm
+    // started from the last step) and subtract its gradient
+    runRows(rows, &WindField::divergenceRows);
+    for (int cycle = 0; cycle < kCycles; cycle++) {
+        vCycle(0);
+    }
+    runRows(rows + 1, &WindField::projectRows);
+    runRows(rows, &WindField::speedRows);
+
+    maxSpeed = *std::max_element(rowMaxSpeed.begin(), rowMaxSpeed.end());
+    stepMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+glm::vec2 WindField::sample(glm::vec2 screenPosition) const {
+    if (!started) return prevailing;
+
+    // In cells from the top left corner; u lives on the left faces, v on
+    // the top ones
+    float x = screenPosition.x / screenWidth * columns;
+    float y = screenPosition.y / screenHeight * rows;
+    return glm::vec2(sampleLattice(u.data(), columns, rows, x, y - 0.5f),
+                     sampleLattice(v.data(), columns, rows + 1, x - 0.5f, y));
+}
+
+void WindField::runRows(int count, void (WindField::*pass)(int, int)) {
+    activePass = pass;
+    if (workers) {
+        workers->parallelFor(static_cast<size_t>(count), [this](size_t begin, size_t end) {
+            (this->*activePass)(static_cast<int>(begin), static_cast<int>(end));
+        }, kParallelRows);
+    } else {
+        (this->*pass)(0, count);
+    }
+}
+
+void WindField::forceRows(int begin, int end) {
+    float relax = std::min(kRelaxRate * stepTime, 1.0f);
+    float lift = 0.5f * kBuoyancy * stepTime;
+#if defined(__SSE2__)
+    __m128 vRelax = _mm_set1_ps(relax);
+    __m128 vLift = _mm_set1_ps(lift);
+#endif
+
+    for (int row = begin; row < end; row++) {
+        // u faces of cell row `row`: toward the prevailing wind
+        if (row < rows) {
+            float* faces = &u[static_cast<size_t>(row) * columns];
+            float target = prevailing.x * rowWind[row];
+            int x = 0;
+#if defined(__SSE2__)
+            __m128 vTarget = _mm_set1_ps(target);
+            for (; x + 4 <= columns; x += 4) {
+                __m128 wind = _mm_loadu_ps(faces + x);
+                _mm_storeu_ps(faces + x, _mm_add_ps(wind, _mm_mul_ps(_mm_sub_ps(vTarget, wind), vRelax)));
+            }
+#endif
+            for (; x < columns; x++) {
+                faces[x] += (target - faces[x]) * relax;
+            }
+        }
+
+        // v faces between rows row - 1 and row (not the walls): toward the
+        // prevailing wind, and up where the air on either side is warm
+        // (screen y points down)
+        if (row > 0 && row < rows) {
+            float* faces = &v[static_cast<size_t>(row) * columns];
+            const float* above = &heat[static_cast<size_t>(row - 1) * columns];
+            const float* below = above + columns;
+            float target = prevailing.y * 0.5f * (rowWind[row - 1] + rowWind[row]);
+            int x = 0;
+#if defined(__SSE2__)
+            __m128 vTarget = _mm_set1_ps(target);
+            for (; x + 4 <= columns; x += 4) {
+                __m128 wind = _mm_loadu_ps(faces + x);
+                __m128 warmth = _mm_add_ps(_mm_loadu_ps(above + x), _mm_loadu_ps(below + x));
+                wind = _mm_add_ps(wind, _mm_mul_ps(_mm_sub_ps(vTarget, wind), vRelax));
+                _mm_storeu_ps(faces + x, _mm_sub_ps(wind, _mm_mul_ps(vLift, warmth)));
+            }
+#endif
+            for (; x < columns; x++) {
+                faces[x] += (target - faces[x]) * relax - lift * (above[x] + below[x]);
+            }
+        }
+    }
+}
+
+void WindField::advectRows(int begin, int end) {
+    int last = columns - 1;
+    float keep = 1.0f - kCooling * stepTime;
+    float backX[4], backY[4];
+#if defined(__SSE2__)
+    __m128 stepX = _mm_set1_ps(cellStepX);
+    __m128 stepY = _mm_set1_ps(cellStepY);
+    __m128 half = _mm_set1_ps(0.5f);
+    __m128 quarter = _mm_set1_ps(0.25f);
+    __m128 lanes = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+#endif
+
+    // Every face and cell looks back along the wind at its position and
+    // interpolates there. The back-traced positions are found four at a
+    // time; the fetches that follow are scattered, so they stay scalar.
+    // Neighbours that wrap around the sides are handled one at a time.
+    for (int row = begin; row < end; row++) {
+        if (row < rows) {
+            const float* faces = &u[static_cast<size_t>(row) * columns];
+            const float* vAbove = &v[static_cast<size_t>(row) * columns];
+            const float* vBelow = vAbove + columns;
+            float y = row + 0.5f;
+
+            // u faces (left side of each cell): v is the mean of the four
+            // v faces around them
+            float* out = &u0[static_cast<size_t>(row) * columns];
+            auto traceFace = [&](int x) {
+                int left = x > 0 ? x - 1 : last;
+                float windY = 0.25f * (vAbove[left] + vAbove[x] + vBelow[left] + vBelow[x]);
+                float bx = x - faces[x] * cellStepX;
+                float by = y - windY * cellStepY;
+                out[x] = sampleLattice(u.data(), columns, rows, bx, by - 0.5f);
+            };
+            traceFace(0);
+            int x = 1;
+#if defined(__SSE2__)
+            for (; x + 4 <= columns; x += 4) {
+                __m128 windY = _mm_mul_ps(quarter, _mm_add_ps(
+                    _mm_add_ps(_mm_loadu_ps(vAbove + x - 1), _mm_loadu_ps(vAbove + x)),
+                    _mm_add_ps(_mm_loadu_ps(vBelow + x - 1), _mm_loadu_ps(vBelow + x))));
+                __m128 px = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), lanes);
+                _mm_storeu_ps(backX, _mm_sub_ps(px, _mm_mul_ps(_mm_loadu_ps(faces + x), stepX)));
+                _mm_storeu_ps(backY, _mm_sub_ps(_mm_set1_ps(y), _mm_mul_ps(windY, stepY)));
+                for (int lane = 0; lane < 4; lane++) {
+                    out[x + lane] = sampleLattice(u.data(), columns, rows, backX[lane], backY[lane] - 0.5f);
+                }
+            }
+#endif
+            for (; x < columns; x++) {
+                traceFace(x);
+            }
+
+            // Temperature at the cell centres, cooling and heated from below
+            float* heatOut = &heat0[static_cast<size_t>(row) * columns];
+            float heatIn = rowHeating[row] * stepTime;
+            auto traceCell = [&](int x) {
+                float windX = 0.5f * (faces[x] + faces[x < last ? x + 1 : 0]);
+                float bx = x + 0.5f - windX * cellStepX;
+                float by = y - 0.5f * (vAbove[x] + vBelow[x]) * cellStepY;
+                float value = sampleLattice(heat.data(), columns, rows, bx - 0.5f, by - 0.5f);
+                heatOut[x] = value * keep + heatIn * columnHeating[x];
+            };
+            x = 0;
+#if defined(__SSE2__)
+            for (; x + 4 <= last; x += 4) {
+                __m128 windX = _mm_mul_ps(half, _mm_add_ps(_mm_loadu_ps(faces + x), _mm_loadu_ps(faces + x + 1)));
+                __m128 windY = _mm_mul_ps(half, _mm_add_ps(_mm_loadu_ps(vAbove + x), _mm_loadu_ps(vBelow + x)));
+                __m128 px = _mm_add_ps(_mm_set1_ps(x + 0.5f), lanes);
+                _mm_storeu_ps(backX, _mm_sub_ps(px, _mm_mul_ps(windX, stepX)));
+                _mm_storeu_ps(backY, _mm_sub_ps(_mm_set1_ps(y), _mm_mul_ps(windY, stepY)));
+                for (int lane = 0; lane < 4; lane++) {
+                    float value = sampleLattice(heat.data(), columns, rows, backX[lane] - 0.5f, backY[lane] - 0.5f);
+                    heatOut[x + lane] = value * keep + heatIn * columnHeating[x + lane];
+                }
+            }
+#endif
+            for (; x < columns; x++) {
+                traceCell(x);
+            }
+        }
+
+        // v faces (top side of each cell): u is the mean of the four u
+        // faces around them. The walls at the top and bottom let nothing
+        // through.
+        float* out = &v0[static_cast<size_t>(row) * columns];
+        if (row == 0 || row == rows) {
+            std::fill(out, out + columns, 0.0f);
+            continue;
+        }
+        const float* faces = &v[static_cast<size_t>(row) * columns];
+        const float* uAbove = &u[static_cast<size_t>(row - 1) * columns];
+        const float* uBelow = uAbove + columns;
+        float y = static_cast<float>(row);
+        auto traceFace = [&](int x) {
+            int right = x < last ? x + 1 : 0;
+            float windX = 0.25f * (uAbove[x] + uAbove[right] + uBelow[x] + uBelow[right]);
+            float bx = x + 0.5f - windX * cellStepX;
+            float by = y - faces[x] * cellStepY;
+            out[x] = sampleLattice(v.data(), columns, rows + 1, bx - 0.5f, by);
+        };
+        int x = 0;
+#if defined(__SSE2__)
+        for (; x + 4 <= last; x += 4) {
+            __m128 windX = _mm_mul_ps(quarter, _mm_add_ps(
+                _mm_add_ps(_mm_loadu_ps(uAbove + x), _mm_loadu_ps(uAbove + x + 1)),
+                _mm_add_ps(_mm_loadu_ps(uBelow + x), _mm_loadu_ps(uBelow + x + 1))));
+            __m128 px = _mm_add_ps(_mm_set1_ps(x + 0.5f), lanes);
+            _mm_storeu_ps(backX, _mm_sub_ps(px, _mm_mul_ps(windX, stepX)));
+            _mm_storeu_ps(backY, _mm_sub_ps(_mm_set1_ps(y), _mm_mul_ps(_mm_loadu_ps(faces + x), stepY)));
+            for (int lane = 0; lane < 4; lane++) {
+                out[x + lane] = sampleLattice(v.data(), columns, rows + 1, backX[lane] - 0.5f, backY[lane]);
+            }
+        }
+#endif
+        for (; x < columns; x++) {
+            traceFace(x);
+        }
+    }
+}
+
+void WindField::divergenceRows(int begin, int end) {
+    int last = columns - 1;
+    std::vector<float>& divergence = levels[0].rhs;
+
+    for (int row = begin; row < end; row++) {
+        // Net outflow of each cell through its four faces
+        const float* faces = &u[static_cast<size_t>(row) * columns];
+        const float* above = &v[static_cast<size_t>(row) * columns];
+        const float* below = above + columns;
+        float* out = &divergence[static_cast<size_t>(row) * columns];
+
+        int x = 0;
+#if defined(__SSE2__)
+        for (; x + 4 <= last; x += 4) {
+            __m128 across = _mm_sub_ps(_mm_loadu_ps(faces + x + 1), _mm_loadu_ps(faces + x));
+            __m128 down = _mm_sub_ps(_mm_loadu_ps(below + x), _mm_loadu_ps(above + x));
+            _mm_storeu_ps(out + x, _mm_add_ps(across, down));
+        }
+#endif
+        for (; x < columns; x++) {
+            out[x] = faces[x < last ? x + 1 : 0] - faces[x] + below[x] - above[x];
+        }
+    }
+}
+
+void WindField::projectRows(int begin, int end) {
+    const std::vector<float>& pressure = levels[0].value;
+
+    for (int row = begin; row < end; row++) {
+        // v faces between rows row - 1 and row; the walls stay shut
+        if (row > 0 && row < rows) {
+            const float* above = &pressure[static_cast<size_t>(row - 1) * columns];
+            const float* below = above + columns;
+            float* faces = &v[static_cast<size_t>(row) * columns];
+            int x = 0;
+#if defined(__SSE2__)
+            for (; x + 4 <= columns; x += 4) {
+                __m128 gradient = _mm_sub_ps(_mm_loadu_ps(below + x), _mm_loadu_ps(above + x));
+                _mm_storeu_ps(faces + x, _mm_sub_ps(_mm_loadu_ps(faces + x), gradient));
+            }
+#endif
+            for (; x < columns; x++) {
+                faces[x] -= below[x] - above[x];
+            }
+        }
+        if (row == rows) continue;
+
+        // u faces of this row (the first one between the last cell and the
+        // first)
+        const float* center = &pressure[static_cast<size_t>(row) * columns];
+        float* faces = &u[static_cast<size_t>(row) * columns];
+        faces[0] -= center[0] - center[columns - 1];
+        int x = 1;
+#if defined(__SSE2__)
+        for (; x + 4 <= columns; x += 4) {
+            __m128 gradient = _mm_sub_ps(_mm_loadu_ps(center + x), _mm_loadu_ps(center + x - 1));
+            _mm_storeu_ps(faces + x, _mm_sub_ps(_mm_loadu_ps(faces + x), gradient));
+        }
+#endif
+        for (; x < columns; x++) {
+            faces[x] -= center[x] - center[x - 1];
+        }
+    }
+}
+
+void WindField::speedRows(int begin, int end) {
+    int last = columns - 1;
+
+    for (int row = begin; row < end; row++) {
+        const float* faces = &u[static_cast<size_t>(row) * columns];
+        const float* above = &v[static_cast<size_t>(row) * columns];
+        const float* below = above + columns;
+        float fastest = 0.0f;
+        for (int x = 0; x < columns; x++) {
+            float windX = 0.5f * (faces[x] + faces[x < last ? x + 1 : 0]);
+            float windY = 0.5f * (above[x] + below[x]);
+            fastest = std::max(fastest, windX * windX + windY * windY);
+        }
+        rowMaxSpeed[row] = std::sqrt(fastest);
+    }
+}
+
+void WindField::smoothRows(int begin, int end) {
+    Level& level = levels[activeLevel];
+    float a = kJacobiWeight * 0.25f;
+    float b = 1.0f - kJacobiWeight;
+    float c = -kJacobiWeight * 0.25f * level.spacing2;
+
+    for (int row = begin; row < end; row++) {
+        // No flow through the walls: the pressure repeats beyond them
+        size_t offset = static_cast<size_t>(row) * level.columns;
+        const float* center = &level.value[offset];
+        const float* above = row > 0 ? center - level.columns : center;
+        const float* below = row + 1 < level.rows ? center + level.columns : center;
+        stencilRow(center, above, below, &level.rhs[offset], &level.next[offset], level.columns, a, b, c);
+    }
+}
+
+void WindField::residualRows(int begin, int end) {
+    Level& level = levels[activeLevel];
+    float a = -1.0f / level.spacing2;
+    float b = 4.0f / level.spacing2;
+
+    for (int row = begin; row < end; row++) {
+        size_t offset = static_cast<size_t>(row) * level.columns;
+        const float* center = &level.value[offset];
+        const float* above = row > 0 ? center - level.columns : center;
+        const float* below = row + 1 < level.rows ? center + level.columns : center;
+        stencilRow(center, above, below, &level.rhs[offset], &level.next[offset], level.columns, a, b, 1.0f);
+    }
+}
+
+void WindField::restrictRows(int begin, int end) {
+    Level& coarse = levels[activeLevel];
+    const Level& fine = levels[activeLevel - 1];
+
+    for (int row = begin; row < end; row++) {
+        const float* first = &fine.next[static_cast<size_t>(2 * row) * fine.columns];
+        const float* second = first + fine.columns;
+        size_t offset = static_cast<size_t>(row) * coarse.columns;
+        for (int x = 0; x < coarse.columns; x++) {
+            coarse.rhs[offset + x] = 0.25f * (first[2 * x] + first[2 * x + 1] + second[2 * x] + second[2 * x + 1]);
+            coarse.value[offset + x] = 0.0f;
+        }
+    }
+}
+
+void WindField::prolongRows(int begin, int end) {
+    const Level& coarse = levels[activeLevel];
+    Level& fine = levels[activeLevel - 1];
+
+    for (int row = begin; row < end; row++) {
+        // Each fine cell sits a quarter of a coarse cell from the nearest
+        // coarse centre: weights 9/16, 3/16, 3/16 and 1/16
+        int coarseRow = row / 2;
+        int nearRow = row % 2 ? coarseRow + 1 : coarseRow - 1;
+        nearRow = std::min(std::max(nearRow, 0), coarse.rows - 1);
+        const float* a = &coarse.value[static_cast<size_t>(coarseRow) * coarse.columns];
+        const float* b = &coarse.value[static_cast<size_t>(nearRow) * coarse.columns];
+        float* out = &fine.value[static_cast<size_t>(row) * fine.columns];
+
+        for (int x = 0; x < fine.columns; x++) {
+            int coarseX = x / 2;
+            int nearX = x % 2 ? coarseX + 1 : coarseX - 1;
+            nearX = (nearX + coarse.columns) % coarse.columns;
+            out[x] += 0.5625f * a[coarseX] + 0.1875f * (a[nearX] + b[coarseX]) + 0.0625f * b[nearX];
+        }
+    }
+}
+
+void WindField::smooth(int level, int iterations) {
+    activeLevel = level;
+    for (int i = 0; i < iterations; i++) {
+        runRows(levels[level].rows, &WindField::smoothRows);
+        levels[level].value.swap(levels[level].next);
+    }
+}
+
+void WindField::vCycle(int level) {
+    if (level + 1 == static_cast<int>(levels.size())) {
+        smooth(level, kCoarsestSweeps);
+        return;
+    }
+
+    smooth(level, kSweeps);
+    activeLevel = level;
+    runRows(levels[level].rows, &WindField::residualRows);
+    activeLevel = level + 1;
+    runRows(levels[level + 1].rows, &WindField::restrictRows);
+
+    vCycle(level + 1);
+
+    activeLevel = level + 1;
+    runRows(levels[level].rows, &WindField::prolongRows);
+    smooth(level, kSweeps);
+}
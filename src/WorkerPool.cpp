@@ -0,0 +1,87 @@
+#include "WorkerPool.h"
+#include <algorithm>
+
+WorkerPool::WorkerPool(unsigned threadCount)
+    : job(nullptr), jobCount(0), chunkSize(0), nextChunk(0), pending(0), generation(0), stopping(false) {
+    if (threadCount == 0) {
+        unsigned hardware = std::thread::hardware_concurrency();
+        threadCount = hardware > 1 ? hardware - 1 : 0;
+    }
+    threadCount = std::min(threadCount, 15u);
+
+    threads.reserve(threadCount);
+    for (unsigned i = 0; i < threadCount; i++) {
+        threads.emplace_back(&WorkerPool::workerLoop, this);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+void WorkerPool::parallelFor(size_t count, const std::function<void(size_t, size_t)>& fn, size_t minChunk) {
+    if (count == 0) return;
+
+    size_t workers = getThreadCount();
+    size_t chunk = std::max((count + workers - 1) / workers, std::max<size_t>(minChunk, 1));
+    if (threads.empty() || chunk >= count) {
+        fn(0, count);
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    if (job) {
+        // Busy: waiting here would deadlock a nested call and stall the
+        // caller behind someone else's job
+        lock.unlock();
+        fn(0, count);
+        return;
+    }
+    job = &fn;
+    jobCount = count;
+    chunkSize = chunk;
+    nextChunk = 0;
+    pending = (count + chunk - 1) / chunk;
+    generation++;
+    wake.notify_all();
+
+    // The caller works too, then waits for chunks still running elsewhere
+    runChunks(lock);
+    done.wait(lock, [this] { return pending == 0; });
+    job = nullptr;
+}
+
+void WorkerPool::runChunks(std::unique_lock<std::mutex>& lock) {
+    while (job && nextChunk * chunkSize < jobCount) {
+        size_t begin = nextChunk * chunkSize;
+        size_t end = std::min(begin + chunkSize, jobCount);
+        nextChunk++;
+        const std::function<void(size_t, size_t)>* current = job;
+
+        lock.unlock();
+        (*current)(begin, end);
+        lock.lock();
+
+        if (--pending == 0) {
+            done.notify_all();
+        }
+    }
+}
+
+void WorkerPool::workerLoop() {
+    unsigned long long seen = 0;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [this, &seen] { return stopping || generation != seen; });
+        if (stopping) return;
+        seen = generation;
+        runChunks(lock);
+    }
+}